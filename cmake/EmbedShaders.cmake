@@ -0,0 +1,32 @@
+# Writes OUTPUT, a C++ source with every shader in SHADER_DIR as a string for embeddedShader().
+# Run by the build whenever a shader changes: cmake -DSHADER_DIR=... -DOUTPUT=... -P EmbedShaders.cmake
+
+file(GLOB SHADERS RELATIVE ${SHADER_DIR} ${SHADER_DIR}/*.vert ${SHADER_DIR}/*.frag)
+list(SORT SHADERS)
+
+set(CONTENT "// Generated from shaders/ by cmake/EmbedShaders.cmake, do not edit\n\n")
+string(APPEND CONTENT "#include <cstring>\n#include \"EmbeddedShaders.hh\"\n\nnamespace {\n\n")
+string(APPEND CONTENT "struct EmbeddedShader {\n  const char *name;\n  const char *source;\n};\n\n")
+string(APPEND CONTENT "const EmbeddedShader SHADERS[] = {\n")
+foreach (SHADER ${SHADERS})
+    file(READ ${SHADER_DIR}/${SHADER} SOURCE)
+    string(FIND "${SOURCE}" ")mandelbulb_glsl\"" CLASH)
+    if (NOT CLASH EQUAL -1)
+        message(FATAL_ERROR "${SHADER} contains the raw string delimiter")
+    endif ()
+    string(APPEND CONTENT "    {\"${SHADER}\", R\"mandelbulb_glsl(${SOURCE})mandelbulb_glsl\"},\n")
+endforeach ()
+string(APPEND CONTENT "};\n\n}\n\n")
+
+string(APPEND CONTENT "const char *embeddedShader(const char *name) {\n")
+string(APPEND CONTENT "  for (const EmbeddedShader &shader : SHADERS)\n")
+string(APPEND CONTENT "    if (strcmp(shader.name, name) == 0)\n      return shader.source;\n")
+string(APPEND CONTENT "  return nullptr;\n}\n")
+
+# Only touch the output when it changes, so an unchanged shader does not relink
+if (EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS)
+endif ()
+if (NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif ()
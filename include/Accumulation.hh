@@ -0,0 +1,35 @@
+#ifndef MANDELBULB_ACCUMULATION_H
+#define MANDELBULB_ACCUMULATION_H
+
+#include "types.hh"
+
+/**
+ * Progressive refinement bookkeeping. While the scene stays the same every
+ * frame blends one more jittered sample into a float buffer, which holds the
+ * running mean of all samples so far.
+ */
+class Accumulation {
+  unsigned int samples = 0;
+
+ public:
+  bool enabled = true;
+  int maxSamples = 256;
+
+  void reset() { samples = 0; }
+  void addSample() { samples++; }
+
+  unsigned int sampleCount() const { return samples; }
+  bool converged() const { return enabled && samples >= (unsigned int) maxSamples; }
+
+  /**
+   * Weight of the next sample in the running mean
+   */
+  float blendWeight() const { return 1.0f / (float) (samples + 1); }
+
+  /**
+   * Subpixel offset of the next sample in pixels, in [-0.5, 0.5)
+   */
+  vec2 jitter() const;
+};
+
+#endif //MANDELBULB_ACCUMULATION_H
@@ -0,0 +1,111 @@
+#ifndef MANDELBULB_BENCHMARK_H
+#define MANDELBULB_BENCHMARK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FractalUniforms.hh"
+#include "Keyframes.hh"
+
+/**
+ * Frame times and DE calls of one camera path replayed with one preset
+ */
+struct BenchmarkRun {
+  std::string preset;
+  std::string path;
+  std::vector<double> frameMS;
+  std::vector<double> deCalls; // Per frame, from the counting pass
+};
+
+/**
+ * Nearest rank percentile, p in [0, 100]
+ */
+double percentile(std::vector<double> values, double p);
+
+/**
+ * Every preset on every camera path, each run replayed twice: once for frame
+ * times and once with the DE counters on, which cost time of their own. Frames
+ * only depend on the frame number, u_time is pinned, so runs are repeatable.
+ * The renderer drives it one frame at a time through frame() and finishFrame().
+ */
+class BenchmarkSuite {
+ public:
+  static const unsigned int WARM_UP_FRAMES = 10;
+
+ private:
+  enum Phase { WARM_UP, TIMING, COUNTING, DONE };
+
+  std::vector<BenchmarkRun> runs;
+  FractalUniforms baseU;
+  AppState baseState;
+  float time = 0.0f;
+
+  size_t runIndex = 0;
+  Phase phase = DONE;
+  unsigned int frameIndex = 0;
+  unsigned int warmUpLeft = 0;
+
+  // Orbit and flythrough are keyframed, the deep zoom closes in on where its ray first hits the surface
+  KeyframeTrack track;
+  Keyframe deepZoomBase;
+  dvec3 deepZoomTarget;
+  dvec3 deepZoomDirection;
+  double deepZoomDistance = 0.0;
+
+  void startRun();
+
+ public:
+
+  /**
+   * Comma separated preset and path names, or "all". Prints what is wrong and returns false on unknown names.
+   */
+  bool init(const std::string &presets, const std::string &paths, const FractalUniforms &u, const AppState &state,
+            float time = 0.0f);
+
+  bool done() const { return phase == DONE; }
+
+  /**
+   * Camera and settings to render now
+   */
+  Keyframe frame() const;
+
+  /**
+   * Whether the frame being rendered should count DE calls
+   */
+  bool countingDECalls() const { return phase == COUNTING; }
+
+  /**
+   * Records the frame from frame(). Warm-up frames are not recorded and last
+   * until ready, the renderer's word that shaders and caches have settled.
+   */
+  void finishFrame(double ms, double deCalls, bool ready);
+
+  /**
+   * Human readable progress, "mandelbulb/orbit 120/240"
+   */
+  std::string status() const;
+
+  const std::vector<BenchmarkRun> &results() const { return runs; }
+
+  /**
+   * Percentiles per run as JSON, or CSV if the file name ends in .csv
+   */
+  bool write(const std::string &fileName, const std::string &renderer, unsigned int width, unsigned int height) const;
+
+  void printSummary() const;
+
+  static const std::vector<std::string> &presetNames();
+  static const std::vector<std::string> &pathNames();
+
+  /**
+   * Formula toggles and values of a named preset on top of u and state, false if there is no such preset
+   */
+  static bool applyPreset(const std::string &name, FractalUniforms &u, AppState &state);
+
+  /**
+   * Frames in a camera path
+   */
+  static unsigned int pathLength(const std::string &path);
+};
+
+#endif //MANDELBULB_BENCHMARK_H
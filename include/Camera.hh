@@ -11,26 +11,31 @@
 #define PI     3.14159265358979323846f
 #define TWO_PI 6.28318530718f
 
+// Kept in double so deep zoom can place the eye closer to the surface than a float can tell apart
 class Camera {
 
   // Coordinates for viewer
-  float defaultR = 3.0f, defaultTheta = 0.0f, defaultPhi = 0.0f;
-  float r = defaultR;
-  float theta = defaultTheta;
-  float phi = defaultPhi;
+  double defaultR = 3.0, defaultTheta = 0.0, defaultPhi = 0.0;
+  double r = defaultR;
+  double theta = defaultTheta;
+  double phi = defaultPhi;
 
  public:
-  float x = 0.0f, y = 0.0f, z = 0.0f;
+  double x = 0.0, y = 0.0, z = 0.0;
   float coordTurnStep = 0.01f;
   float coordZoomStep = 0.008f;
   bool freeControlsActive = false;
   bool constantZoom = false;
 
-  vec3 eye;
-  vec3 center;
-  vec3 up;
-  mat4 viewMatrix;
-  mat4 projectionMatrix;
+  // Deep zoom moves Z and X by this fraction of the distance to the surface, when that is known
+  float deepZoomRate = 0.02f;
+  double surfaceDistance = 0.0;
+
+  dvec3 eye;
+  dvec3 center;
+  dvec3 up;
+  dmat4 viewMatrix;
+  dmat4 projectionMatrix;
 
   Camera(unsigned int w, unsigned int h, float near, float far);
   ~Camera() = default;
@@ -44,12 +49,27 @@ class Camera {
    * Recalculate view matrix with viewer
    */
   void updateCenteredViewMatrix();
+
+  /**
+   * Place the eye from the spherical coords and look at the center
+   */
+  void updateSphericalView();
   void rotateViewMatrixHorizontally(float a);
   void rotateViewMatrixVertically(float a);
-  void translateViewMatrix(float v);
+  void translateViewMatrix(double v);
+
+  dvec3 getViewMatrixBackward();
+  dvec3 getViewMatrixForward();
+
+  /**
+   * Where the eye is, free mode moves it without updating eye
+   */
+  dvec3 getPosition() const;
 
-  vec3 getViewMatrixBackward();
-  vec3 getViewMatrixForward();
+  /**
+   * Distance Z and X move the eye by
+   */
+  double getZoomStep() const;
 
   // Key press handlers
   void handleKeyPressW();
@@ -69,6 +89,16 @@ class Camera {
    */
   void sphericalToCartesian();
 
+  /**
+   * Takes the control settings and the surface distance from other, the view stays
+   */
+  void copyControls(const Camera &other);
+
+  void setSphericalCoords(double r, double theta, double phi);
+  double getR() const { return r; }
+  double getTheta() const { return theta; }
+  double getPhi() const { return phi; }
+
 };
 
 #endif //MANDELBULB_CAMERA_H
@@ -0,0 +1,31 @@
+#ifndef MANDELBULB_CONEPREPASS_H
+#define MANDELBULB_CONEPREPASS_H
+
+#include <GL/glew.h>
+
+/**
+ * Low resolution target for the cone marching pre-pass. One texel per block of
+ * blockSize x blockSize pixels holds the distance every ray through the block
+ * can safely skip (x) and about how many regular steps that saves (y).
+ */
+class ConePrepass {
+  GLuint fbo = 0;
+  GLuint distanceTexture = 0;
+  unsigned int capacityWidth = 0, capacityHeight = 0;
+
+ public:
+
+  /**
+   * Makes room for the blocks of a w x h pixel image at blockSize, needs a current GL context
+   */
+  void reserve(unsigned int w, unsigned int h, unsigned int blockSize);
+
+  /**
+   * Binds the framebuffer with one pixel per block of a w x h image
+   */
+  void bind(unsigned int w, unsigned int h, unsigned int blockSize);
+
+  GLuint getTexture() const { return distanceTexture; }
+};
+
+#endif //MANDELBULB_CONEPREPASS_H
@@ -0,0 +1,112 @@
+#ifndef MANDELBULB_CPURAYMARCHER_H
+#define MANDELBULB_CPURAYMARCHER_H
+
+#include "DistanceEstimator.hh"
+#include "FractalUniforms.hh"
+#include "Image.hh"
+#include "ThreadPool.hh"
+
+/**
+ * Per-frame inputs that the vertex shader gets from display()
+ */
+struct RenderView {
+  dmat4 inverseVP = dmat4(1.0);
+  dvec3 eyePos = dvec3(0.0, 0.0, 1.0);
+  float nearPlane = 0.1f;
+  float farPlane = 100.0f;
+  float time = 0.0f;
+  unsigned int width = 800, height = 640;
+};
+
+/**
+ * Pixel rectangle [x0, x1) x [y0, y1), rows counted from the top
+ */
+struct Tile {
+  unsigned int x0, y0, x1, y1;
+};
+
+/**
+ * Result of marching one primary ray
+ */
+struct MarchResult {
+  float gsValue;
+  int stepsTaken;
+  vec3 pos;
+  vec4 orbitTrap;
+};
+
+/**
+ * Headless reference renderer mirroring mandel_raymarch.vert/.frag
+ */
+class CpuRaymarcher {
+  DistanceEstimator de;
+  FractalUniforms u;
+  RenderView view;
+  SimdLevel simdLevel;
+  bool packetMarch = true;
+
+  // AppState::deepZoom, rays are marched and shaded in double one pixel at a time
+  bool deepZoom;
+
+  // Per-vertex rays of the fullscreen quad, in quadArray order
+  dvec3 cornerOrigin[4];
+  dvec3 cornerDirection[4];
+
+  // Width of a pixel per unit of distance from the eye, scales the normal epsilon
+  float pixelAngle;
+
+  // Templates on vec3 and dvec3, the double ones are used in deep zoom
+  template<typename V> void interpolateRay(vec2 fragCoord, V &origin, V &direction) const;
+  template<typename V> float simpleMarch(V from, V dir, int &stepsTaken, V &pos, vec4 &orbitTrap) const;
+  template<typename V> vec3 calcNormal(V pos) const;
+  template<typename V> vec3 calculateBlinnPhong(vec3 diffColor, V p) const;
+  template<typename V> decltype(V().x) normalEpsilon(V pos) const;
+  template<typename V> float softShadow(V from, decltype(V().x) startDistance) const;
+  template<typename V> vec3 shade(vec2 fragCoord, const MarchResult &march, V mandelPos) const;
+  template<typename V> vec3 marchFragment(vec2 fragCoord) const;
+  vec3 getColorFromOrbitTrap(vec4 orbitTrap) const;
+  vec3 shadeMarch(vec2 fragCoord, const MarchResult &march) const;
+
+  /**
+   * simpleMarch() for up to a packet of rays at once, lanes stop individually
+   */
+  void marchPacket(int count, const vec3 *origins, const vec3 *directions, MarchResult *results) const;
+
+ public:
+  CpuRaymarcher(const FractalUniforms &uniforms, const AppState &state, const RenderView &view);
+
+  /**
+   * Ray for a fragment, interpolated across the quad's two triangles like the varyings
+   */
+  void primaryRay(vec2 fragCoord, vec3 &origin, vec3 &direction) const;
+  void primaryRay(vec2 fragCoord, dvec3 &origin, dvec3 &direction) const;
+
+  /**
+   * Color for a fragment, fragCoord as gl_FragCoord (origin bottom left)
+   */
+  vec3 shadeFragment(vec2 fragCoord) const;
+
+  void renderTile(Image &image, const Tile &tile) const { renderTile(image, tile, 0, 0); }
+
+  /**
+   * Tile into an image whose top left pixel is (originX, originY) of the view, such as a tile sized one
+   */
+  void renderTile(Image &image, const Tile &tile, unsigned int originX, unsigned int originY) const;
+
+  /**
+   * Primary rays go through the packet DE kernels unless turned off, which
+   * leaves the plain per-pixel port of the shader. Deep zoom always marches per pixel.
+   */
+  void setPacketMarch(bool enabled) { packetMarch = enabled; }
+  void setSimdLevel(SimdLevel level) { simdLevel = level; }
+
+  /**
+   * Render the whole view, one task per tile on the pool
+   */
+  void render(Image &image, ThreadPool &pool, unsigned int tileSize = 32) const;
+
+  const DistanceEstimator &estimator() const { return de; }
+
+};
+
+#endif //MANDELBULB_CPURAYMARCHER_H
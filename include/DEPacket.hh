@@ -0,0 +1,74 @@
+#ifndef MANDELBULB_DEPACKET_H
+#define MANDELBULB_DEPACKET_H
+
+#include <cstddef>
+#include "types.hh"
+
+#define DE_PACKET_MAX_WIDTH 16
+
+/**
+ * Formula parameters resolved for a frame, shared by the scalar DE and the packet kernels
+ */
+struct DEParams {
+  int fractalIters;
+  float bailLimit;
+  float fudgeFactor;
+
+  bool mandelbulbOn;
+  float power;
+  int integerPower; // FractalUniforms::integerPower(), 0 for the general kernel
+  int derivativeBias;
+  bool julia;
+  vec3 juliaC;
+
+  int boxFoldFactor; // 0 when box folding is off
+  float boxFoldingLimit;
+
+  int sphereFoldFactor; // 0 when sphere folding is off
+  float sphereMinRadius; // Includes the time variance
+  float sphereFixedRadius;
+
+  bool mandelBoxOn;
+  float mandelBoxScale;
+
+  int tetraFactor; // 0 when tetra is off
+  float tetraScale;
+};
+
+enum class SimdLevel {
+  Scalar,
+  SSE41,
+  AVX2,
+  AVX512
+};
+
+/**
+ * Evaluates SimdLevel width lanes. Positions and the optional orbit trap
+ * (x, y, z, w arrays back to back) are structure of arrays.
+ */
+typedef void (*DEPacketKernel)(const DEParams &p, const float *x, const float *y, const float *z,
+                               float *distance, float *orbitTrap);
+
+int simdWidth(SimdLevel level);
+const char *simdLevelName(SimdLevel level);
+bool simdLevelSupported(SimdLevel level);
+
+/**
+ * Inverse of simdLevelName(), false for unknown names
+ */
+bool parseSimdLevel(const char *name, SimdLevel &level);
+
+/**
+ * Widest level the running CPU supports, picked once at first call
+ */
+SimdLevel bestSimdLevel();
+
+/**
+ * DE for count positions, padded out to whole packets internally.
+ * orbitTrap is null or 4 * count floats laid out x[count], y[count], z[count], w[count].
+ */
+void estimatePacket(SimdLevel level, const DEParams &p, size_t count,
+                    const float *x, const float *y, const float *z,
+                    float *distance, float *orbitTrap = nullptr);
+
+#endif //MANDELBULB_DEPACKET_H
@@ -0,0 +1,354 @@
+#ifndef MANDELBULB_DEPACKETKERNEL_H
+#define MANDELBULB_DEPACKETKERNEL_H
+
+#include <cmath>
+#include "DEPacket.hh"
+
+// Generic packet DE, only included by the per-ISA translation units in src/cpu.
+// V is a lane type from one of them; everything here is a template on V so each
+// ISA gets its own instantiation and nothing compiled with AVX leaks into the others.
+//
+// V provides: width, Mask, broadcast from float, load/store, + - * /, and the
+// statics sqrt, floor, min, max, abs, select, lt, le, gt, andMask, orMask,
+// any, exp2i (2^n for integral n) and frexp (mantissa in [1, 2) and exponent).
+
+namespace packet {
+
+template<typename V>
+struct Vec3 {
+  V x, y, z;
+};
+
+template<typename V>
+inline V dot(const Vec3<V> &a, const Vec3<V> &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template<typename V>
+inline Vec3<V> select(typename V::Mask m, const Vec3<V> &a, const Vec3<V> &b) {
+  return {V::select(m, a.x, b.x), V::select(m, a.y, b.y), V::select(m, a.z, b.z)};
+}
+
+template<typename V>
+inline Vec3<V> scale(const Vec3<V> &a, V s) {
+  return {a.x * s, a.y * s, a.z * s};
+}
+
+template<typename V>
+inline V clamp(V x, V lo, V hi) {
+  return V::min(V::max(x, lo), hi);
+}
+
+// log2 for x > 0: split off the exponent, then atanh series on [sqrt(0.5), sqrt(2))
+template<typename V>
+inline V log2(V x) {
+  V m, e;
+  V::frexp(x, m, e);
+  auto big = V::gt(m, V(1.41421356f));
+  m = V::select(big, m * V(0.5f), m);
+  e = V::select(big, e + V(1.0f), e);
+
+  V t = (m - V(1.0f)) / (m + V(1.0f));
+  V t2 = t * t;
+  V series = V(1.0f) + t2 * (V(1.0f / 3.0f) + t2 * (V(1.0f / 5.0f) + t2 * (V(1.0f / 7.0f) + t2 * V(1.0f / 9.0f))));
+  return e + V(2.0f * 1.44269504f) * t * series;
+}
+
+// 2^x, split into an integral part built from the exponent bits and a Taylor series
+template<typename V>
+inline V exp2(V x) {
+  x = clamp(x, V(-126.0f), V(126.0f));
+  V n = V::floor(x + V(0.5f));
+  V f = (x - n) * V(0.69314718f);
+  V series = V(1.0f) + f * (V(1.0f) + f * (V(1.0f / 2.0f) + f * (V(1.0f / 6.0f) + f * (V(1.0f / 24.0f)
+      + f * (V(1.0f / 120.0f) + f * V(1.0f / 720.0f))))));
+  return series * V::exp2i(n);
+}
+
+// sin and cos together, Cody-Waite reduction by pi/2 and Taylor polynomials on [-pi/4, pi/4]
+template<typename V>
+inline void sincos(V x, V &s, V &c) {
+  V k = V::floor(x * V(0.63661977f) + V(0.5f));
+  V r = x - k * V(1.5703125f) - k * V(4.8382679e-4f);
+  V r2 = r * r;
+
+  V sr = r * (V(1.0f) + r2 * (V(-1.0f / 6.0f) + r2 * (V(1.0f / 120.0f) + r2 * (V(-1.0f / 5040.0f)
+      + r2 * V(1.0f / 362880.0f)))));
+  V cr = V(1.0f) + r2 * (V(-0.5f) + r2 * (V(1.0f / 24.0f) + r2 * (V(-1.0f / 720.0f)
+      + r2 * (V(1.0f / 40320.0f) + r2 * V(-1.0f / 3628800.0f)))));
+
+  // Quadrant k mod 4 picks and negates
+  V q = k - V(4.0f) * V::floor(k * V(0.25f));
+  auto swap = V::orMask(V::andMask(V::gt(q, V(0.5f)), V::lt(q, V(1.5f))), V::gt(q, V(2.5f)));
+  auto negSin = V::gt(q, V(1.5f));
+  auto negCos = V::andMask(V::gt(q, V(0.5f)), V::lt(q, V(2.5f)));
+
+  s = V::select(swap, cr, sr);
+  c = V::select(swap, sr, cr);
+  s = V::select(negSin, V(0.0f) - s, s);
+  c = V::select(negCos, V(0.0f) - c, c);
+}
+
+// atan for t in [0, 1], reduced once more around tan(pi/6)
+template<typename V>
+inline V atanUnit(V t) {
+  auto reduce = V::gt(t, V(0.26794919f));
+  V tr = V::select(reduce, (t - V(0.57735027f)) / (V(1.0f) + t * V(0.57735027f)), t);
+  V t2 = tr * tr;
+  V a = tr * (V(1.0f) + t2 * (V(-1.0f / 3.0f) + t2 * (V(1.0f / 5.0f) + t2 * (V(-1.0f / 7.0f)
+      + t2 * V(1.0f / 9.0f)))));
+  return V::select(reduce, a + V(0.52359878f), a);
+}
+
+template<typename V>
+inline V atan2(V y, V x) {
+  V ax = V::abs(x);
+  V ay = V::abs(y);
+  V hi = V::max(ax, ay);
+  V lo = V::min(ax, ay);
+  auto nonZero = V::gt(hi, V(0.0f));
+  V t = V::select(nonZero, lo / V::select(nonZero, hi, V(1.0f)), V(0.0f));
+
+  V a = atanUnit(t);
+  a = V::select(V::gt(ay, ax), V(1.57079633f) - a, a);
+  a = V::select(V::lt(x, V(0.0f)), V(3.14159265f) - a, a);
+  return V::select(V::lt(y, V(0.0f)), V(0.0f) - a, a);
+}
+
+template<typename V>
+inline V asin(V s) {
+  return atan2(s, V::sqrt(V::max(V(1.0f) - s * s, V(0.0f))));
+}
+
+template<typename V>
+inline void boxFold(const DEParams &p, Vec3<V> &z) {
+  V limit(p.boxFoldingLimit);
+  V negLimit(-p.boxFoldingLimit);
+  z.x = clamp(z.x, negLimit, limit) * V(2.0f) - z.x;
+  z.y = clamp(z.y, negLimit, limit) * V(2.0f) - z.y;
+  z.z = clamp(z.z, negLimit, limit) * V(2.0f) - z.z;
+}
+
+template<typename V>
+inline void sphereFold(const DEParams &p, Vec3<V> &z, V &dz) {
+  V r2 = dot(z, z);
+  V inner = V(p.sphereFixedRadius / p.sphereMinRadius);
+  V inversion = V(p.sphereFixedRadius) / V::max(r2, V(1e-30f));
+
+  V temp = V::select(V::lt(r2, V(p.sphereFixedRadius)), inversion, V(1.0f));
+  temp = V::select(V::lt(r2, V(p.sphereMinRadius)), inner, temp);
+  z = scale(z, temp);
+  dz = dz * temp;
+}
+
+template<typename V>
+inline void mandelbox(const DEParams &p, Vec3<V> &z, V &dr) {
+  Vec3<V> pos = z;
+  V boxScale(p.mandelBoxScale);
+  for (int i = 0; i < p.fractalIters; i++) {
+    boxFold(p, z);
+    sphereFold(p, z, dr);
+    z = {boxScale * z.x + pos.x, boxScale * z.y + pos.y, boxScale * z.z + pos.z};
+    dr = dr * V(std::abs(p.mandelBoxScale)) + V(1.0f);
+  }
+}
+
+template<typename V>
+inline void mandelbulb(const DEParams &p, Vec3<V> &z, V &dr, V r) {
+  V safeR = V::max(r, V(1e-30f));
+  V theta = asin(clamp(z.z / safeR, V(-1.0f), V(1.0f)));
+  V phi = atan2(z.y, z.x);
+
+  V log2r = log2(safeR);
+  V zr = exp2(V(p.power) * log2r);
+  V rPowMinusOne = exp2(V(p.power - 1.0f) * log2r);
+
+  // With Mermelada's tweak to reduce errors
+  dr = V::max(dr * V(float(p.derivativeBias)), rPowMinusOne * V(p.power) * dr + V(1.0f));
+
+  V sinTheta, cosTheta, sinPhi, cosPhi;
+  sincos(theta * V(p.power), sinTheta, cosTheta);
+  sincos(phi * V(p.power), sinPhi, cosPhi);
+
+  z = {zr * cosTheta * cosPhi, zr * cosTheta * sinPhi, zr * sinTheta};
+}
+
+// c^N for a complex number in two lanes, by squaring
+template<typename V, int N>
+inline void complexPow(V &re, V &im) {
+  V resultRe(1.0f), resultIm(0.0f);
+  for (int e = N; e > 0; e >>= 1) {
+    if (e & 1) {
+      V t = resultRe * re - resultIm * im;
+      resultIm = resultRe * im + resultIm * re;
+      resultRe = t;
+    }
+    V t = re * re - im * im;
+    im = V(2.0f) * re * im;
+    re = t;
+  }
+  re = resultRe;
+  im = resultIm;
+}
+
+template<typename V, int N>
+inline V intPow(V x) {
+  V result(1.0f);
+  for (int e = N; e > 0; e >>= 1) {
+    if (e & 1) result = result * x;
+    x = x * x;
+  }
+  return result;
+}
+
+// mandelbulb() for an integer POWER without log, exp or trig: cos and sin of
+// theta and phi as unit complex numbers raised to POWER
+template<typename V, int POWER>
+inline void mandelbulbPower(const DEParams &p, Vec3<V> &z, V &dr, V r) {
+  V safeR = V::max(r, V(1e-30f));
+  V rho = V::sqrt(z.x * z.x + z.y * z.y);
+  auto onAxis = V::le(rho, V(0.0f));
+  V invRho = V(1.0f) / V::select(onAxis, V(1.0f), rho);
+
+  V cosTheta = rho / safeR, sinTheta = z.z / safeR;
+  V cosPhi = V::select(onAxis, V(1.0f), z.x * invRho);
+  V sinPhi = V::select(onAxis, V(0.0f), z.y * invRho);
+  complexPow<V, POWER>(cosTheta, sinTheta);
+  complexPow<V, POWER>(cosPhi, sinPhi);
+
+  V rPowMinusOne = intPow<V, POWER - 1>(r);
+  dr = V::max(dr * V(float(p.derivativeBias)), rPowMinusOne * V(float(POWER)) * dr + V(1.0f));
+
+  V zr = rPowMinusOne * r;
+  z = {zr * cosTheta * cosPhi, zr * cosTheta * sinPhi, zr * sinTheta};
+}
+
+template<typename V>
+inline void recTetra(const DEParams &p, Vec3<V> &z) {
+  const float corners[4][3] = {{1, 1, 1}, {-1, -1, 1}, {1, -1, -1}, {-1, 1, -1}};
+
+  // Squared distances keep the same ordering as the shader's lengths
+  Vec3<V> c = {V(corners[0][0]), V(corners[0][1]), V(corners[0][2])};
+  Vec3<V> d0 = {z.x - c.x, z.y - c.y, z.z - c.z};
+  V dist = dot(d0, d0);
+
+  for (int i = 1; i < 4; i++) {
+    Vec3<V> a = {V(corners[i][0]), V(corners[i][1]), V(corners[i][2])};
+    Vec3<V> da = {z.x - a.x, z.y - a.y, z.z - a.z};
+    V d = dot(da, da);
+    auto closer = V::lt(d, dist);
+    c = select(closer, a, c);
+    dist = V::select(closer, d, dist);
+  }
+
+  V s(p.tetraScale);
+  V offset(p.tetraScale - 1.0f);
+  z = {s * z.x - c.x * offset, s * z.y - c.y * offset, s * z.z - c.z * offset};
+}
+
+/**
+ * One packet of DE(). Lanes past the bailout are frozen by masking instead
+ * of breaking, and the loop ends once every lane has bailed. POWER 0 is the
+ * general Mandelbulb, anything else the integer kernel.
+ */
+template<typename V, int POWER>
+void estimatePower(const DEParams &p, const float *px, const float *py, const float *pz,
+              float *distance, float *orbitTrap) {
+  Vec3<V> pos = {V::load(px), V::load(py), V::load(pz)};
+  Vec3<V> z = pos;
+  V dr(1.0f);
+  V r = V::sqrt(dot(z, z));
+
+  Vec3<V> trap = {V(0.0f), V(0.0f), V(0.0f)};
+  V trapW(0.0f);
+  if (orbitTrap) {
+    trap = {V::load(orbitTrap), V::load(orbitTrap + V::width), V::load(orbitTrap + 2 * V::width)};
+    trapW = V::load(orbitTrap + 3 * V::width);
+  }
+
+  Vec3<V> add = pos;
+  if (p.julia)
+    add = {V(p.juliaC.x), V(p.juliaC.y), V(p.juliaC.z)};
+
+  V bail(p.bailLimit);
+  for (int i = 0; i < p.fractalIters; i++) {
+    auto active = V::le(r, bail);
+    if (!V::any(active)) break;
+
+    Vec3<V> zn = z;
+    V drn = dr;
+
+    if (p.mandelbulbOn) {
+      if (POWER > 0)
+        mandelbulbPower<V, POWER>(p, zn, drn, r);
+      else
+        mandelbulb(p, zn, drn, r);
+    }
+
+    if (p.boxFoldFactor > 0) {
+      boxFold(p, zn);
+      zn = scale(zn, V(float(p.boxFoldFactor)));
+    }
+
+    if (p.sphereFoldFactor > 0) {
+      sphereFold(p, zn, drn);
+      zn = scale(zn, V(float(p.sphereFoldFactor)));
+    }
+
+    if (p.mandelBoxOn)
+      mandelbox(p, zn, drn);
+
+    if (p.tetraFactor > 0) {
+      recTetra(p, zn);
+      zn = scale(zn, V(float(p.tetraFactor)));
+    }
+
+    zn = {zn.x + add.x, zn.y + add.y, zn.z + add.z};
+
+    z = select(active, zn, z);
+    dr = V::select(active, drn, dr);
+    r = V::select(active, V::sqrt(dot(zn, zn)), r);
+
+    if (orbitTrap) {
+      trap.x = V::select(active, V::min(trap.x, V::abs(zn.x)), trap.x);
+      trap.y = V::select(active, V::min(trap.y, V::abs(zn.y)), trap.y);
+      trap.z = V::select(active, V::min(trap.z, V::abs(zn.z)), trap.z);
+      trapW = V::select(active, V::min(trapW, dot(zn, zn)), trapW);
+    }
+  }
+
+  V logR = log2(V::max(r, V(1e-30f))) * V(0.69314718f);
+  V de = V(p.fudgeFactor * 0.5f) * logR * r / dr;
+  de.store(distance);
+
+  if (orbitTrap) {
+    trap.x.store(orbitTrap);
+    trap.y.store(orbitTrap + V::width);
+    trap.z.store(orbitTrap + 2 * V::width);
+    trapW.store(orbitTrap + 3 * V::width);
+  }
+}
+
+/**
+ * estimatePower() for p.integerPower, picked once per packet
+ */
+template<typename V>
+void estimate(const DEParams &p, const float *px, const float *py, const float *pz,
+              float *distance, float *orbitTrap) {
+  switch (p.integerPower) {
+    case 2: estimatePower<V, 2>(p, px, py, pz, distance, orbitTrap); break;
+    case 3: estimatePower<V, 3>(p, px, py, pz, distance, orbitTrap); break;
+    case 4: estimatePower<V, 4>(p, px, py, pz, distance, orbitTrap); break;
+    case 5: estimatePower<V, 5>(p, px, py, pz, distance, orbitTrap); break;
+    case 6: estimatePower<V, 6>(p, px, py, pz, distance, orbitTrap); break;
+    case 7: estimatePower<V, 7>(p, px, py, pz, distance, orbitTrap); break;
+    case 8: estimatePower<V, 8>(p, px, py, pz, distance, orbitTrap); break;
+    case 9: estimatePower<V, 9>(p, px, py, pz, distance, orbitTrap); break;
+    case 10: estimatePower<V, 10>(p, px, py, pz, distance, orbitTrap); break;
+    default: estimatePower<V, 0>(p, px, py, pz, distance, orbitTrap); break;
+  }
+}
+
+}
+
+#endif //MANDELBULB_DEPACKETKERNEL_H
@@ -0,0 +1,75 @@
+#ifndef MANDELBULB_DISTANCEESTIMATOR_H
+#define MANDELBULB_DISTANCEESTIMATOR_H
+
+#include "DEPacket.hh"
+#include "FractalUniforms.hh"
+
+/**
+ * CPU port of DE() from mandel_raymarch.frag. Formula toggles are resolved
+ * from AppState once, the same way display() feeds the shader uniforms.
+ */
+class DistanceEstimator {
+  FractalUniforms u;
+  DEParams p;
+
+  // Templates on vec3 and dvec3, the same steps in float or double
+  template<typename V> void recTetra(V &z) const;
+  template<typename V> void sphereFold(V &z, decltype(V().x) &dz) const;
+  template<typename V> void boxFold(V &z) const;
+  template<typename V> void mandelbox(V &z, decltype(V().x) &dr) const;
+  template<typename V> void mandelbulb(V &z, decltype(V().x) &dr, decltype(V().x) r) const;
+
+  // Trig-free kernel for integer powers, POWER 0 is the general mandelbulb()
+  template<int POWER, typename V> void mandelbulbPower(V &z, decltype(V().x) &dr, decltype(V().x) r) const;
+  template<int POWER, typename V> decltype(V().x) estimatePower(V pos, vec4 &orbitTrap) const;
+  template<typename V> decltype(V().x) estimateWith(V pos, vec4 &orbitTrap) const;
+
+  mat3 mandelbulbJacobian(vec3 z, float r) const;
+  mat3 boxFoldJacobian(vec3 z) const;
+  mat3 sphereFoldJacobian(vec3 z) const;
+
+ public:
+  DistanceEstimator(const FractalUniforms &uniforms, const AppState &state, float time);
+
+  /**
+   * Distance estimate at pos, folding the orbit of z into orbitTrap
+   */
+  float estimate(vec3 pos, vec4 &orbitTrap) const;
+  float estimate(vec3 pos) const;
+
+  /**
+   * Same estimate in double, for deep zoom positions that a float can not tell apart
+   */
+  double estimate(dvec3 pos, vec4 &orbitTrap) const;
+  double estimate(dvec3 pos) const;
+
+  /**
+   * Hit distance for deep zoom, about half a pixel at the surface nearest the
+   * eye, or the uniform one where that is smaller
+   */
+  float deepMinDistance(dvec3 eye, float pixelAngle) const;
+
+  /**
+   * Surface normal from the Jacobian of the orbit, analyticNormal() in the shader
+   */
+  vec3 analyticNormal(vec3 pos) const;
+
+  /**
+   * Same estimate for a structure of arrays batch, see ::estimatePacket
+   */
+  void estimatePacket(SimdLevel level, size_t count, const float *x, const float *y, const float *z,
+                      float *distance, float *orbitTrap = nullptr) const {
+    ::estimatePacket(level, p, count, x, y, z, distance, orbitTrap);
+  }
+
+  /**
+   * Integer powers use the trig-free kernels unless disabled, for comparing against the general one
+   */
+  void setIntegerPowerKernels(bool enabled) { p.integerPower = enabled ? u.integerPower() : 0; }
+
+  const FractalUniforms &uniforms() const { return u; }
+  const DEParams &params() const { return p; }
+
+};
+
+#endif //MANDELBULB_DISTANCEESTIMATOR_H
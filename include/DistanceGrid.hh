@@ -0,0 +1,84 @@
+#ifndef MANDELBULB_DISTANCEGRID_H
+#define MANDELBULB_DISTANCEGRID_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "DistanceEstimator.hh"
+#include "ThreadPool.hh"
+
+/**
+ * Lower bounds of the DE over the cells of a SIZE^3 grid on the cube around
+ * the bailout sphere, for empty-space skipping. A cell holds DE() at its center
+ * less half its diagonal, or 0 where the surface may pass through it. The DE at
+ * the center is first shrunk by DE_ERROR_MARGIN, which covers both the packet
+ * kernels' approximations and the difference to the shader's float DE, so the
+ * bound stays below what the GPU marches against.
+ *
+ * Built in the background on its own thread pool, one z slice per task. A new
+ * request while a build is in flight cancels it and starts over once it has drained.
+ */
+class DistanceGrid {
+  std::vector<float> bounds;
+  std::vector<float> nextBounds;
+  float extent = 0.0f;
+  DEParams builtParams = {};
+  bool built = false;
+  float buildMS = 0.0f;
+
+  std::shared_ptr<const DistanceEstimator> inFlight;
+  std::shared_ptr<const DistanceEstimator> requested;
+  std::chrono::steady_clock::time_point buildStart;
+  std::atomic<unsigned int> slicesLeft;
+  std::atomic<bool> cancelled;
+
+  // Last so its workers are joined before the buffers they write go away
+  std::unique_ptr<ThreadPool> pool;
+
+  void start();
+  void buildSlice(const DistanceEstimator &de, unsigned int z);
+
+ public:
+  static const unsigned int SIZE = 128; // GRID_SIZE in the shader
+
+  // Relative error allowed for between the packet DE, the reference DE and the shader's
+  static constexpr float DE_ERROR_MARGIN = 4e-3f;
+
+  DistanceGrid() : slicesLeft(0), cancelled(false) {}
+  ~DistanceGrid();
+
+  DistanceGrid(const DistanceGrid &) = delete;
+  DistanceGrid &operator=(const DistanceGrid &) = delete;
+
+  /**
+   * Builds the grid for de in the background, unless that is the one built or being built
+   */
+  void request(const DistanceEstimator &de);
+
+  /**
+   * Checks on the build in flight, true when a new grid has just finished. Call once per frame.
+   */
+  bool poll();
+
+  /**
+   * True when the finished grid was built for de, a grid for other formula values is not conservative
+   */
+  bool matches(const DistanceEstimator &de) const;
+
+  bool isBuilding() const { return inFlight != nullptr; }
+
+  /**
+   * Half the side of the cube the grid covers, centered on the origin
+   */
+  float getExtent() const { return extent; }
+  float getBuildMS() const { return buildMS; }
+  const float *data() const { return bounds.data(); }
+
+  /**
+   * A little past the bailout radius, where every orbit escapes before the first iteration
+   */
+  static float extentFor(float bailLimit) { return 1.25f * bailLimit; }
+};
+
+#endif //MANDELBULB_DISTANCEGRID_H
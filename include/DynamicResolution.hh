@@ -0,0 +1,32 @@
+#ifndef MANDELBULB_DYNAMICRESOLUTION_H
+#define MANDELBULB_DYNAMICRESOLUTION_H
+
+/**
+ * Picks the render scale that keeps frame times near a budget.
+ * Scale is per axis, pixel count goes with its square.
+ */
+class DynamicResolution {
+  float smoothedMS = 0.0f;
+  float scale = 1.0f;
+
+ public:
+  bool enabled = true;
+  float targetMS = 1000.0f / 30.0f;
+  float minScale = 0.25f;
+  float maxScale = 1.0f;
+
+  /**
+   * Feed the time of the last frame, returns the scale for the next one
+   */
+  float update(float frameMS);
+
+  void reset() {
+    smoothedMS = 0.0f;
+    scale = maxScale;
+  }
+
+  float getScale() const { return enabled ? scale : 1.0f; }
+  float getSmoothedMS() const { return smoothedMS; }
+};
+
+#endif //MANDELBULB_DYNAMICRESOLUTION_H
@@ -0,0 +1,11 @@
+#ifndef MANDELBULB_EMBEDDEDSHADERS_H
+#define MANDELBULB_EMBEDDEDSHADERS_H
+
+/**
+ * Source of a file in shaders/ as it was at build time, by file name
+ * ("mandel_raymarch.frag"), or nullptr if there is no such shader.
+ * Defined in a file cmake/EmbedShaders.cmake generates.
+ */
+const char *embeddedShader(const char *name);
+
+#endif //MANDELBULB_EMBEDDEDSHADERS_H
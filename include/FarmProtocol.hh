@@ -0,0 +1,84 @@
+#ifndef MANDELBULB_FARMPROTOCOL_H
+#define MANDELBULB_FARMPROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CpuRaymarcher.hh"
+#include "Image.hh"
+
+// Messages between the render farm coordinator and its workers. Every message
+// is a 12 byte header (magic, type, payload length, little endian uint32s) and
+// the payload. The stream only needs to be reliable and ordered, so a socket
+// pair, a pipe through ssh or a TCP connection all carry it.
+
+const uint32_t FARM_MAGIC = 0x3146424d; // "MBF1"
+const uint32_t FARM_MAX_PAYLOAD = 1u << 30;
+
+enum FarmMessageType : uint32_t {
+  FARM_JOB = 1,     // Coordinator: width, height and a keyframe in text form
+  FARM_TILE = 2,    // Coordinator: tile id and rectangle to render
+  FARM_RESULT = 3,  // Worker: tile id, rectangle and its RGB rows
+  FARM_QUIT = 4,    // Coordinator: no more tiles
+  FARM_ERROR = 5    // Worker: message text, the worker exits after sending it
+};
+
+struct FarmMessage {
+  uint32_t type = 0;
+  std::vector<unsigned char> payload;
+};
+
+/**
+ * Reassembles messages from a non-blocking stream
+ */
+class FarmMessageReader {
+  std::vector<unsigned char> buffer;
+  bool corrupt = false;
+
+ public:
+
+  /**
+   * Reads what the fd has, false once it hit end of file or an error
+   */
+  bool readAvailable(int fd);
+
+  /**
+   * Takes the next complete message off the buffer
+   */
+  bool next(FarmMessage &message);
+
+  /**
+   * A bad header means the stream can no longer be trusted
+   */
+  bool isCorrupt() const { return corrupt; }
+};
+
+/**
+ * Writes the whole message, blocking if the fd is blocking
+ */
+bool sendFarmMessage(int fd, const FarmMessage &message);
+
+/**
+ * Blocking read of one whole message
+ */
+bool receiveFarmMessage(int fd, FarmMessage &message);
+
+FarmMessage farmJobMessage(unsigned int width, unsigned int height, const std::string &keyframe);
+bool parseFarmJob(const FarmMessage &message, unsigned int &width, unsigned int &height, std::string &keyframe);
+
+FarmMessage farmTileMessage(uint32_t id, const Tile &tile);
+bool parseFarmTile(const FarmMessage &message, uint32_t &id, Tile &tile);
+
+/**
+ * The tile's pixels from a tile sized image
+ */
+FarmMessage farmResultMessage(uint32_t id, const Tile &tile, const Image &pixels);
+
+/**
+ * Points pixels into the message payload, rows of 3 * (x1 - x0) bytes
+ */
+bool parseFarmResult(const FarmMessage &message, uint32_t &id, Tile &tile, const unsigned char *&pixels);
+
+FarmMessage farmTextMessage(uint32_t type, const std::string &text);
+
+#endif //MANDELBULB_FARMPROTOCOL_H
@@ -0,0 +1,52 @@
+#ifndef MANDELBULB_FILEWATCHER_H
+#define MANDELBULB_FILEWATCHER_H
+
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Tells when watched files have been written. Uses inotify on Linux, which
+ * watches the directories so editors that save by renaming a new file over
+ * the old one are seen too. Elsewhere it compares modification times a few
+ * times a second.
+ */
+class FileWatcher {
+  struct WatchedFile {
+    std::string path;
+    std::string directory;
+    std::string name; // Without the directory
+    time_t modified = 0;
+  };
+
+  std::vector<WatchedFile> files;
+  int inotifyFd = -1;
+  std::map<int, std::string> directories; // Watch descriptor to directory
+  std::chrono::steady_clock::time_point lastCheck;
+
+  bool pollInotify();
+  bool pollModified();
+
+ public:
+  FileWatcher();
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  /**
+   * Watches path, false if it can not be watched (such as a missing directory)
+   */
+  bool watch(const std::string &path);
+
+  /**
+   * True if a watched file changed since the last call, never blocks. Call once per frame.
+   */
+  bool poll();
+
+  bool empty() const { return files.empty(); }
+};
+
+#endif //MANDELBULB_FILEWATCHER_H
@@ -0,0 +1,143 @@
+#ifndef MANDELBULB_FRACTALUNIFORMS_H
+#define MANDELBULB_FRACTALUNIFORMS_H
+
+#include <cmath>
+#include <cstdlib>
+#include "types.hh"
+
+// Values fed to the raymarch shader, shared with the CPU renderer
+struct FractalUniforms {
+
+  // Renderer
+  float maxRaySteps = 1000.0;
+  float baseMinDistance = 0.00001;
+  float minDistance = baseMinDistance;
+  int minDistanceFactor = 0;
+  int fractalIters = 100;
+  float bailLimit = 5.0;
+  bool reprojection = true;
+  float reprojectionFraction = 0.9;
+  bool conePrepass = true;
+  int coneBlockSize = 8;
+  bool distanceGrid = true; // Skip empty space through a DistanceGrid of the formula
+  int debugView = 0; // 0 shaded, 1 march steps, 2 DE calls
+  bool marchStats = false;
+  int normalMode = 1; // 0 central differences, 1 tetrahedral, 2 analytic
+  int deepIterations = 4; // Deep zoom, leading Mandelbulb iterations in double-float on the GPU
+
+  // Mandelbulb
+  float power = 8.0;
+  int derivativeBias = 1;
+  bool julia = false;
+  vec3 juliaC = vec3(0.86, 0.23, -0.5);
+
+  // Box
+  int boxFoldFactor = 1;
+  float boxFoldingLimit = 1.0;
+
+  // Sphere
+  int sphereFoldFactor = 1;
+  float sphereMinRadius = 0.01;
+  float sphereFixedRadius = 2.0;
+  bool sphereMinTimeVariance = false;
+
+  // Mandelbox
+  int mandelBoxFactor = 1;
+  float mandelBoxScale = 1.2;
+
+  // Tetra
+  int tetraFactor = 1;
+  float tetraScale = 1.0;
+
+  float fudgeFactor = 1.0;
+  float noiseFactor = 0.5;
+  bool noiseTexture = true; // Baked NoiseVolume instead of simplex noise per hit
+  vec3 bgColor = vec3(0.8, 0.85, 1.0);
+  vec3 glowColor = vec3(0.75, 0.9, 1.0);
+  float glowFactor = 1.0;
+  bool showBgGradient = true;
+
+  vec4 orbitStrength = vec4(-1.0, -1.8, -1.4, 1.3);
+  vec3 otColor0 = vec3(0.3, 0.5, 0.2);
+  vec3 otColor1 = vec3(0.6, 0.2, 0.5);
+  vec3 otColor2 = vec3(0.25, 0.7, 0.9);
+  vec3 otColor3 = vec3(0.2, 0.45, 0.25);
+  vec3 otColorBase = vec3(0.3, 0.6, 0.3);
+  float otBaseStrength = 0.5;
+  float otDist0to1 = 0.3;
+  float otDist1to2 = 1.0;
+  float otDist2to3 = 0.4;
+  float otDist3to0 = 0.2;
+  float otCycleIntensity = 5.0;
+  float otPaletteOffset = 0.0;
+
+  int shadowRayMinStepsTaken = 5;
+  vec3 lightPos = vec3(3.0, 3.0, 10.0);
+  float shadowBrightness = 0.2f;
+  float shadowSharpness = 16.0f; // Penumbra gets narrower as it grows
+  int shadowScale = 2; // Shadow pass at 1 / shadowScale resolution, 0 in the main pass
+  bool lightSource = true;
+  float phongShadingMixFactor = 1.0;
+  float ambientIntensity = 1.0;
+  float diffuseIntensity = 1.0;
+  float specularIntensity = 1.0;
+  float shininess = 32.0;
+  bool gammaCorrection = false;
+
+  /**
+   * Lower settings for weak computers
+   */
+  void applyWeakSettings() {
+    maxRaySteps = 200.0;
+    fractalIters = 20;
+    minDistanceFactor = 3;
+    power = 6.0;
+  }
+
+  /**
+   * Adjust the min distance by a decimal
+   */
+  void updateMinDistance() {
+    if (minDistanceFactor < 0) {
+      minDistance = baseMinDistance / ((float)(pow(10.0, abs(minDistanceFactor))));
+    } else if (minDistanceFactor > 0) {
+      minDistance = baseMinDistance * ((float)(pow(10.0, minDistanceFactor)));
+    } else {
+      minDistance = baseMinDistance;
+    }
+  }
+
+  /**
+   * Power as an int when it has a trig-free Mandelbulb kernel, 0 otherwise
+   */
+  int integerPower() const {
+    if (power < 2.0f || power > 10.0f || power != floor(power))
+      return 0;
+    return (int) power;
+  }
+};
+
+// App state
+struct AppState {
+  bool mandelbulbOn = true;
+  bool boxFoldingOn = false;
+  bool sphereFoldingOn = false;
+  bool mandelBoxOn = false;
+  bool recursiveTetraOn = false;
+
+  bool lowOtCycleIntensity = false;
+  bool specializedShaders = true;
+
+  // Camera in double and rays relative to the eye, for zooming past float precision
+  bool deepZoom = false;
+
+  bool logCoordinates = false;
+  bool weakSettings = false;
+  int nbFrames = 0;
+  int displayedFrames = 0;
+  float displayedMS = 0;
+  double lastTime = 0.0;
+  double lastFrameTime = 0.0;
+};
+
+#endif //MANDELBULB_FRACTALUNIFORMS_H
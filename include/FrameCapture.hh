@@ -0,0 +1,113 @@
+#ifndef MANDELBULB_FRAMECAPTURE_H
+#define MANDELBULB_FRAMECAPTURE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+enum CaptureMode {
+  CAPTURE_OFF,
+  CAPTURE_IMAGES, // Numbered PNG or PPM files
+  CAPTURE_Y4M     // Raw video to a file, named pipe or stdout
+};
+
+/**
+ * Captures frames without stalling the pipeline. glReadPixels goes into the
+ * next pixel buffer object of a ring, fenced, and a buffer is only mapped
+ * once its fence has signalled, a frame or two later. Mapped frames are
+ * encoded and written on a writer thread. When the ring or the writer's
+ * queue is full the frame is dropped rather than waited for.
+ */
+class FrameCapture {
+ public:
+  static const unsigned int RING_SIZE = 3;
+  static const unsigned int MAX_QUEUED = 8; // Frames waiting for the writer
+
+ private:
+  struct Slot {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    unsigned int width = 0, height = 0;
+  };
+
+  // RGBA rows bottom to top, as GL reads them
+  struct Frame {
+    unsigned int width = 0, height = 0;
+    unsigned int index = 0;
+    std::vector<unsigned char> pixels;
+  };
+
+  Slot slots[RING_SIZE];
+  unsigned int oldestSlot = 0;
+  unsigned int slotsInFlight = 0;
+
+  CaptureMode mode = CAPTURE_OFF;
+  std::string target;
+  int fps = 30;
+  unsigned int frameLimit = 0; // 0 for no limit
+  unsigned int framesRead = 0;
+  unsigned int framesDropped = 0;
+  std::atomic<unsigned int> framesWritten;
+  std::atomic<bool> writeFailed;
+
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Frame> queue;
+  bool finishing = false;
+
+  // Only touched by the writer once it runs
+  FILE *video = nullptr;
+  unsigned int videoWidth = 0, videoHeight = 0;
+
+  void collect(bool wait);
+  void finish();
+  void writerLoop(CaptureMode writeMode);
+  bool writeImage(const Frame &frame);
+  bool writeY4M(const Frame &frame);
+  void openVideo();
+
+ public:
+  FrameCapture() : framesWritten(0), writeFailed(false) {}
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  /**
+   * Starts capturing, stopping any capture in progress. Images go to target as a
+   * printf pattern of the frame number, Y4M to target as a file or pipe, "-" for
+   * stdout, which moves the program's own output over to stderr. Makes no GL
+   * calls, so a capture can be set up before the context exists.
+   *
+   * @param frameLimit Frames to capture before stopping on its own, 0 for no limit
+   */
+  bool start(CaptureMode mode, const std::string &target, int fps = 30, unsigned int frameLimit = 0);
+
+  /**
+   * Waits for the frames in the ring and the writer, needs the GL context.
+   * A capture that reaches its frame limit ends by itself without waiting.
+   */
+  void stop();
+
+  /**
+   * Reads the w x h back buffer into the ring and hands finished readbacks to
+   * the writer. Call once a frame, after drawing what should be captured.
+   */
+  void capture(unsigned int w, unsigned int h);
+
+  bool active() const { return mode != CAPTURE_OFF; }
+  CaptureMode getMode() const { return mode; }
+  unsigned int framesCaptured() const { return framesRead; }
+  unsigned int droppedFrames() const { return framesDropped; }
+  unsigned int writtenFrames() const { return framesWritten; }
+  bool failed() const { return writeFailed; }
+};
+
+#endif //MANDELBULB_FRAMECAPTURE_H
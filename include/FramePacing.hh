@@ -0,0 +1,82 @@
+#ifndef MANDELBULB_FRAMEPACING_H
+#define MANDELBULB_FRAMEPACING_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+enum SwapMode { SWAP_DRIVER, SWAP_OFF, SWAP_VSYNC, SWAP_HALF, SWAP_ADAPTIVE };
+
+/**
+ * Swap interval, frame cap and how many frames the GPU may have queued, and
+ * the latency from the input a frame drew to the GPU finishing it. A fence
+ * and a GL_TIMESTAMP query follow every swap. Waiting on old fences keeps the
+ * queue short. A fence is only seen signaled when it is polled, up to a frame
+ * late, so the latency ends at the timestamp instead, moved onto the
+ * glfwGetTime() clock.
+ */
+class FramePacing {
+  struct PendingFrame {
+    GLsync fence;
+    GLuint timestamp;
+    double inputTime;
+  };
+
+  std::deque<PendingFrame> pending;
+  std::vector<GLuint> freeQueries;
+  double gpuClockOffset = 0.0; // glfwGetTime() less the GL_TIMESTAMP clock, in seconds
+  bool gpuClockSynced = false;
+  int appliedSwapMode = -1;
+  double frameInputTime = 0.0;
+  double lastFrameStart = 0.0;
+
+  // Frames finished in the current second, shown once it is over
+  double windowStart = 0.0;
+  double latencySum = 0.0;
+  double latencyMax = 0.0;
+  unsigned int latencyCount = 0;
+  float latencyMS = 0.0f;
+  float maxLatencyMS = 0.0f;
+
+  void applySwapMode();
+  void syncGpuClock();
+  bool finishOldest(bool wait);
+  void record(double latency, double now);
+
+ public:
+  static const unsigned int MAX_PENDING = 8;
+
+  int swapMode = SWAP_DRIVER; // Never sets the interval, leaving the driver's until another mode is picked
+  int maxFPS = 0;         // 0 for no cap
+  int framesInFlight = 0; // 1 or 2, 0 leaves it to the driver
+  bool logLatency = false;
+
+  /**
+   * Waits out the frame cap and for the GPU to get below framesInFlight.
+   * Call before the frame takes its input, so the input is as new as it can be.
+   */
+  void beginFrame();
+
+  /**
+   * glfwGetTime() of the input the frame draws
+   */
+  void setInputTime(double time) { frameInputTime = time; }
+
+  /**
+   * Fences the frame, call right after the swap
+   */
+  void endFrame();
+
+  /**
+   * Average and worst input to present latency over the last second
+   */
+  float getLatencyMS() const { return latencyMS; }
+  float getMaxLatencyMS() const { return maxLatencyMS; }
+  unsigned int pendingCount() const { return (unsigned int) pending.size(); }
+
+  static bool parseSwapMode(const std::string &name, int &mode);
+  static const char *swapModeName(int mode);
+};
+
+#endif //MANDELBULB_FRAMEPACING_H
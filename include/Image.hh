@@ -0,0 +1,43 @@
+#ifndef MANDELBULB_IMAGE_H
+#define MANDELBULB_IMAGE_H
+
+#include <string>
+#include <vector>
+#include "types.hh"
+
+/**
+ * 8-bit RGB image, rows stored top to bottom
+ */
+struct Image {
+  unsigned int width = 0, height = 0;
+  std::vector<unsigned char> pixels;
+
+  Image() = default;
+  Image(unsigned int w, unsigned int h) : width(w), height(h), pixels(3 * w * h, 0) {};
+
+  /**
+   * Store a color clamped to [0, 1] the way GL converts to a unorm8 target
+   */
+  void setPixel(unsigned int x, unsigned int y, vec3 color);
+
+  bool writePPM(const std::string &fileName) const;
+
+  /**
+   * Dependency free PNG writer using stored (uncompressed) deflate blocks
+   */
+  bool writePNG(const std::string &fileName) const;
+
+  /**
+   * Pick the format from the file extension, PNG unless it ends in .ppm
+   */
+  bool write(const std::string &fileName) const;
+};
+
+/**
+ * True if pattern holds exactly one %u, %0Nu or %d for the frame number and no
+ * other conversion but %%, so it can go to snprintf with one unsigned int.
+ * Without numbered, a fixed name with no conversion is accepted too.
+ */
+bool validFramePattern(const std::string &pattern, bool numbered = true);
+
+#endif //MANDELBULB_IMAGE_H
@@ -0,0 +1,76 @@
+#ifndef MANDELBULB_KEYFRAMES_H
+#define MANDELBULB_KEYFRAMES_H
+
+#include <istream>
+#include <string>
+#include <vector>
+#include "CpuRaymarcher.hh"
+#include "FractalUniforms.hh"
+#include "types.hh"
+
+/**
+ * Camera and fractal state at one frame of an animation
+ */
+struct Keyframe {
+  unsigned int frame = 0;
+  dvec3 eye = dvec3(0.0, 0.0, 3.0); // Double for deep zoom
+  dvec3 center = dvec3(0.0);
+  dvec3 up = dvec3(0.0, 1.0, 0.0);
+  float time = 0.0f; // u_time
+  FractalUniforms u;
+  AppState state;
+};
+
+/**
+ * Keyframe file, plain text with one setting per line:
+ *
+ *   keyframe 0
+ *   eye 0 0 3
+ *   center 0 0 0
+ *   power 8
+ *   keyframe 240
+ *   power 10
+ *
+ * Every keyframe starts as a copy of the one before, so it only lists what
+ * changes. Names are the FractalUniforms and AppState members, plus eye,
+ * center, up, time and "camera r theta phi" for the explorer's spherical
+ * coordinates. Floats and vectors follow a Catmull-Rom spline through the
+ * keyframes, ints and bools hold until the next keyframe.
+ */
+class KeyframeTrack {
+  std::vector<Keyframe> keys;
+
+ public:
+
+  /**
+   * Reads a keyframe file on top of the given defaults, prints what is wrong and returns false on errors
+   */
+  bool load(const std::string &fileName, const FractalUniforms &u, const AppState &state);
+
+  /**
+   * load() from a stream, sourceName only shows in the error messages
+   */
+  bool parse(std::istream &in, const std::string &sourceName, const FractalUniforms &u, const AppState &state);
+
+  /**
+   * State at any frame, clamped to the first and last keyframe
+   */
+  Keyframe at(unsigned int frame) const;
+
+  bool empty() const { return keys.empty(); }
+  unsigned int frameCount() const { return keys.empty() ? 0 : keys.back().frame + 1; }
+  const std::vector<Keyframe> &keyframes() const { return keys; }
+
+  /**
+   * A complete keyframe in the format load() reads
+   */
+  static std::string format(const Keyframe &key);
+};
+
+/**
+ * Camera of a keyframe with the explorer's perspective projection
+ */
+RenderView keyframeView(const Keyframe &key, unsigned int width, unsigned int height,
+                        float fov, float nearPlane, float farPlane);
+
+#endif //MANDELBULB_KEYFRAMES_H
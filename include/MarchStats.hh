@@ -0,0 +1,78 @@
+#ifndef MANDELBULB_MARCHSTATS_H
+#define MANDELBULB_MARCHSTATS_H
+
+#include <cstdint>
+#include <GL/glew.h>
+
+/**
+ * MarchStats shader storage block in mandel_raymarch.frag, std430
+ */
+struct MarchCounters {
+  uint32_t rays;
+  uint32_t escapedRays;
+  uint32_t marchSteps; // One DE call each
+  uint32_t maxMarchSteps;
+  uint32_t normalDECalls;
+  uint32_t shadowDECalls;
+  uint32_t marchStepsHigh; // Carried by the shader when the low words wrap
+  uint32_t normalDECallsHigh;
+  uint32_t shadowDECallsHigh;
+  uint32_t padding[3];
+
+  uint64_t totalMarchSteps() const { return (uint64_t) marchStepsHigh << 32 | marchSteps; }
+  uint64_t totalNormalDECalls() const { return (uint64_t) normalDECallsHigh << 32 | normalDECalls; }
+  uint64_t totalShadowDECalls() const { return (uint64_t) shadowDECallsHigh << 32 | shadowDECalls; }
+
+  double averageSteps() const { return rays ? (double) totalMarchSteps() / rays : 0.0; }
+  double escapedFraction() const { return rays ? (double) escapedRays / rays : 0.0; }
+  uint64_t totalDECalls() const { return totalMarchSteps() + totalNormalDECalls() + totalShadowDECalls(); }
+};
+
+/**
+ * Frame totals of the raymarch pass, counted by the shader with atomics.
+ * Each frame gets its own buffer from a small ring and is read back once its
+ * fence has passed, a few frames late but without waiting on the GPU.
+ */
+class MarchStats {
+  static const int RING_SIZE = 3;
+
+  GLuint buffers[RING_SIZE] = {};
+  GLsync fences[RING_SIZE] = {};
+  GLuint binding;
+  int current = 0;
+  MarchCounters latest = {};
+  bool hasLatest = false;
+
+ public:
+  explicit MarchStats(GLuint binding) : binding(binding) {};
+
+  /**
+   * Creates the buffers, needs a current GL context
+   */
+  void init();
+
+  /**
+   * Points the program's storage block at the binding, call again after relinking
+   */
+  void attach(GLuint program) const;
+
+  /**
+   * Clears the next buffer in the ring and binds it for the draw that follows
+   */
+  void begin();
+
+  /**
+   * Fences the draw counted since begin()
+   */
+  void end();
+
+  /**
+   * Reads back finished frames, returns true if there are new totals
+   */
+  bool poll();
+
+  const MarchCounters &getLatest() const { return latest; }
+  bool hasResults() const { return hasLatest; }
+};
+
+#endif //MANDELBULB_MARCHSTATS_H
@@ -0,0 +1,77 @@
+#ifndef MANDELBULB_MESHEXTRACTOR_H
+#define MANDELBULB_MESHEXTRACTOR_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "DistanceEstimator.hh"
+#include "MeshFile.hh"
+#include "ThreadPool.hh"
+
+/**
+ * Cube polygonised by MeshExtractor, resolution^3 cells split into chunks of chunkSize^3
+ */
+struct MeshVolume {
+  vec3 center = vec3(0.0f);
+  float extent = 1.5f; // Half the side of the cube
+  unsigned int resolution = 512;
+  unsigned int chunkSize = 64;
+  float iso = 0.0f; // Surface at DE = iso, 0 for half a cell
+};
+
+/**
+ * Where an extraction is, handed to the progress callback after every slab of chunks
+ */
+struct MeshProgress {
+  unsigned int slabsDone = 0;
+  unsigned int slabCount = 0;
+  uint64_t vertices = 0;
+  uint64_t triangles = 0;
+  uint64_t samples = 0; // DE evaluations
+  unsigned int chunksSkipped = 0; // Known to be empty from their center
+  double seconds = 0.0;
+};
+
+typedef std::function<void(const MeshProgress &progress)> MeshProgressFunc;
+
+/**
+ * Surface of the DE as a triangle mesh, by naive surface nets: one vertex per
+ * cell the surface passes through, at the mean of its edge crossings, and a
+ * quad around every grid edge the surface crosses.
+ *
+ * Chunks are sampled and polygonised on the thread pool a slab (one layer of
+ * chunks along z) at a time, the next slab computing while the current one is
+ * written. A quad refers to cells of the chunks before it in -x, -y and -z, so
+ * the cells on each chunk's far faces keep their vertex index until the slab
+ * after has been written. Memory stays at about two slabs whatever the resolution.
+ */
+class MeshExtractor {
+  struct ChunkMesh;
+  struct Slab;
+
+  const DistanceEstimator &de;
+  MeshVolume volume;
+  float cellSize;
+  float iso;
+  unsigned int chunksPerSide;
+
+  // Global vertex index of the cells on the far faces of the chunks written so far
+  std::unordered_map<uint64_t, uint32_t> previousBorder;
+  std::unordered_map<uint64_t, uint32_t> currentBorder;
+
+  void polygonise(ChunkMesh &chunk) const;
+  void submitSlab(ThreadPool &pool, Slab &slab, unsigned int cz) const;
+  bool writeChunk(ChunkMesh &chunk, MeshFile &file, MeshProgress &progress);
+
+ public:
+  MeshExtractor(const DistanceEstimator &de, const MeshVolume &volume);
+
+  /**
+   * Streams the mesh into file, false if writing fails or the indices would not fit 32 bits
+   */
+  bool extract(ThreadPool &pool, MeshFile &file, const MeshProgressFunc &progress);
+};
+
+#endif //MANDELBULB_MESHEXTRACTOR_H
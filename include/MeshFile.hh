@@ -0,0 +1,53 @@
+#ifndef MANDELBULB_MESHFILE_H
+#define MANDELBULB_MESHFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "types.hh"
+
+/**
+ * Triangle mesh streamed to disk, binary little endian PLY unless the file
+ * name ends in .obj. Every vertex must be added before the triangles using it.
+ *
+ * OBJ is written as it comes. PLY needs the counts in the header, so the
+ * vertices and triangles go to two side files that close() joins behind it.
+ * Either way nothing is held in memory and the file only appears once complete.
+ */
+class MeshFile {
+  std::string fileName;
+  bool obj = false;
+  FILE *out = nullptr;   // OBJ, or the PLY vertices
+  FILE *faces = nullptr; // PLY triangles
+  uint64_t vertexCount = 0;
+  uint64_t triangleCount = 0;
+
+  std::string sideFileName(const char *part) const;
+  void discard();
+
+ public:
+  MeshFile() = default;
+  ~MeshFile();
+
+  MeshFile(const MeshFile &) = delete;
+  MeshFile &operator=(const MeshFile &) = delete;
+
+  bool open(const std::string &fileName);
+
+  bool addVertices(const vec3 *vertices, size_t count);
+
+  /**
+   * count triangles of three zero based vertex indices each
+   */
+  bool addTriangles(const uint32_t *indices, size_t count);
+
+  /**
+   * Writes the finished file under its name
+   */
+  bool close();
+
+  uint64_t vertices() const { return vertexCount; }
+  uint64_t triangles() const { return triangleCount; }
+};
+
+#endif //MANDELBULB_MESHFILE_H
@@ -0,0 +1,46 @@
+#ifndef MANDELBULB_NOISEVOLUME_H
+#define MANDELBULB_NOISEVOLUME_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.hh"
+
+/**
+ * Gradient noise baked into a SIZE^3 volume of 8 bit texels. It tiles every
+ * PERIOD noise units, so the raymarch shader samples it with GL_REPEAT and
+ * trilinear filtering in place of two snoise() octaves per hit.
+ */
+class NoiseVolume {
+  std::vector<uint8_t> texels;
+
+ public:
+  static const unsigned int SIZE = 128;
+  static const int PERIOD = 16; // Lattice cells per tile, NOISE_PERIOD in the shader
+
+  /**
+   * Fills the volume, the same on every platform
+   */
+  void bake();
+
+  /**
+   * Reads a volume written by save(), false if it is missing or does not match SIZE and PERIOD
+   */
+  bool load(const std::string &fileName);
+  bool save(const std::string &fileName) const;
+
+  /**
+   * Noise in [-1, 1] at p in noise units, filtered like texture() on the GL volume
+   */
+  float sample(vec3 p) const;
+
+  bool empty() const { return texels.empty(); }
+  const uint8_t *data() const { return texels.data(); }
+
+  /**
+   * Baked on first use, for the CPU renderer
+   */
+  static const NoiseVolume &shared();
+};
+
+#endif //MANDELBULB_NOISEVOLUME_H
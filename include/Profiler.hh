@@ -0,0 +1,138 @@
+#ifndef MANDELBULB_PROFILER_H
+#define MANDELBULB_PROFILER_H
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <GL/glew.h>
+
+/**
+ * Sections timed every frame. CPU ones are wall clock scopes on the render
+ * thread, but for event polling and input on the main thread. GPU ones are
+ * GL_TIME_ELAPSED queries around the GL calls.
+ */
+enum ProfileSection {
+  PROFILE_POLL_EVENTS, // Main thread
+  PROFILE_INPUT,       // Main thread
+  PROFILE_PACING,
+  PROFILE_DISPLAY,
+  PROFILE_GUI,
+  PROFILE_SWAP,
+  PROFILE_CAPTURE,
+  PROFILE_GPU_RAYMARCH,
+  PROFILE_GPU_SHADOWS,
+  PROFILE_GPU_IMGUI,
+  PROFILE_GPU_SWAP,
+  PROFILE_SECTION_COUNT
+};
+
+/**
+ * Per frame CPU and GPU timings with rolling histories and Chrome trace export.
+ * GPU queries go to a ring a few frames deep and are only read back once the
+ * driver reports them available, so timing never stalls the pipeline.
+ */
+class Profiler {
+ public:
+  static const int HISTORY_SIZE = 120;
+  static const int QUERY_FRAMES = 4;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct TraceEvent {
+    ProfileSection section;
+    double startUS;
+    double durationUS;
+  };
+
+  struct GpuQuery {
+    GLuint query = 0;
+    double submitUS = 0.0; // Where the trace puts it, GPU clocks are not synced to the CPU's
+    bool pending = false;
+  };
+
+  Clock::time_point epoch = Clock::now();
+  double cpuStartUS[PROFILE_SECTION_COUNT] = {};
+  float frameMS[PROFILE_SECTION_COUNT] = {};
+  float history[PROFILE_SECTION_COUNT][HISTORY_SIZE] = {};
+  float averageMS[PROFILE_SECTION_COUNT] = {};
+  int historyOffset = 0;
+
+  GpuQuery queries[QUERY_FRAMES][PROFILE_SECTION_COUNT];
+  bool queriesCreated = false;
+  unsigned int frame = 0;
+  bool recording = false; // Whether the current frame is being timed
+  ProfileSection openGpuSection = PROFILE_SECTION_COUNT;
+
+  std::deque<TraceEvent> trace;
+
+  // Main thread times since the render thread last took them
+  std::mutex mainThreadMutex;
+  std::vector<TraceEvent> mainThreadEvents;
+
+  void record(ProfileSection section, double startUS, double durationUS);
+  void takeMainThreadEvents();
+  void readBack(unsigned int ringIndex);
+
+ public:
+  bool enabled = false;
+  size_t maxTraceEvents = 1 << 16;
+
+  /**
+   * Reads back finished GPU queries and starts a new frame, call before anything is timed
+   */
+  void beginFrame();
+
+  /**
+   * Moves the times of the frame into the histories
+   */
+  void endFrame();
+
+  void beginCpu(ProfileSection section);
+  void endCpu(ProfileSection section);
+
+  /**
+   * Main thread side, a section that started at startUS and ends now. Counted
+   * in the frame the render thread begins next.
+   */
+  void addMainThreadTime(ProfileSection section, double startUS);
+
+  /**
+   * GL_TIME_ELAPSED queries do not nest, only one GPU section can be open at a time
+   */
+  void beginGpu(ProfileSection section);
+  void endGpu();
+
+  double nowUS() const;
+
+  const float *getHistory(ProfileSection section) const { return history[section]; }
+  int getHistoryOffset() const { return historyOffset; }
+  float getAverageMS(ProfileSection section) const { return averageMS[section]; }
+  size_t traceEventCount() const { return trace.size(); }
+
+  /**
+   * Writes the buffered events in the Chrome trace event format (chrome://tracing, Perfetto)
+   */
+  bool writeChromeTrace(const char *fileName) const;
+
+  static const char *sectionName(ProfileSection section);
+  static bool isGpuSection(ProfileSection section) { return section >= PROFILE_GPU_RAYMARCH; }
+  static bool isMainThreadSection(ProfileSection section) { return section <= PROFILE_INPUT; }
+};
+
+/**
+ * Times a CPU section for the lifetime of the scope
+ */
+class ProfileScope {
+  Profiler &profiler;
+  ProfileSection section;
+
+ public:
+  ProfileScope(Profiler &profiler, ProfileSection section) : profiler(profiler), section(section) {
+    profiler.beginCpu(section);
+  }
+  ~ProfileScope() { profiler.endCpu(section); }
+};
+
+#endif //MANDELBULB_PROFILER_H
@@ -0,0 +1,42 @@
+#ifndef MANDELBULB_PROGRAMBINARYCACHE_H
+#define MANDELBULB_PROGRAMBINARYCACHE_H
+
+#include <string>
+#include <GL/glew.h>
+
+/**
+ * Linked programs saved with glGetProgramBinary, one file per program under
+ * $XDG_CACHE_HOME/mandelbulb (~/.cache/mandelbulb). Files are named by a hash
+ * of the driver string and the sources, so a driver update or a shader edit
+ * misses and compiles again. Drivers may still reject a binary, which is a miss too.
+ */
+class ProgramBinaryCache {
+  std::string directory;
+  std::string driver;
+  bool supported = false;
+
+  std::string fileName(const std::string &vertSource, const std::string &fragSource) const;
+
+ public:
+
+  /**
+   * Reads the driver string and checks for binary formats, needs a current GL context
+   */
+  void init();
+
+  /**
+   * The cached program for the sources, 0 if there is none or the driver turns it down.
+   * compileMS is how long compiling took when the binary was stored.
+   */
+  GLuint load(const std::string &vertSource, const std::string &fragSource, float &compileMS) const;
+
+  /**
+   * Saves a linked program, best done for ones linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+   */
+  void store(GLuint program, const std::string &vertSource, const std::string &fragSource, float compileMS) const;
+
+  bool enabled() const { return supported; }
+  const std::string &getDirectory() const { return directory; }
+};
+
+#endif //MANDELBULB_PROGRAMBINARYCACHE_H
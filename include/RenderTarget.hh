@@ -0,0 +1,69 @@
+#ifndef MANDELBULB_RENDERTARGET_H
+#define MANDELBULB_RENDERTARGET_H
+
+#include <GL/glew.h>
+
+/**
+ * Offscreen RGBA32F color buffer. Storage is allocated once per capacity and frames
+ * render into its lower left corner, so changing the scale never reallocates.
+ *
+ * A second attachment takes per-pixel hit history. It ping-pongs between two
+ * textures so a frame can read the previous frame's history while writing its own.
+ *
+ * With shadows in their own pass the raymarch writes a third, lit color
+ * attachment instead, which the shadow composite then draws into the color.
+ */
+class RenderTarget {
+  GLuint fbo = 0;
+  GLuint colorFbo = 0;
+  GLuint colorTexture = 0;
+  GLuint litTexture = 0;
+  GLuint historyTextures[2] = {0, 0};
+  int historyWrite = 0;
+  unsigned int capacityWidth = 0, capacityHeight = 0;
+  unsigned int width = 0, height = 0;
+
+  void allocate(GLuint texture, GLenum format) const;
+
+ public:
+
+  /**
+   * Makes room for at least w x h pixels, needs a current GL context.
+   * Returns true if storage was (re)allocated, which discards the history.
+   */
+  bool reserve(unsigned int w, unsigned int h);
+
+  /**
+   * Binds the framebuffer with a w x h viewport, drawing color and history
+   */
+  void bind(unsigned int w, unsigned int h);
+
+  /**
+   * bind() with the color going to the lit texture
+   */
+  void bindLit(unsigned int w, unsigned int h);
+
+  /**
+   * Binds a framebuffer with only the color, for passes that read the other textures
+   */
+  void bindColor(unsigned int w, unsigned int h);
+
+  /**
+   * Upscales the last rendered region to the default framebuffer and binds it again
+   */
+  void blitToScreen(unsigned int screenWidth, unsigned int screenHeight) const;
+
+  /**
+   * Makes the history just written the previous history
+   */
+  void swapHistory();
+
+  unsigned int getWidth() const { return width; }
+  unsigned int getHeight() const { return height; }
+  GLuint getTexture() const { return colorTexture; }
+  GLuint getLitTexture() const { return litTexture; }
+  GLuint getHistory() const { return historyTextures[historyWrite]; }
+  GLuint getPreviousHistory() const { return historyTextures[1 - historyWrite]; }
+};
+
+#endif //MANDELBULB_RENDERTARGET_H
@@ -0,0 +1,185 @@
+#ifndef MANDELBULB_SHADERCACHE_H
+#define MANDELBULB_SHADERCACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <GL/glew.h>
+#include "FractalUniforms.hh"
+#include "ProgramBinaryCache.hh"
+#include "ShaderCompileThread.hh"
+
+typedef void (* ProgramReadyFunc)(GLuint program);
+
+/**
+ * Raymarch programs specialized for one formula set. The key packs the toggle
+ * bits, an integer Mandelbulb power and the fold/tetra factors, see permutationKey().
+ */
+class ShaderCache {
+  typedef std::chrono::steady_clock Clock;
+
+  // Programs built from the plain sources, each with its own define
+  enum Pass { PASS_UBER, PASS_CONE, PASS_SHADOW, PASS_SHADOW_COMPOSITE, PASS_COUNT };
+
+  struct Entry {
+    GLuint program = 0;
+    GLuint vertShader = 0;
+    GLuint fragShader = 0;
+    bool ready = false;
+    bool failed = false;
+    unsigned int startFrame = 0;
+    Clock::time_point startTime;
+    std::shared_ptr<ShaderCompileThread::Job> job; // Compiling on the compile thread
+
+    // Kept while compiling for the binary cache
+    std::string vertSource;
+    std::string fragSource;
+  };
+
+  const char *vertFileName;
+  const char *fragFileName;
+  std::string vertSource;
+  std::string fragSource;
+  Entry passes[PASS_COUNT];
+  ProgramReadyFunc readyFunc;
+  bool parallelCompile = false;
+  GLFWwindow *compileContext = nullptr;
+  ShaderCompileThread compileThread;
+  unsigned int frame = 0;
+  ProgramBinaryCache binaryCache;
+  bool binaryCacheReady = false;
+
+  std::map<uint32_t, Entry> programs;
+
+  // reload() in flight, swapped in for passes once every one of them has linked
+  Entry reloadPasses[PASS_COUNT];
+  std::string reloadVertSource;
+  std::string reloadFragSource;
+  std::string reloadErrors;
+  bool reloading = false;
+  Clock::time_point reloadStart;
+  unsigned int generation = 0;
+
+  std::string errors;
+
+  /**
+   * Reads the file if it is there, the source built into the executable
+   * otherwise. True if it came from disk.
+   */
+  static bool readSource(const char *fileName, std::string &source);
+  static float millisecondsSince(Clock::time_point start);
+  static const char *passDefines(int pass);
+
+  /**
+   * Takes the program from the binary cache, or starts compiling it without
+   * waiting. Entries from the cache are ready straight away. In the background
+   * it goes to the compile thread when there is one.
+   */
+  bool startCompile(Entry &entry, const std::string &vs, const std::string &fs, float &cachedCompileMS,
+                    bool background);
+  bool isCompileDone(const Entry &entry) const;
+
+  /**
+   * Link status of a compile that is done, the info logs are added to log when it failed
+   */
+  bool finishCompile(Entry &entry, const std::string &name, std::string &log);
+  void deleteEntry(Entry &entry);
+  void initCompile();
+  void pollReload();
+  void clear();
+
+ public:
+  ShaderCache(const char *vertFileName, const char *fragFileName, ProgramReadyFunc readyFunc)
+      : vertFileName(vertFileName), fragFileName(fragFileName), readyFunc(readyFunc) {};
+
+  /**
+   * Hidden context sharing objects with the render one. Without
+   * KHR_parallel_shader_compile, programs are compiled on a thread current on
+   * it, set it before load(). Without either, reloads block once linked.
+   */
+  void setCompileContext(GLFWwindow *context) { compileContext = context; }
+
+  /**
+   * Stops the compile thread, call on the render thread before its context goes
+   */
+  void shutdown() { compileThread.stop(); }
+
+  /**
+   * False when a reload has to wait for the link on the render thread
+   */
+  bool compilesInBackground() const { return parallelCompile || compileThread.running(); }
+
+  /**
+   * Compiles the uber-shader and the extra passes synchronously and reads the sources for the permutations.
+   * Programs come from the binary cache when it has them for these sources and this driver.
+   */
+  void load();
+
+  /**
+   * Rereads the sources and compiles them in the background. The new programs
+   * replace the current ones, permutations included, only once all of them
+   * have linked. Until then, and for good when one fails, the old ones stay.
+   * A reload while one is in flight starts over with the newer sources.
+   */
+  void reload();
+
+  /**
+   * Checks on compiles in flight, call once per frame
+   */
+  void poll();
+
+  /**
+   * The specialized program for the current formula set if it is ready, the
+   * uber-shader otherwise. Starts compiling the permutation on first request.
+   * Always the uber-shader when canSpecialize() is false.
+   */
+  GLuint programFor(const FractalUniforms &u, const AppState &state);
+
+  /**
+   * Permutations are only linked while drawing when that never waits on the
+   * render thread, with KHR_parallel_shader_compile or the compile thread
+   */
+  bool canSpecialize() const { return compilesInBackground(); }
+
+  GLuint uberProgram() const { return passes[PASS_UBER].program; }
+
+  /**
+   * Uber-shader built with CONE_PREPASS, marches one cone per pixel block
+   */
+  GLuint conePrepassProgram() const { return passes[PASS_CONE].program; }
+
+  /**
+   * Uber-shader built with SHADOW_PASS, one shadow ray per block of pixels
+   */
+  GLuint shadowPassProgram() const { return passes[PASS_SHADOW].program; }
+
+  /**
+   * Built with SHADOW_COMPOSITE, upsamples the shadows onto the lit color
+   */
+  GLuint shadowCompositeProgram() const { return passes[PASS_SHADOW_COMPOSITE].program; }
+  unsigned int pendingCount() const;
+  unsigned int readyCount() const;
+
+  bool isReloading() const { return reloading; }
+
+  /**
+   * Counts swaps to new programs. Program names can be reused, so uniform locations are looked up again when it changes.
+   */
+  unsigned int getGeneration() const { return generation; }
+
+  /**
+   * Compile and link logs of the last failed program, empty when everything built
+   */
+  const std::string &getErrors() const { return errors; }
+  void clearErrors() { errors.clear(); }
+
+  const char *getVertFileName() const { return vertFileName; }
+  const char *getFragFileName() const { return fragFileName; }
+
+  static bool permutationKey(const FractalUniforms &u, const AppState &state, uint32_t &key);
+  static std::string permutationDefines(uint32_t key);
+};
+
+#endif //MANDELBULB_SHADERCACHE_H
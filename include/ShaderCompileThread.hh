@@ -0,0 +1,78 @@
+#ifndef MANDELBULB_SHADERCOMPILETHREAD_H
+#define MANDELBULB_SHADERCOMPILETHREAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+/**
+ * Compiles and links programs on a thread of its own, current on a hidden
+ * context that shares objects with the render one. For drivers without
+ * KHR_parallel_shader_compile, where asking whether a link is done waits for
+ * it: this thread does the waiting and the render thread only reads done.
+ */
+class ShaderCompileThread {
+ public:
+  struct Job {
+    std::string vertSource;
+    std::string fragSource;
+
+    // Written before done is set. Linked, the status can be read without waiting.
+    GLuint vertShader = 0;
+    GLuint fragShader = 0;
+    GLuint program = 0;
+    std::atomic<bool> done{false};
+    bool cancelled = false; // Guarded by the thread's mutex
+  };
+
+ private:
+  GLFWwindow *context = nullptr;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<std::shared_ptr<Job>> queue;
+  bool stopping = false;
+
+  void loop();
+  static void deleteObjects(Job &job);
+
+ public:
+  ShaderCompileThread() = default;
+  ~ShaderCompileThread();
+
+  ShaderCompileThread(const ShaderCompileThread &) = delete;
+  ShaderCompileThread &operator=(const ShaderCompileThread &) = delete;
+
+  /**
+   * Compiles both shaders and starts linking them into a new program, no status
+   * queries. Used on whichever thread has a context current.
+   */
+  static GLuint beginLink(const std::string &vs, const std::string &fs, GLuint &vertShader, GLuint &fragShader);
+
+  /**
+   * Runs the thread on sharedContext, which must not be current anywhere else
+   */
+  void start(GLFWwindow *sharedContext);
+
+  /**
+   * Lets the job in progress finish and joins, queued ones are dropped
+   */
+  void stop();
+
+  bool running() const { return thread.joinable(); }
+
+  std::shared_ptr<Job> submit(const std::string &vs, const std::string &fs);
+
+  /**
+   * For a job no longer wanted, its objects are deleted whether it is done yet or not
+   */
+  void cancel(const std::shared_ptr<Job> &job);
+};
+
+#endif //MANDELBULB_SHADERCOMPILETHREAD_H
@@ -0,0 +1,31 @@
+#ifndef MANDELBULB_SHADOWPASS_H
+#define MANDELBULB_SHADOWPASS_H
+
+#include <GL/glew.h>
+
+/**
+ * Low resolution target for the shadow pass. One texel per block of
+ * scale x scale pixels holds the light reaching the hit of the block's center
+ * pixel (x) and that hit's ray distance (y, 0 on a miss) for the upsample.
+ */
+class ShadowPass {
+  GLuint fbo = 0;
+  GLuint shadowTexture = 0;
+  unsigned int capacityWidth = 0, capacityHeight = 0;
+
+ public:
+
+  /**
+   * Makes room for the blocks of a w x h pixel image at scale, needs a current GL context
+   */
+  void reserve(unsigned int w, unsigned int h, unsigned int scale);
+
+  /**
+   * Binds the framebuffer with one pixel per block of a w x h image
+   */
+  void bind(unsigned int w, unsigned int h, unsigned int scale);
+
+  GLuint getTexture() const { return shadowTexture; }
+};
+
+#endif //MANDELBULB_SHADOWPASS_H
@@ -0,0 +1,11 @@
+#ifndef MANDELBULB_SIMPLEXNOISE_H
+#define MANDELBULB_SIMPLEXNOISE_H
+
+#include "types.hh"
+
+/**
+ * CPU port of the Ashima Arts 3D simplex noise used by the raymarch shader
+ */
+float snoise(vec3 v);
+
+#endif //MANDELBULB_SIMPLEXNOISE_H
@@ -0,0 +1,66 @@
+#ifndef MANDELBULB_THREADPOOL_H
+#define MANDELBULB_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> Task;
+
+/**
+ * Work-stealing pool. Every worker owns a deque, pops its own work from the
+ * back and steals from the front of the others when it runs dry.
+ */
+class ThreadPool {
+
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  std::vector<std::thread> workers;
+
+  std::atomic<unsigned int> nextQueue;
+  std::atomic<size_t> queued;   // Tasks sitting in a deque
+  std::atomic<size_t> pending;  // Tasks queued or running
+  bool stopping = false;
+
+  std::mutex sleepMutex;
+  std::condition_variable wakeCondition;
+  std::condition_variable doneCondition;
+
+  void workerLoop(unsigned int index);
+  bool popTask(unsigned int index, Task &task);
+
+ public:
+
+  /**
+   * @param threadCount Number of workers, 0 uses every hardware thread
+   */
+  explicit ThreadPool(unsigned int threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * Queue a task. Called from a worker it lands on that worker's own deque
+   */
+  void submit(Task task);
+
+  /**
+   * Block until every submitted task has finished
+   */
+  void wait();
+
+  unsigned int size() const { return (unsigned int) workers.size(); }
+
+};
+
+#endif //MANDELBULB_THREADPOOL_H
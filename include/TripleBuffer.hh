@@ -0,0 +1,52 @@
+#ifndef MANDELBULB_TRIPLEBUFFER_H
+#define MANDELBULB_TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * Hands the newest value from one writer thread to one reader thread without
+ * locks or waiting. Each side owns a slot and the third sits between them: the
+ * writer swaps its slot in after filling it, the reader swaps it out when it
+ * holds something newer. Values the reader was too slow for are skipped.
+ */
+template<typename T>
+class TripleBuffer {
+  static const unsigned int INDEX_MASK = 3;
+  static const unsigned int FRESH = 4; // Set on the middle slot when the reader has not taken it yet
+
+  T slots[3];
+  std::atomic<unsigned int> middle{1};
+  unsigned int writeIndex = 0;
+  unsigned int readIndex = 2;
+
+ public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(const T &initial) : slots{initial, initial, initial} {}
+
+  /**
+   * Writer side, copies value in and publishes it
+   */
+  void write(const T &value) {
+    slots[writeIndex] = value;
+    unsigned int previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+    writeIndex = previous & INDEX_MASK;
+  }
+
+  /**
+   * Reader side, moves on to the newest value if there is one. True if read() changed.
+   */
+  bool update() {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+    readIndex = previous & INDEX_MASK;
+    return true;
+  }
+
+  /**
+   * Reader side, stays the same until the next update()
+   */
+  const T &read() const { return slots[readIndex]; }
+};
+
+#endif //MANDELBULB_TRIPLEBUFFER_H
@@ -0,0 +1,138 @@
+#ifndef MANDELBULB_UNIFORMBLOCKS_H
+#define MANDELBULB_UNIFORMBLOCKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "FractalUniforms.hh"
+#include "types.hh"
+
+// std140 mirrors of the uniform blocks in the raymarch shaders. Members are
+// ordered so every vec3 is followed by a float, which keeps the C++ layout
+// free of hidden padding. Bools are 4 bytes in std140, hence int32_t.
+
+/**
+ * Camera block, declared identically in mandel_raymarch.vert and .frag
+ */
+struct CameraBlock {
+  mat4 inverseVP;
+  mat4 viewProjection;
+  mat4 prevInverseVP; // Of the frame that wrote the hit history
+  vec3 eyePos;
+  float nearPlane;
+  vec2 screenSize;
+  float farPlane;
+  float screenRatio;
+  vec2 prevScreenSize;
+  float reprojectionFraction;
+  int32_t reprojection;
+  int32_t coneBlockSize; // 0 without the cone pre-pass
+  int32_t shadowScale; // 0 with shadows in the main pass
+  int32_t padding[2];
+  vec3 referenceHi; // Deep zoom: positions above are relative to hi + lo
+  int32_t deepIterations;
+  vec3 referenceLo;
+  int32_t deepZoom;
+};
+
+/**
+ * FractalUniforms block in mandel_raymarch.frag
+ */
+struct FractalBlock {
+  vec4 orbitStrength;
+  vec3 juliaC;
+  float maxRaySteps;
+  vec3 color0;
+  float minDistance;
+  vec3 color1;
+  float bailLimit;
+  vec3 color2;
+  float fudgeFactor;
+  vec3 color3;
+  float power;
+  vec3 colorBase;
+  float boxFoldingLimit;
+  vec3 lightPos;
+  float sphereMinRadius;
+  vec3 bgColor;
+  float sphereFixedRadius;
+  vec3 glowColor;
+  float mandelBoxScale;
+
+  float tetraScale;
+  float otDist0to1;
+  float otDist1to2;
+  float otDist2to3;
+  float otDist3to0;
+  float baseColorStrength;
+  float otCycleIntensity;
+  float otPaletteOffset;
+  float phongShadingMixFactor;
+  float shadowBrightness;
+  float glowFactor;
+  float ambientIntensity;
+  float diffuseIntensity;
+  float specularIntensity;
+  float shininess;
+  float noiseFactor;
+
+  int32_t fractalIters;
+  int32_t derivativeBias;
+  int32_t boxFoldFactor; // 0 when box folding is off
+  int32_t sphereFoldFactor; // 0 when sphere folding is off
+  int32_t tetraFactor; // 0 when tetra is off
+  int32_t shadowRayMinStepsTaken;
+
+  int32_t mandelbulbOn;
+  int32_t julia;
+  int32_t sphereMinTimeVariance;
+  int32_t mandelBoxOn;
+  int32_t showBgGradient;
+  int32_t lightSource;
+  int32_t gammaCorrection;
+  int32_t debugView;
+  int32_t marchStats;
+  int32_t normalMode;
+  float shadowSharpness;
+  int32_t noiseTexture;
+  int32_t distanceGrid; // 0 without empty-space skipping
+  float gridExtent;
+};
+
+static_assert(sizeof(CameraBlock) == 288, "CameraBlock does not match std140");
+static_assert(offsetof(FractalBlock, tetraScale) == 160, "FractalBlock does not match std140");
+static_assert(sizeof(FractalBlock) == 304, "FractalBlock does not match std140");
+
+/**
+ * Reprojection is left off, see packReprojection()
+ */
+CameraBlock packCameraBlock(const mat4 &inverseVP, const mat4 &viewProjection, vec3 eyePos,
+                            float nearPlane, float farPlane, vec2 screenSize);
+
+/**
+ * Seeds ray starts from the hit history of a frame rendered with prevInverseVP at prevScreenSize
+ */
+void packReprojection(CameraBlock &b, const FractalUniforms &u, const mat4 &prevInverseVP, vec2 prevScreenSize);
+
+/**
+ * Starts rays from the cone pre-pass distances, one texel per blockSize^2 pixels
+ */
+void packConePrepass(CameraBlock &b, int blockSize);
+
+/**
+ * Leaves shadows to the shadow pass, one shadow ray per scale^2 pixels
+ */
+void packShadowPass(CameraBlock &b, int scale);
+
+/**
+ * Marks the matrices and eye as relative to reference, which the shader adds
+ * back as a double-float for the first iterations of the DE
+ */
+void packDeepZoom(CameraBlock &b, dvec3 reference, int iterations);
+FractalBlock packFractalBlock(const FractalUniforms &u, const AppState &state);
+
+/**
+ * Skips empty space through the DistanceGrid bound to the shader, which covers the cube of half side extent
+ */
+void packDistanceGrid(FractalBlock &b, float extent);
+
+#endif //MANDELBULB_UNIFORMBLOCKS_H
@@ -0,0 +1,42 @@
+#ifndef MANDELBULB_UNIFORMBUFFER_H
+#define MANDELBULB_UNIFORMBUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+/**
+ * A std140 uniform block backed by a UBO on a fixed binding point.
+ * Keeps a copy of what was last uploaded and skips uploads of identical data.
+ */
+class UniformBuffer {
+  GLuint ubo = 0;
+  GLuint binding;
+  const char *blockName;
+  std::vector<unsigned char> uploaded;
+  bool hasData = false;
+  unsigned int uploads = 0;
+
+ public:
+  UniformBuffer(const char *blockName, GLuint binding, size_t size)
+      : binding(binding), blockName(blockName), uploaded(size) {};
+
+  /**
+   * Creates the buffer, needs a current GL context
+   */
+  void init();
+
+  /**
+   * Points the program's block at this buffer's binding, call again after relinking
+   */
+  void attach(GLuint program) const;
+
+  /**
+   * Uploads data if it differs from the previous upload, returns true if it did
+   */
+  bool update(const void *data, size_t size);
+
+  unsigned int uploadCount() const { return uploads; }
+};
+
+#endif //MANDELBULB_UNIFORMBUFFER_H
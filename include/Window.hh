@@ -1,20 +1,45 @@
 #ifndef MANDELBULB_WINDOW_H
 #define MANDELBULB_WINDOW_H
 
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "FramePacing.hh"
+#include "Profiler.hh"
 #include "types.hh"
 
+typedef void (* FrameBufferSizeCallback)(GLFWwindow *win, int w, int h);
+typedef void (* ProcessInputFunc)(GLFWwindow *win);
+typedef void (* DisplayFunc)();
+typedef void (* ShutdownFunc)();
+
+/**
+ * Events and input stay on the main thread, as GLFW wants, while a render
+ * thread holds the GL context. Input is processed INPUT_HZ times a second
+ * whatever the frame rate, so slow frames do not slow down navigation.
+ */
 class Window {
   GLFWwindow *window;
+  GLFWwindow *compileContext = nullptr;
   unsigned int width = 640, height = 640;
   unsigned int nbFrames = 0;
 
   void static onClose(GLFWwindow *win);
   void static error_callback(int error, const char *description);
 
+  void renderLoop();
+
   ProcessInputFunc inputFunc;
   DisplayFunc displayFunc;
+  ShutdownFunc shutdownFunc = nullptr;
+  Profiler profiler;
+  FramePacing pacing;
 
  public:
+  static const int INPUT_HZ = 60;
+
+  // Ticks run back to back after a stall, more than this and the rest are dropped
+  static const int MAX_CATCH_UP_TICKS = 6;
+
   Window(unsigned int w, unsigned int h) : width(w), height(h) {};
   ~Window();
 
@@ -22,13 +47,28 @@ class Window {
             ProcessInputFunc inputFunc,
             DisplayFunc dispFunc);
 
+  /**
+   * Runs until the window closes. Input runs here, display and the GUI on the render thread.
+   */
   void display();
+
+  /**
+   * Called on the render thread once the window closes, while the GL context is still current
+   */
+  void setShutdownFunc(ShutdownFunc func) { shutdownFunc = func; }
   void setResolution(unsigned int w, unsigned int h) {
     width = w;
     height = h;
   }
 
   GLFWwindow *getHandle() { return window; }
+
+  /**
+   * Hidden, shares objects with the window's context and is current nowhere. Null if it could not be made.
+   */
+  GLFWwindow *getCompileContext() { return compileContext; }
+  Profiler &getProfiler() { return profiler; }
+  FramePacing &getPacing() { return pacing; }
   unsigned int getWidth() { return width; }
   unsigned int getHeight() { return height; }
 
@@ -15,6 +15,10 @@ IMGUI_API bool        ImGui_ImplGlfwGL3_Init(GLFWwindow* window, bool install_ca
 IMGUI_API void        ImGui_ImplGlfwGL3_Shutdown();
 IMGUI_API void        ImGui_ImplGlfwGL3_NewFrame();
 
+// Samples cursor, mouse buttons, focus and window size for the next NewFrame(). GLFW only allows this on the main
+// thread, which lets NewFrame() and ImGui::Render() run on the thread that has the GL context.
+IMGUI_API void        ImGui_ImplGlfwGL3_PollInput();
+
 // Use if you want to reset your rendering device without losing ImGui state.
 IMGUI_API void        ImGui_ImplGlfwGL3_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_ImplGlfwGL3_CreateDeviceObjects();
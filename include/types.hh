@@ -2,17 +2,18 @@
 #define MANDELBULB_TYPES_H
 
 #include <glm/glm.hpp>
-#include <GLFW/glfw3.h>
 
 typedef glm::mat4 mat4;
+typedef glm::mat3 mat3;
 typedef glm::mat4x2 mat4x2;
 
 typedef glm::vec4 vec4;
 typedef glm::vec3 vec3;
 typedef glm::vec2 vec2;
 
-typedef void (* FrameBufferSizeCallback)(GLFWwindow *win, int w, int h);
-typedef void (* ProcessInputFunc)(GLFWwindow *win);
-typedef void (* DisplayFunc)();
+// Deep zoom keeps the camera and positions in double
+typedef glm::dmat4 dmat4;
+typedef glm::dvec4 dvec4;
+typedef glm::dvec3 dvec3;
 
 #endif //MANDELBULB_TYPES_H
@@ -1,5 +1,8 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <iostream>
 #include <string>
 #include "types.hh"
 
@@ -16,7 +19,7 @@
 
 namespace utils {
 
-unsigned char *readFile(char *fileName) {
+inline unsigned char *readFile(char *fileName) {
   FILE *file = fopen(fileName, "r");
   if (file == nullptr) {
     std::cout << "Error: Cannot open file. " << fileName << std::endl;
@@ -40,7 +43,7 @@ unsigned char *readFile(char *fileName) {
 
 }
 
-void printShaderInfoLog(GLuint obj, const char *fn) {
+inline void printShaderInfoLog(GLuint obj, const char *fn) {
   GLint infologLength = 0;
   GLint charsWritten = 0;
   char *infoLog;
@@ -56,7 +59,7 @@ void printShaderInfoLog(GLuint obj, const char *fn) {
   }
 }
 
-void printProgramInfoLog(GLuint obj, const char *vfn, const char *ffn,
+inline void printProgramInfoLog(GLuint obj, const char *vfn, const char *ffn,
                          const char *gfn, const char *tcfn, const char *tefn) {
   GLint infologLength = 0;
   GLint charsWritten = 0;
@@ -78,7 +81,7 @@ void printProgramInfoLog(GLuint obj, const char *vfn, const char *ffn,
   }
 }
 
-GLuint compileShaders(const unsigned char *vertAssembly,
+inline GLuint compileShaders(const unsigned char *vertAssembly,
                       const unsigned char *fragAssembly,
                       const char *vertName,
                       const char *fragName) {
@@ -113,6 +116,7 @@ GLuint compileShaders(const unsigned char *vertAssembly,
   glAttachShader(pID, vertShader);
   glAttachShader(pID, fragShader);
   glBindAttribLocation(pID, 0, "in_Position");
+  glProgramParameteri(pID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); // For ProgramBinaryCache
   glLinkProgram(pID);
   glGetProgramiv(pID, GL_LINK_STATUS, &shadersLinked);
 
@@ -132,7 +136,21 @@ GLuint compileShaders(const unsigned char *vertAssembly,
   return pID;
 }
 
-GLuint loadShaders(const char *vertFileName, const char *fragFileName) {
+/**
+ * Inserts defines right after the #version line, which has to stay first
+ */
+inline std::string injectDefines(const unsigned char *source, const std::string &defines) {
+  std::string text = (const char *) source;
+  if (defines.empty())
+    return text;
+
+  size_t lineEnd = text.find('\n');
+  if (text.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos)
+    return defines + text;
+  return text.substr(0, lineEnd + 1) + defines + text.substr(lineEnd + 1);
+}
+
+inline GLuint loadShaders(const char *vertFileName, const char *fragFileName, const std::string &defines = "") {
   unsigned char *vs, *fs;
   GLuint program = 0;
 
@@ -146,7 +164,10 @@ GLuint loadShaders(const char *vertFileName, const char *fragFileName) {
     fprintf(stderr, "Failed to read %s from disk.\n", fragFileName);
 
   if ((vs != nullptr) && (fs != nullptr)) {
-    program = compileShaders(vs, fs, vertFileName, fragFileName);
+    std::string vertSource = injectDefines(vs, defines);
+    std::string fragSource = injectDefines(fs, defines);
+    program = compileShaders((const unsigned char *) vertSource.c_str(), (const unsigned char *) fragSource.c_str(),
+                             vertFileName, fragFileName);
   }
 
   if (vs != nullptr) free(vs);
@@ -154,12 +175,21 @@ GLuint loadShaders(const char *vertFileName, const char *fragFileName) {
   return program;
 }
 
-void showUsage() {
+inline void showUsage() {
   std::cerr << "Usage: ./mandelbulb -c\n"
             << "Options:\n"
             << "\t-h,--help\t\tShow this message\n"
             << "\t-w,--weak \t\tLower settings for weak computer i.e. shitty Intel HD graphics laptop\n"
-            << "\t-c,--coordinates \tLog coordinates in console every frame \n\n"
+            << "\t-c,--coordinates \tLog coordinates in console every frame \n"
+            << "\t-r,--record <target>\tRecord Y4M video to a file or pipe, - for stdout\n"
+            << "\t-b,--benchmark <out>\tReplay the benchmark paths, write percentiles as JSON (CSV for .csv) and quit\n"
+            << "\t--bench-presets <list>\tComma separated presets (default all): mandelbulb, julia, mandelbox,\n"
+            << "\t\t\t\ttetra, bulb-folds, bulb-tetra\n"
+            << "\t--bench-paths <list>\tComma separated paths (default all): orbit, deep-zoom, flythrough\n"
+            << "\t--swap <mode>\t\tSwap interval: driver (default), off, vsync, half or adaptive\n"
+            << "\t--max-fps <fps>\t\tCap the frame rate\n"
+            << "\t--frames-in-flight <n>\tFrames the GPU may queue, 1 or 2 (default up to the driver)\n"
+            << "\t-l,--latency\t\tLog input to present latency every second\n\n"
             << "Controls:\n"
             << "\tQ \tQuit the program\n"
             << "\tL \tReload shaders\n"
@@ -167,21 +197,43 @@ void showUsage() {
             << "\tZ \tZoom in\n"
             << "\tX \tZoom out\n"
             << "\tR \tReset position\n"
+            << "\tP \tScreenshot\n"
             << std::endl;
 }
 
-void printInstructions() {
+inline void printInstructions() {
   std::cout << "Keys:\n"
             << "Q: Quit\n"
-            << "L: Reload shader files\n"
+            << "L: Reload shader files, saving them does the same\n"
             << "WASD: Movement around center\n"
             << "Z: Zoom out\n"
             << "X: Zoom in\n"
             << "R: Reset position\n"
+            << "P: Screenshot\n"
             << "G: Show/hide GUI\n";
 }
 
-int handleArgs(int c, char *argv[], bool &logCoordinates, bool &weakSettings) {
+/**
+ * --benchmark and the runs it should replay
+ */
+struct BenchmarkArgs {
+  std::string output;
+  std::string presets = "all";
+  std::string paths = "all";
+};
+
+/**
+ * Frame pacing settings to start with, also in the GUI
+ */
+struct PacingArgs {
+  std::string swapMode;
+  int maxFPS = 0;
+  int framesInFlight = 0;
+  bool logLatency = false;
+};
+
+inline int handleArgs(int c, char *argv[], bool &logCoordinates, bool &weakSettings, std::string &recordTarget,
+                      BenchmarkArgs &benchmark, PacingArgs &pacing) {
   for (int i = 1; i < c; ++i) {
     std::string arg = argv[i];
 
@@ -192,6 +244,22 @@ int handleArgs(int c, char *argv[], bool &logCoordinates, bool &weakSettings) {
       weakSettings = true;
     } else if (arg == "-c" || arg == "--coordinates") {
       logCoordinates = true;
+    } else if ((arg == "-r" || arg == "--record") && i + 1 < c) {
+      recordTarget = argv[++i];
+    } else if ((arg == "-b" || arg == "--benchmark") && i + 1 < c) {
+      benchmark.output = argv[++i];
+    } else if (arg == "--bench-presets" && i + 1 < c) {
+      benchmark.presets = argv[++i];
+    } else if (arg == "--bench-paths" && i + 1 < c) {
+      benchmark.paths = argv[++i];
+    } else if (arg == "--swap" && i + 1 < c) {
+      pacing.swapMode = argv[++i];
+    } else if (arg == "--max-fps" && i + 1 < c) {
+      pacing.maxFPS = std::max(std::atoi(argv[++i]), 0);
+    } else if (arg == "--frames-in-flight" && i + 1 < c) {
+      pacing.framesInFlight = std::min(std::max(std::atoi(argv[++i]), 0), 2);
+    } else if (arg == "-l" || arg == "--latency") {
+      pacing.logLatency = true;
     }
   }
   return 0;
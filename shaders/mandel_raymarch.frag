@@ -1,81 +1,160 @@
 #version 400 core
+#extension GL_ARB_shader_storage_buffer_object : require
 
 in vec3 vertRayOrigin;
 in vec3 vertRayDirection;
 
 uniform float u_time;
-uniform float u_screenRatio;
-uniform vec2 u_screenSize;
-uniform vec3 u_eyePos;
-
-uniform float u_maxRaySteps;
-uniform float u_minDistance;
-uniform int u_fractalIters;
-uniform float u_bailLimit;
-uniform float u_fudgeFactor;
-
-// mandelbulb
-uniform bool u_mandelbulbOn;
-uniform float u_power;
-uniform int u_derivativeBias;
-uniform bool u_julia;
-uniform vec3 u_juliaC;
-
-// boxfolding
-uniform int u_boxFoldFactor;
-uniform float u_boxFoldingLimit;
-
-// spherefolding
-uniform int u_sphereFoldFactor;
-uniform float u_sphereMinRadius;
-uniform float u_sphereFixedRadius;
-uniform bool u_sphereMinTimeVariance;
-
-// mandelbox
-uniform bool u_mandelBoxOn;
-uniform float u_mandelBoxScale;
-
-// tetra
-uniform int u_tetraFactor;
-uniform float u_tetraScale;
-
-uniform vec4 u_orbitStrength;
-uniform vec3 u_color0;
-uniform vec3 u_color1;
-uniform vec3 u_color2;
-uniform vec3 u_color3;
-uniform vec3 u_colorBase;
-uniform float u_otDist0to1;
-uniform float u_otDist1to2;
-uniform float u_otDist2to3;
-uniform float u_otDist3to0;
-uniform float u_baseColorStrength;
-uniform float u_otCycleIntensity;
-uniform float u_otPaletteOffset;
-
-uniform int u_shadowRayMinStepsTaken;
-uniform float u_phongShadingMixFactor;
-uniform vec3 u_lightPos;
-uniform vec3 u_bgColor;
-uniform vec3 u_mandelColorA;
-uniform vec3 u_mandelColorB;
-uniform vec3 u_glowColor;
-uniform float u_shadowBrightness;
-uniform float u_glowFactor;
-uniform bool u_showBgGradient;
-uniform bool u_lightSource;
-uniform float u_ambientIntensity;
-uniform float u_diffuseIntensity;
-uniform float u_specularIntensity;
-uniform float u_shininess;
-uniform float u_noiseFactor;
-uniform bool u_gammaCorrection;
-
-out vec4 outColor;
+
+// Mirrored by CameraBlock and FractalBlock in UniformBlocks.hh, keep in sync
+layout (std140) uniform Camera {
+  mat4 u_inverseVP;
+  mat4 u_viewProjection;
+  mat4 u_prevInverseVP;
+  vec3 u_eyePos;
+  float u_nearPlane;
+  vec2 u_screenSize;
+  float u_farPlane;
+  float u_screenRatio;
+  vec2 u_prevScreenSize;
+  float u_reprojectionFraction;
+  bool u_reprojection;
+  int u_coneBlockSize; // 0 without the cone pre-pass
+  int u_shadowScale; // 0 with shadows in the main pass
+  vec3 u_referenceHi; // Deep zoom: positions are relative to hi + lo
+  int u_deepIterations;
+  vec3 u_referenceLo;
+  bool u_deepZoom;
+};
+
+layout (std140) uniform FractalUniforms {
+  vec4 u_orbitStrength;
+  vec3 u_juliaC;
+  float u_maxRaySteps;
+  vec3 u_color0;
+  float u_minDistance;
+  vec3 u_color1;
+  float u_bailLimit;
+  vec3 u_color2;
+  float u_fudgeFactor;
+  vec3 u_color3;
+  float u_power;
+  vec3 u_colorBase;
+  float u_boxFoldingLimit;
+  vec3 u_lightPos;
+  float u_sphereMinRadius;
+  vec3 u_bgColor;
+  float u_sphereFixedRadius;
+  vec3 u_glowColor;
+  float u_mandelBoxScale;
+
+  float u_tetraScale;
+  float u_otDist0to1;
+  float u_otDist1to2;
+  float u_otDist2to3;
+  float u_otDist3to0;
+  float u_baseColorStrength;
+  float u_otCycleIntensity;
+  float u_otPaletteOffset;
+  float u_phongShadingMixFactor;
+  float u_shadowBrightness;
+  float u_glowFactor;
+  float u_ambientIntensity;
+  float u_diffuseIntensity;
+  float u_specularIntensity;
+  float u_shininess;
+  float u_noiseFactor;
+
+  int u_fractalIters;
+  int u_derivativeBias;
+  int u_boxFoldFactor;
+  int u_sphereFoldFactor;
+  int u_tetraFactor;
+  int u_shadowRayMinStepsTaken;
+
+  bool u_mandelbulbOn;
+  bool u_julia;
+  bool u_sphereMinTimeVariance;
+  bool u_mandelBoxOn;
+  bool u_showBgGradient;
+  bool u_lightSource;
+  bool u_gammaCorrection;
+  int u_debugView; // 0 shaded, 1 march steps, 2 DE calls
+  bool u_marchStats;
+  int u_normalMode; // 0 central differences, 1 tetrahedral, 2 analytic
+  float u_shadowSharpness;
+  bool u_noiseTexture;
+  bool u_distanceGrid; // Empty-space skipping
+  float u_gridExtent;
+};
+
+// Frame totals, mirrored by MarchCounters in MarchStats.hh. Only written with u_marchStats.
+layout (std430) buffer MarchStats {
+  uint s_rays;
+  uint s_escapedRays;
+  uint s_marchSteps;
+  uint s_maxMarchSteps;
+  uint s_normalDECalls;
+  uint s_shadowDECalls;
+  uint s_marchStepsHigh; // Carries of the three above, they wrap in a frame at 4K with long marches
+  uint s_normalDECallsHigh;
+  uint s_shadowDECallsHigh;
+  uint s_padding[3];
+};
+
+// Adds to a 64-bit total kept as two words, the add that wraps the low one carries
+#define ATOMIC_ADD_CARRY(low, high, value) { uint v = (value); if (atomicAdd(low, v) > 0xffffffffu - v) atomicAdd(high, 1u); }
+
+// Last frame's hits, x: ray distance (0 on miss), y: total steps, z: steps actually marched
+uniform sampler2D u_history;
+
+// Cone pre-pass per block, x: safe start distance, y: regular steps that saves
+uniform sampler2D u_coneDistance;
+
+// Tileable noise baked by NoiseVolume, [-1, 1] stored as unorm
+uniform sampler3D u_noiseVolume;
+const float NOISE_PERIOD = 16.0; // NoiseVolume::PERIOD
+
+// Lower bounds of DE() per cell of the cube of half side u_gridExtent, built
+// by DistanceGrid. 0 where the surface may pass through the cell.
+uniform sampler3D u_distanceGrid;
+const int GRID_SIZE = 128; // DistanceGrid::SIZE
+
+#if defined(SHADOW_PASS) || defined(SHADOW_COMPOSITE)
+// This frame's hits, same layout as u_history
+uniform sampler2D u_hits;
+
+// Main pass color without shadows
+uniform sampler2D u_litColor;
+
+// Shadow pass per block, x: light reaching the hit, y: its ray distance (0 on miss)
+uniform sampler2D u_shadow;
+#endif
+
+layout (location = 0) out vec4 outColor;
+layout (location = 1) out vec4 outHistory;
 
 #define SPHERE_R 0.9
 #define LOW_P_ZERO 0.00001
 
+// DE() calls of this fragment so far
+int deCalls = 0;
+
+// Width of a pixel per unit of distance from the eye, set in main()
+float pixelAngle = 0.0;
+
+// Specialized programs define PERMUTATION and the formula set as constants so
+// DE() is compiled without the branches, see ShaderCache.hh. The uber-shader
+// reads them from the uniform block.
+#ifndef PERMUTATION
+#define MANDELBULB_ON u_mandelbulbOn
+#define JULIA_ON u_julia
+#define BOX_FOLD_FACTOR u_boxFoldFactor
+#define SPHERE_FOLD_FACTOR u_sphereFoldFactor
+#define MANDELBOX_ON u_mandelBoxOn
+#define TETRA_FACTOR u_tetraFactor
+#endif
+
 vec4 orbitTrap = vec4(10000.0);
 
 //
@@ -217,12 +296,16 @@ void recTetra(inout vec3 z) {
     z = u_tetraScale*z-c*(u_tetraScale-1.0);
 }
 
-void sphereFold(inout vec3 z, inout float dz) {
-	float r2 = dot(z, z);
+float sphereMinRadius() {
 	float minRadius = u_sphereMinRadius;
-
 	if (float(u_sphereMinTimeVariance) > 0.5)
 	    minRadius += 0.02 * abs(sin(u_time)) * abs(sin(0.1 * u_time));
+	return minRadius;
+}
+
+void sphereFold(inout vec3 z, inout float dz) {
+	float r2 = dot(z, z);
+	float minRadius = sphereMinRadius();
 
 	if (r2 < minRadius) {
 		// linear inner scaling
@@ -251,6 +334,139 @@ void mandelbox(inout vec3 z, inout float dr, in float r) {
   }
 }
 
+#ifdef MANDELBULB_POWER
+vec2 complexMul(vec2 a, vec2 b) {
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// c^MANDELBULB_POWER by squaring, the loop unrolls since the power is a constant
+vec2 complexPow(vec2 c) {
+    vec2 result = vec2(1.0, 0.0);
+    for (int e = MANDELBULB_POWER; e > 0; e >>= 1) {
+        if ((e & 1) != 0) result = complexMul(result, c);
+        c = complexMul(c, c);
+    }
+    return result;
+}
+
+// Trig-free kernel for integer powers: cos and sin of theta and phi as unit
+// complex numbers, raised to the power gives those of power * theta and phi
+void mandelbulb(inout vec3 z, inout float dr, in float r) {
+    float rho = length(z.xy);
+    vec2 theta = complexPow(vec2(rho, z.z) / r);
+    vec2 phi = complexPow(rho > 0.0 ? z.xy / rho : vec2(1.0, 0.0));
+
+    float rPowMinusOne = 1.0;
+    for (int i = 1; i < MANDELBULB_POWER; i++)
+        rPowMinusOne *= r;
+
+    // With Mermelada's tweak to reduce errors
+    dr = max(dr * float(u_derivativeBias), rPowMinusOne * float(MANDELBULB_POWER) * dr + 1.0);
+
+    float zr = rPowMinusOne * r;
+    z = zr * vec3(theta.x * phi.x, theta.x * phi.y, theta.y);
+}
+
+// Deep zoom: double-float numbers, hi + lo with lo below an ulp of hi (Dekker,
+// Knuth). precise keeps the compiler from folding the error terms away.
+vec2 twoSum(float a, float b) {
+    precise float s = a + b;
+    precise float v = s - a;
+    precise float e = (a - (s - v)) + (b - v);
+    return vec2(s, e);
+}
+
+vec2 quickTwoSum(float a, float b) {
+    precise float s = a + b;
+    precise float e = b - (s - a);
+    return vec2(s, e);
+}
+
+vec2 twoProd(float a, float b) {
+    precise float p = a * b;
+    precise float e = fma(a, b, -p);
+    return vec2(p, e);
+}
+
+vec2 dfAdd(vec2 a, vec2 b) {
+    vec2 s = twoSum(a.x, b.x);
+    return quickTwoSum(s.x, s.y + a.y + b.y);
+}
+
+vec2 dfMul(vec2 a, vec2 b) {
+    vec2 p = twoProd(a.x, b.x);
+    return quickTwoSum(p.x, p.y + a.x * b.y + a.y * b.x);
+}
+
+vec2 dfDiv(vec2 a, vec2 b) {
+    float q = a.x / b.x;
+    vec2 rest = dfAdd(a, -dfMul(b, vec2(q, 0.0)));
+    return quickTwoSum(q, rest.x / b.x);
+}
+
+vec2 dfSqrt(vec2 a) {
+    if (a.x <= 0.0)
+        return vec2(0.0);
+    float s = sqrt(a.x);
+    vec2 square = twoProd(s, s);
+    return quickTwoSum(s, (a.x - square.x - square.y + a.y) * 0.5 / s);
+}
+
+// Complex numbers as (re.hi, re.lo, im.hi, im.lo)
+vec4 dfComplexMul(vec4 a, vec4 b) {
+    return vec4(dfAdd(dfMul(a.xy, b.xy), -dfMul(a.zw, b.zw)), dfAdd(dfMul(a.xy, b.zw), dfMul(a.zw, b.xy)));
+}
+
+vec4 dfComplexPow(vec4 c) {
+    vec4 result = vec4(1.0, 0.0, 0.0, 0.0);
+    for (int e = MANDELBULB_POWER; e > 0; e >>= 1) {
+        if ((e & 1) != 0) result = dfComplexMul(result, c);
+        c = dfComplexMul(c, c);
+    }
+    return result;
+}
+
+// The first u_deepIterations of the Mandelbulb orbit of u_reference + pos in
+// double-float. By then neighbouring pixels' orbits have drifted apart by more
+// than a float ulp and DE() carries on from z in float. Returns the iterations done.
+int deepOrbit(vec3 pos, out vec3 z, inout float dr) {
+    vec2 zx = dfAdd(vec2(u_referenceHi.x, u_referenceLo.x), vec2(pos.x, 0.0));
+    vec2 zy = dfAdd(vec2(u_referenceHi.y, u_referenceLo.y), vec2(pos.y, 0.0));
+    vec2 zz = dfAdd(vec2(u_referenceHi.z, u_referenceLo.z), vec2(pos.z, 0.0));
+    z = vec3(zx.x, zy.x, zz.x);
+
+    vec2 cx = JULIA_ON ? vec2(u_juliaC.x, 0.0) : zx;
+    vec2 cy = JULIA_ON ? vec2(u_juliaC.y, 0.0) : zy;
+    vec2 cz = JULIA_ON ? vec2(u_juliaC.z, 0.0) : zz;
+
+    int i = 0;
+    for (; i < min(u_deepIterations, u_fractalIters); i++) {
+        vec2 rho2 = dfAdd(dfMul(zx, zx), dfMul(zy, zy));
+        vec2 r = dfSqrt(dfAdd(rho2, dfMul(zz, zz)));
+        if (r.x > u_bailLimit) break;
+
+        // Same as the float mandelbulb()
+        vec2 rho = dfSqrt(rho2);
+        vec4 theta = dfComplexPow(vec4(dfDiv(rho, r), dfDiv(zz, r)));
+        vec4 phi = dfComplexPow(rho.x > 0.0 ? vec4(dfDiv(zx, rho), dfDiv(zy, rho)) : vec4(1.0, 0.0, 0.0, 0.0));
+
+        vec2 rPowMinusOne = vec2(1.0, 0.0);
+        for (int j = 1; j < MANDELBULB_POWER; j++)
+            rPowMinusOne = dfMul(rPowMinusOne, r);
+        dr = max(dr * float(u_derivativeBias), rPowMinusOne.x * float(MANDELBULB_POWER) * dr + 1.0);
+
+        vec2 zr = dfMul(rPowMinusOne, r);
+        vec2 scale = dfMul(zr, theta.xy);
+        zx = dfAdd(dfMul(scale, phi.xy), cx);
+        zy = dfAdd(dfMul(scale, phi.zw), cy);
+        zz = dfAdd(dfMul(zr, theta.zw), cz);
+
+        z = vec3(zx.x, zy.x, zz.x);
+        orbitTrap = min(orbitTrap, abs(vec4(z, dot(z,z))));
+    }
+    return i;
+}
+#else
 void mandelbulb(inout vec3 z, inout float dr, in float r) {
     float theta = asin(z.z / r);
     float phi = atan(z.y, z.x);
@@ -269,38 +485,51 @@ void mandelbulb(inout vec3 z, inout float dr, in float r) {
     // Alternate method to spherical
     z = zr * vec3(cos(theta) * cos(phi), cos(theta) * sin(phi), sin(theta));
 }
+#endif
+
+// Deep zoom positions are relative to the reference, this is only as exact as a float
+vec3 worldPos(vec3 p) {
+    return u_deepZoom ? u_referenceHi + p : p;
+}
 
 float DE(vec3 pos) {
-	vec3 z = pos;
+	deCalls++;
+	vec3 z = worldPos(pos);
 	float dr = 1.0;
+	int i = 0;
+#ifdef MANDELBULB_POWER
+	if (u_deepZoom)
+		i = deepOrbit(pos, z, dr);
+#endif
+	pos = worldPos(pos);
 	float r = length(z);
-	for (int i = 0; i < u_fractalIters; i++) {
+	for (; i < u_fractalIters; i++) {
 		if (r > u_bailLimit) break;
 
-        if (u_mandelbulbOn) {
+        if (MANDELBULB_ON) {
           mandelbulb(z, dr, r);
         }
 
-        if (u_boxFoldFactor > 0) {
+        if (BOX_FOLD_FACTOR > 0) {
             boxFold(z);
-            z *= float(u_boxFoldFactor);
+            z *= float(BOX_FOLD_FACTOR);
         }
 
-        if (u_sphereFoldFactor > 0) {
+        if (SPHERE_FOLD_FACTOR > 0) {
             sphereFold(z, dr);
-            z *= float(u_sphereFoldFactor);
+            z *= float(SPHERE_FOLD_FACTOR);
         }
 
-        if (u_mandelBoxOn) {
+        if (MANDELBOX_ON) {
           mandelbox(z, dr, r);
         }
 
-        if (u_tetraFactor > 0) {
+        if (TETRA_FACTOR > 0) {
             recTetra(z);
-            z *= float(u_tetraFactor);
+            z *= float(TETRA_FACTOR);
         }
 
-		z += u_julia ? u_juliaC : pos;
+		z += JULIA_ON ? u_juliaC : pos;
 		r = length(z);
     orbitTrap = min(orbitTrap, abs(vec4(z, dot(z,z))));
 	}
@@ -308,14 +537,73 @@ float DE(vec3 pos) {
 	return u_fudgeFactor * 0.5 * log(r) * r / dr;
 }
 
-// March with distance estimate and return grayscale value
-float simpleMarch(vec3 from, vec3 dir, out int stepsTaken, out vec3 pos) {
-	float totalDistance = 0.0;
+// How far p can move along the unit direction dir without DE() calls, and
+// about how many regular steps that stands in for. An empty cell is crossed to
+// its far side, or by its lower bound if that reaches further. Outside the grid
+// the ray jumps to where it enters. x is negative once the ray has left the grid,
+// nothing is out there, and 0 in a cell the surface may pass through.
+vec2 gridSkip(vec3 p, vec3 dir) {
+    float gridSide = 2.0 * u_gridExtent;
+    float cellSize = gridSide / float(GRID_SIZE);
+    vec3 local = p + u_gridExtent;
+    vec3 invDir = 1.0 / mix(dir, vec3(1e-8), equal(dir, vec3(0.0)));
+
+    if (any(lessThan(local, vec3(0.0))) || any(greaterThan(local, vec3(gridSide)))) {
+        vec3 t0 = -local * invDir;
+        vec3 t1 = (gridSide - local) * invDir;
+        vec3 tNear = min(t0, t1);
+        vec3 tFar = max(t0, t1);
+        float enter = max(max(max(tNear.x, tNear.y), tNear.z), 0.0);
+        float exit = min(min(tFar.x, tFar.y), tFar.z);
+        if (exit <= enter)
+            return vec2(-1.0, 0.0);
+        return vec2(enter + 1e-3 * cellSize, 1.0);
+    }
+
+    ivec3 cell = clamp(ivec3(local / cellSize), ivec3(0), ivec3(GRID_SIZE - 1));
+    float bound = texelFetch(u_distanceGrid, cell, 0).r;
+    if (bound <= 0.0)
+        return vec2(0.0);
+
+    // Points of the cell are at least bound from the surface, so a nudge of less
+    // than that past its far side is still safe
+    vec3 farSide = (vec3(cell) + step(0.0, dir)) * cellSize;
+    vec3 t = (farSide - local) * invDir;
+    float cellExit = min(min(t.x, t.y), t.z) + min(1e-3 * cellSize, 0.5 * bound);
+    float advance = max(cellExit, bound);
+
+    // Regular steps would be about as long as DE() at the cell center
+    return vec2(advance, advance / (bound + 0.866 * cellSize));
+}
+
+// March with distance estimate and return grayscale value. Regular steps
+// stood in for by grid skips are added to skippedSteps.
+float simpleMarch(vec3 from, vec3 dir, float startDistance, out int stepsTaken, out vec3 pos, inout float skippedSteps) {
+	float totalDistance = startDistance;
 	int steps;
 	vec3 p;
+	float dirLength = length(dir);
 
 	for (steps=0; steps < u_maxRaySteps; steps++) {
 		p = from + totalDistance * dir;
+
+		// Empty cells are crossed without DE() calls, at most a few per cell along the ray
+		if (u_distanceGrid) {
+			vec2 skip = gridSkip(worldPos(p), dir / dirLength);
+			for (int cells = 0; skip.x > 0.0 && cells < 4 * GRID_SIZE; cells++) {
+				totalDistance += skip.x / dirLength;
+				skippedSteps += skip.y;
+				p = from + totalDistance * dir;
+				skip = gridSkip(worldPos(p), dir / dirLength);
+			}
+
+			// Left the grid, the same as running out of steps
+			if (skip.x < 0.0) {
+				steps = int(ceil(u_maxRaySteps));
+				break;
+			}
+		}
+
 		float distance = DE(p);
 		totalDistance += distance;
 
@@ -345,9 +633,125 @@ vec3 calculateNormal(vec3 p) {
     return normalize(grad);
 }
 
-// https://www.shadertoy.com/view/XtjSDK
+// Jacobians of the DE() steps, taken at the z the step starts from
+mat3 mandelbulbJacobian(vec3 z, float r) {
+    float rho = max(length(z.xy), 1e-10);
+    float theta = asin(z.z / r) * u_power;
+    float phi = atan(z.y, z.x) * u_power;
+    float zr = pow(r, u_power);
+
+    // z' = r^n * (cos(n theta) cos(n phi), cos(n theta) sin(n phi), sin(n theta))
+    vec3 dR = u_power * pow(r, u_power - 1.0) * vec3(cos(theta) * cos(phi), cos(theta) * sin(phi), sin(theta));
+    vec3 dTheta = zr * u_power * vec3(-sin(theta) * cos(phi), -sin(theta) * sin(phi), cos(theta));
+    vec3 dPhi = zr * u_power * vec3(-cos(theta) * sin(phi), cos(theta) * cos(phi), 0.0);
+
+    vec3 gradR = z / r;
+    vec3 gradTheta = (vec3(0.0, 0.0, 1.0) - z.z * z / (r * r)) / rho;
+    vec3 gradPhi = vec3(-z.y, z.x, 0.0) / (rho * rho);
+    return outerProduct(dR, gradR) + outerProduct(dTheta, gradTheta) + outerProduct(dPhi, gradPhi);
+}
+
+mat3 boxFoldJacobian(vec3 z) {
+    vec3 flip = mix(vec3(1.0), vec3(-1.0), greaterThan(abs(z), vec3(u_boxFoldingLimit)));
+    return mat3(vec3(flip.x, 0.0, 0.0), vec3(0.0, flip.y, 0.0), vec3(0.0, 0.0, flip.z));
+}
+
+mat3 sphereFoldJacobian(vec3 z) {
+    float r2 = dot(z, z);
+    float minRadius = sphereMinRadius();
+    if (r2 < minRadius)
+        return mat3(u_sphereFixedRadius / minRadius);
+    if (r2 < u_sphereFixedRadius)
+        return u_sphereFixedRadius / r2 * (mat3(1.0) - 2.0 * outerProduct(z, z) / r2);
+    return mat3(1.0);
+}
+
+// Normal from the Jacobian of the orbit, carried through the same steps as DE().
+// Its gradient of |z|^2 is J^T z. J is kept rescaled so it can not overflow
+// inside the set, invScale is what the identity from adding pos becomes.
+vec3 analyticNormal(vec3 pos) {
+    deCalls++;
+    vec3 z = pos;
+    mat3 J = mat3(1.0);
+    float invScale = 1.0;
+    float dr = 1.0;
+    float r = length(z);
+
+    for (int i = 0; i < u_fractalIters; i++) {
+        if (r > u_bailLimit) break;
+
+        if (MANDELBULB_ON) {
+            J = mandelbulbJacobian(z, r) * J;
+            mandelbulb(z, dr, r);
+        }
+
+        if (BOX_FOLD_FACTOR > 0) {
+            J = float(BOX_FOLD_FACTOR) * boxFoldJacobian(z) * J;
+            boxFold(z);
+            z *= float(BOX_FOLD_FACTOR);
+        }
+
+        if (SPHERE_FOLD_FACTOR > 0) {
+            J = float(SPHERE_FOLD_FACTOR) * sphereFoldJacobian(z) * J;
+            sphereFold(z, dr);
+            z *= float(SPHERE_FOLD_FACTOR);
+        }
+
+        if (MANDELBOX_ON) {
+            vec3 boxPos = z;
+            mat3 boxJ = J;
+            for (int j = 0; j < u_fractalIters; j++) {
+                J = boxFoldJacobian(z) * J;
+                boxFold(z);
+                J = sphereFoldJacobian(z) * J;
+                sphereFold(z, dr);
+                z = u_mandelBoxScale * z + boxPos;
+                J = u_mandelBoxScale * J + boxJ;
+            }
+        }
+
+        if (TETRA_FACTOR > 0) {
+            J *= u_tetraScale * float(TETRA_FACTOR);
+            recTetra(z);
+            z *= float(TETRA_FACTOR);
+        }
+
+        z += JULIA_ON ? u_juliaC : pos;
+        if (!JULIA_ON)
+            J += mat3(invScale);
+        r = length(z);
+
+        float size = length(J[0]) + length(J[1]) + length(J[2]);
+        if (size > 1e10) {
+            J /= size;
+            invScale /= size;
+        }
+    }
+
+    return normalize(transpose(J) * z);
+}
+
+// About a pixel at p, the detail finer than that only shows up as noise
+float normalEpsilon(vec3 p) {
+    return max(pixelAngle * length(p - u_eyePos), u_minDistance);
+}
+
+// Central differences take 6 DE() calls, the tetrahedron 4, the analytic
+// normal one pass that also carries the Jacobian.
+// https://www.shadertoy.com/view/XtjSDK, https://iquilezles.org/articles/normalsSDF
 vec3 calcNormal(in vec3 pos) {
-    vec3 eps = vec3(0.005,0.0,0.0);
+    // The analytic normal is float only, deep zoom takes the tetrahedron
+    if (u_normalMode == 2 && !u_deepZoom)
+        return analyticNormal(pos);
+
+    float e = normalEpsilon(pos);
+    if (u_normalMode != 0) {
+        const vec2 k = vec2(1.0, -1.0);
+        return normalize(k.xyy * DE(pos + k.xyy * e) + k.yyx * DE(pos + k.yyx * e)
+                         + k.yxy * DE(pos + k.yxy * e) + k.xxx * DE(pos + k.xxx * e));
+    }
+
+    vec3 eps = vec3(e, 0.0, 0.0);
 	return normalize( vec3(
        DE(pos+eps.xyy) - DE(pos-eps.xyy),
        DE(pos+eps.yxy) - DE(pos-eps.yxy),
@@ -355,6 +759,112 @@ vec3 calcNormal(in vec3 pos) {
     ));
 }
 
+// World position of last frame's hit through ndc, false if it was a miss or off screen
+bool previousHit(vec2 ndc, out vec3 pos, out vec4 history) {
+    ivec2 texel = ivec2(floor((0.5 * ndc + 0.5) * u_prevScreenSize));
+    if (any(lessThan(texel, ivec2(0))) || any(greaterThanEqual(texel, ivec2(u_prevScreenSize))))
+        return false;
+
+    history = texelFetch(u_history, texel, 0);
+    if (history.x <= 0.0)
+        return false;
+
+    // Same ray setup as the vertex shader
+    vec4 farPlane = u_prevInverseVP * vec4(ndc, u_nearPlane, 1.0);
+    vec4 nearPlane = u_prevInverseVP * vec4(ndc, u_farPlane, 1.0);
+    farPlane /= farPlane.w;
+    nearPlane /= nearPlane.w;
+    pos = nearPlane.xyz + history.x * (farPlane.xyz - nearPlane.xyz);
+    return true;
+}
+
+vec2 projectToScreen(vec3 pos) {
+    vec4 clip = u_viewProjection * vec4(pos, 1.0);
+    return clip.xy / clip.w;
+}
+
+// Where to start marching from last frame's hit distances, 0 means a full march.
+// Steps skipped by starting late are estimated from the history to keep the glow.
+float reprojectedStart(vec3 from, vec3 dir, out float skippedSteps) {
+    skippedSteps = 0.0;
+    if (!u_reprojection)
+        return 0.0;
+
+    vec2 ndc = 2.0 * gl_FragCoord.xy / u_screenSize - 1.0;
+    vec3 pos;
+    vec4 history;
+
+    // Motion of the surface under this pixel, then fetch where it was last frame
+    if (!previousHit(ndc, pos, history))
+        return 0.0;
+    vec2 prevNdc = ndc - (projectToScreen(pos) - ndc);
+    if (!previousHit(prevNdc, pos, history))
+        return 0.0;
+
+    // Disocclusion, what was there last frame does not land on this pixel
+    vec2 pixelError = 0.5 * (projectToScreen(pos) - ndc) * u_screenSize;
+    if (any(greaterThan(abs(pixelError), vec2(1.0))))
+        return 0.0;
+
+    // Closest hit among the neighbours so thin features are not stepped over
+    vec2 texelSize = 2.0 / u_prevScreenSize;
+    float closest = dot(pos - from, dir);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 neighbourPos;
+            vec4 neighbourHistory;
+            if (previousHit(prevNdc + vec2(x, y) * texelSize, neighbourPos, neighbourHistory))
+                closest = min(closest, dot(neighbourPos - from, dir));
+        }
+    }
+
+    skippedSteps = max(history.y - history.z, 0.0);
+    return max(u_reprojectionFraction * closest / dot(dir, dir), 0.0);
+}
+
+#ifdef CONE_PREPASS
+
+// March one cone around the rays of a whole block, built with CONE_PREPASS defined.
+// It stops once the DE no longer clears the cone, up to there every ray in it is in empty space.
+vec2 coneMarch(vec3 from, vec3 dir) {
+
+    // Fragments are blocks here, so the derivatives step a whole block. Half the
+    // block diagonal plus a pixel of room for the jitter bounds every ray inside.
+    // The vertex shader lines the blocks up with the full resolution pixels.
+    float margin = (float(u_coneBlockSize) + 2.0) / float(u_coneBlockSize);
+    float originRadius = 0.5 * margin * (length(dFdx(from)) + length(dFdy(from)));
+    float radiusSlope = 0.5 * margin * (length(dFdx(dir)) + length(dFdy(dir)));
+    float maxDirLength = length(dir) + radiusSlope;
+
+    float totalDistance = 0.0;
+    float regularSteps = 0.0;
+    for (int steps = 0; steps < u_maxRaySteps; steps++) {
+        float distance = DE(from + totalDistance * dir);
+        float coneRadius = originRadius + totalDistance * radiusSlope;
+        if (distance < coneRadius)
+            break;
+
+        // Stay safe for the fastest ray in the cone. simpleMarch() advances by
+        // the DE each step, so this step stands in for about advance / distance of them.
+        float advance = (distance - coneRadius) / maxDirLength;
+        totalDistance += advance;
+        regularSteps += advance / max(distance, u_minDistance);
+    }
+
+    return vec2(totalDistance, regularSteps);
+}
+
+#else
+
+// Start shared by the rays of this pixel's block, (0, 0) without the pre-pass
+vec2 coneStart() {
+    if (u_coneBlockSize <= 0)
+        return vec2(0.0);
+    return texelFetch(u_coneDistance, ivec2(gl_FragCoord.xy) / u_coneBlockSize, 0).xy;
+}
+
+#endif
+
 vec3 calculateBlinnPhong(vec3 diffColor, vec3 p, vec3 rayDir) {
     vec3 ambientColor = diffColor * 0.8;
     const vec3 lightColor = vec3(1.0);
@@ -364,7 +874,7 @@ vec3 calculateBlinnPhong(vec3 diffColor, vec3 p, vec3 rayDir) {
     vec3 normal = calcNormal(p);
 
     vec3 eyeVec = normalize(u_eyePos - p);
-    vec3 lightVec = normalize(u_lightPos - p);
+    vec3 lightVec = normalize(u_lightPos - worldPos(p));
     vec3 H = normalize(lightVec + eyeVec);
 
     float lightPower = 0.4;
@@ -381,27 +891,48 @@ vec3 calculateBlinnPhong(vec3 diffColor, vec3 p, vec3 rayDir) {
     return mix(BPColor, pow(BPColor, vec3(1.0/screenGamma)), float(u_gammaCorrection));
 }
 
-// Cast shadow ray towards light source
-// If hit DE on the way, put area in shadow
-vec3 castShadowRay(vec3 from, in vec3 color) {
-    int maxSteps = 35;
-    float totalDistance = 0.0;
-    vec3 dir = normalize(u_lightPos - from);
-    int steps;
-    vec3 p;
-    for (steps = 0; steps < maxSteps; steps++) {
-      p = from + totalDistance * dir;
-      float distance = DE(p);
-      totalDistance += distance;
-
-      // Check for min distance but also ignore a few 
-      // steps to try to reduce noise in some places
-      if (distance < u_minDistance && steps > u_shadowRayMinStepsTaken) 
-        break;
+// March towards the light source, 1 if nothing is in the way. How closely the
+// ray passes the fractal relative to how far it got estimates the penumbra
+// (https://iquilezles.org/articles/rmshadows), it stops once in full shadow.
+float softShadow(vec3 from, float startDistance) {
+    const int maxSteps = 64;
+    vec3 toLight = u_lightPos - worldPos(from);
+    float lightDistance = length(toLight);
+    vec3 dir = toLight / lightDistance;
+
+    float light = 1.0;
+    float totalDistance = startDistance;
+    for (int steps = 0; steps < maxSteps && totalDistance < lightDistance; steps++) {
+      float distance = DE(from + totalDistance * dir);
+
+      // Ignore a few steps to try to reduce noise in some places
+      if (steps > u_shadowRayMinStepsTaken) {
+        light = min(light, u_shadowSharpness * distance / totalDistance);
+        if (light < 0.01)
+          return 0.0;
+      }
+      totalDistance += max(distance, u_minDistance);
     }
 
-    float inShadeValue = (1.0 - float(steps) / float(maxSteps)); 
-    return mix(color, u_shadowBrightness * color, smoothstep(0.0, 1.0, inShadeValue));
+    return smoothstep(0.0, 1.0, light);
+}
+
+// What the color is multiplied with for the light reaching it
+float shadowFactor(float light) {
+    return mix(1.0, u_shadowBrightness, (1.0 - light) * float(u_lightSource));
+}
+
+// Two octaves of noise, from the baked volume unless the analytic path is picked
+float surfaceNoise(vec3 p) {
+    if (u_noiseTexture) {
+        float noise = texture(u_noiseVolume, 5.0 * p / NOISE_PERIOD).r * 2.0 - 1.0;
+        return noise + 0.5 * (texture(u_noiseVolume, 10.0 * p / NOISE_PERIOD).r * 2.0 - 1.0);
+    }
+
+    float noise = snoise(5.0 * p);
+    noise += 0.5 * snoise(10.0 * p);
+    //noise += 0.25 * snoise(20.0 * p);
+    return noise;
 }
 
 vec3 getColorFromOrbitTrap() {
@@ -451,25 +982,167 @@ vec3 getColorFromOrbitTrap() {
     return colorMix;
 }
 
+// Blue through green to red for 0 to 1, white past 1
+vec3 heatmap(float t) {
+    if (t > 1.0)
+        return vec3(1.0);
+    return clamp(vec3(2.0 * t - 0.5, 1.5 - abs(4.0 * t - 2.0), 1.5 - 2.0 * t), 0.0, 1.0);
+}
+
+// Debug views and frame totals, after the pixel is shaded
+void marchStatistics(int marchSteps, int normalDECalls, int shadowDECalls, bool rayMissed) {
+    if (u_marchStats) {
+        atomicAdd(s_rays, 1u);
+        if (rayMissed)
+            atomicAdd(s_escapedRays, 1u);
+        ATOMIC_ADD_CARRY(s_marchSteps, s_marchStepsHigh, uint(marchSteps));
+        atomicMax(s_maxMarchSteps, uint(marchSteps));
+        ATOMIC_ADD_CARRY(s_normalDECalls, s_normalDECallsHigh, uint(normalDECalls));
+        ATOMIC_ADD_CARRY(s_shadowDECalls, s_shadowDECallsHigh, uint(shadowDECalls));
+    }
+
+    if (u_debugView == 1)
+        outColor = vec4(heatmap(float(marchSteps) / u_maxRaySteps), 1.0);
+    else if (u_debugView == 2)
+        outColor = vec4(heatmap(float(marchSteps + normalDECalls + shadowDECalls) / u_maxRaySteps), 1.0);
+}
+
+#if defined(CONE_PREPASS)
+
+void main() {
+    outColor = vec4(coneMarch(vertRayOrigin, vertRayDirection), 0.0, 1.0);
+}
+
+#elif defined(SHADOW_PASS) || defined(SHADOW_COMPOSITE)
+
+// Ray through a pixel at the render resolution, like the vertex shader
+// interpolates it but without the jitter, which is well below a shadow texel
+void pixelRay(vec2 pixel, out vec3 origin, out vec3 dir) {
+    vec2 ndc = 2.0 * pixel / u_screenSize - 1.0;
+    vec4 farPlane = u_inverseVP * vec4(ndc, u_nearPlane, 1.0);
+    vec4 nearPlane = u_inverseVP * vec4(ndc, u_farPlane, 1.0);
+    origin = nearPlane.xyz / nearPlane.w;
+    dir = farPlane.xyz / farPlane.w - origin;
+    if (u_deepZoom)
+        origin = u_eyePos;
+}
+
+#ifdef SHADOW_PASS
+
+// One shadow ray per block of u_shadowScale^2 pixels, from the hit of its center pixel
+void main() {
+    ivec2 pixel = min(ivec2(gl_FragCoord.xy) * u_shadowScale + u_shadowScale / 2, ivec2(u_screenSize) - 1);
+    vec3 origin, dir;
+    pixelRay(vec2(pixel) + 0.5, origin, dir);
+    pixelAngle = length(dFdx(dir)) / (length(dir) * float(u_shadowScale));
+
+    float hitDistance = texelFetch(u_hits, pixel, 0).x;
+    if (hitDistance <= 0.0) {
+        outColor = vec4(1.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    vec3 pos = origin + hitDistance * dir;
+    outColor = vec4(softShadow(pos, 2.0 * normalEpsilon(pos)), hitDistance, 0.0, 1.0);
+    if (u_marchStats)
+        ATOMIC_ADD_CARRY(s_shadowDECalls, s_shadowDECallsHigh, uint(deCalls));
+}
+
+#else
+
+// Joint bilateral upsample of the shadow pass onto the lit color. Of the four
+// nearest shadow texels the ones whose hit lies at about this pixel's distance
+// take over their bilinear weight, so shadows do not bleed across edges.
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 color = texelFetch(u_litColor, pixel, 0).rgb;
+    float hitDistance = texelFetch(u_hits, pixel, 0).x;
+    if (hitDistance <= 0.0 || u_debugView != 0) {
+        outColor = vec4(color, 1.0);
+        return;
+    }
+
+    ivec2 shadowSize = (ivec2(u_screenSize) + u_shadowScale - 1) / u_shadowScale;
+    vec2 shadowPos = (gl_FragCoord.xy - 0.5 - float(u_shadowScale / 2)) / float(u_shadowScale);
+    ivec2 base = ivec2(floor(shadowPos));
+    vec2 f = shadowPos - vec2(base);
+
+    float weightSum = 0.0;
+    float lightSum = 0.0;
+    float closest = 1e10;
+    float closestLight = 1.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 shadow = texelFetch(u_shadow, clamp(base + offset, ivec2(0), shadowSize - 1), 0).xy;
+        if (shadow.y <= 0.0)
+            continue;
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float depthDifference = abs(shadow.y - hitDistance) / hitDistance;
+        float weight = bilinear.x * bilinear.y / (depthDifference + 0.01);
+        weightSum += weight;
+        lightSum += weight * shadow.x;
+
+        if (depthDifference < closest) {
+            closest = depthDifference;
+            closestLight = shadow.x;
+        }
+    }
+
+    float light = weightSum > 1e-3 ? lightSum / weightSum : closestLight;
+    outColor = vec4(color * shadowFactor(light), 1.0);
+}
+
+#endif
+
+#else
+
 void main() {
     vec2 uv = gl_FragCoord.xy / u_screenSize.xy;
+    pixelAngle = length(dFdx(vertRayDirection)) / length(vertRayDirection);
 
     int stepsTaken = 0;
     vec3 color;
     vec3 mandelPos;
-    float gsValue = simpleMarch(vertRayOrigin, vertRayDirection, stepsTaken, mandelPos);
+    float skippedSteps;
+    float startDistance = reprojectedStart(vertRayOrigin, vertRayDirection, skippedSteps);
+
+    // The cone start is known to be safe, the reprojected one is a guess
+    vec2 safeStart = coneStart();
+    if (safeStart.x >= startDistance) {
+        startDistance = safeStart.x;
+        skippedSteps = safeStart.y;
+    }
+
+    float gsValue = simpleMarch(vertRayOrigin, vertRayDirection, startDistance, stepsTaken, mandelPos, skippedSteps);
+
+    // Hit right at the reprojected start means it began inside, march from the safe start
+    if (startDistance > safeStart.x && stepsTaken == 0) {
+        orbitTrap = vec4(10000.0);
+        startDistance = safeStart.x;
+        skippedSteps = safeStart.y;
+        gsValue = simpleMarch(vertRayOrigin, vertRayDirection, startDistance, stepsTaken, mandelPos, skippedSteps);
+    }
+
+    // One DE call per step, counts both marches if the seeded one started inside
+    int marchSteps = deCalls;
+
+    bool rayMissed = gsValue < LOW_P_ZERO;
+    float totalSteps = skippedSteps + float(stepsTaken);
+    float hitDistance = dot(mandelPos - vertRayOrigin, vertRayDirection) / dot(vertRayDirection, vertRayDirection);
+    outHistory = rayMissed ? vec4(0.0) : vec4(hitDistance, totalSteps, float(stepsTaken), 1.0);
+    gsValue = max(1.0 - totalSteps / u_maxRaySteps, 0.0);
 
     // Ray miss completely; bg plane color
-    if (gsValue < LOW_P_ZERO) {
+    if (rayMissed) {
         color = u_showBgGradient ? mix(u_bgColor, u_bgColor*0.8, uv.y) : u_bgColor;
         outColor = vec4(color, 1.0);
+        marchStatistics(marchSteps, 0, 0, true);
         return;
     }
 
     // Ray hit
-    float noise = snoise(5.0 * mandelPos);
-    noise += 0.5 * snoise(10.0 * mandelPos);
-    //noise += 0.25 * snoise(20.0 * mandelPos);
+    float noise = surfaceNoise(worldPos(mandelPos));
     noise = 0.1 * u_noiseFactor * noise;
     //float timeVariance = 0.01 * abs(sin(0.6 * u_time));
 
@@ -477,12 +1150,15 @@ void main() {
 
     // Mix in blinn-phong shading
     color = mix(color, calculateBlinnPhong(color, mandelPos, vertRayDirection), float(u_lightSource) * u_phongShadingMixFactor);
+    int normalDECalls = deCalls - marchSteps;
     
     // Mix in glow
     color = mix(u_glowFactor * u_glowColor, color, smoothstep(0.0, 0.7, gsValue));
 
-    // Soft shadows
-    color = mix(color, castShadowRay(mandelPos, color), float(u_lightSource));
+    // Soft shadows, unless the shadow pass adds them at a lower resolution
+    if (u_shadowScale == 0 && u_lightSource)
+        color *= shadowFactor(softShadow(mandelPos, 2.0 * normalEpsilon(mandelPos)));
+    int shadowDECalls = deCalls - marchSteps - normalDECalls;
 
     // Most basic AO ever
     //color = mix(0.5 * color, color, gsValue);
@@ -492,4 +1168,7 @@ void main() {
     color = min(color, 1.0);
 
     outColor = vec4(color, 1.0);
+    marchStatistics(marchSteps, normalDECalls, shadowDECalls, false);
 }
+
+#endif
@@ -2,9 +2,29 @@
 
 layout (location = 0) in vec3 Position;
 
-uniform mat4 u_inverseVP;
-uniform float u_nearPlane;
-uniform float u_farPlane;
+// Same declaration as in mandel_raymarch.frag
+layout (std140) uniform Camera {
+  mat4 u_inverseVP;
+  mat4 u_viewProjection;
+  mat4 u_prevInverseVP;
+  vec3 u_eyePos;
+  float u_nearPlane;
+  vec2 u_screenSize;
+  float u_farPlane;
+  float u_screenRatio;
+  vec2 u_prevScreenSize;
+  float u_reprojectionFraction;
+  bool u_reprojection;
+  int u_coneBlockSize; // 0 without the cone pre-pass
+  int u_shadowScale; // 0 with shadows in the main pass
+  vec3 u_referenceHi; // Deep zoom: positions are relative to hi + lo
+  int u_deepIterations;
+  vec3 u_referenceLo;
+  bool u_deepZoom;
+};
+
+// Subpixel offset in NDC for progressive refinement
+uniform vec2 u_jitter;
 
 out float fragTime;
 
@@ -12,19 +32,29 @@ out vec3 vertRayOrigin;
 out vec3 vertRayDirection;
 
 void main() {
+    vec2 rayPosition = Position.xy + u_jitter;
+
+#ifdef CONE_PREPASS
+    // One fragment per block, stretch the rays so the partial blocks at the
+    // right and top edges line up with the pixels of the full resolution pass
+    vec2 coverage = ceil(u_screenSize / float(u_coneBlockSize)) * float(u_coneBlockSize) / u_screenSize;
+    rayPosition = (rayPosition + 1.0) * coverage - 1.0;
+#endif
 
     // Correct setup with artifacts
     //vec4 farPlane = u_inverseVP * vec4(Position.xy, u_farPlane, 1.0);
     //vec4 nearPlane = u_inverseVP * vec4(Position.xy, u_nearPlane, 1.0);
 
     // Incorrect setup with less artifacts
-    vec4 farPlane = u_inverseVP * vec4(Position.xy, u_nearPlane, 1.0);
-    vec4 nearPlane = u_inverseVP * vec4(Position.xy, u_farPlane, 1.0);
+    vec4 farPlane = u_inverseVP * vec4(rayPosition, u_nearPlane, 1.0);
+    vec4 nearPlane = u_inverseVP * vec4(rayPosition, u_farPlane, 1.0);
 
     farPlane /= farPlane.w;
     nearPlane /= nearPlane.w;
 
-    vertRayOrigin = nearPlane.xyz;
+    // The near plane point is rounded far beyond a deep zoom's pixels, the
+    // relative eye is exactly zero
+    vertRayOrigin = u_deepZoom ? u_eyePos : nearPlane.xyz;
     vertRayDirection = (farPlane.xyz - nearPlane.xyz);
 
     gl_Position = vec4(Position.xy, 0.0, 1.0);
@@ -0,0 +1,25 @@
+#include "Accumulation.hh"
+
+namespace {
+
+// Radical inverse, low discrepancy so any prefix of samples covers the pixel evenly
+float halton(unsigned int index, unsigned int base) {
+  float result = 0.0f;
+  float f = 1.0f / (float) base;
+  while (index > 0) {
+    result += f * (float) (index % base);
+    index /= base;
+    f /= (float) base;
+  }
+  return result;
+}
+
+}
+
+vec2 Accumulation::jitter() const {
+
+  // First sample goes through the pixel center like a regular frame
+  if (samples == 0)
+    return vec2(0.0f);
+  return vec2(halton(samples, 2) - 0.5f, halton(samples, 3) - 0.5f);
+}
@@ -1,11 +1,13 @@
+#include <algorithm>
+#include <cmath>
 #include "Camera.hh"
 
 Camera::Camera(unsigned int w, unsigned int h, float near, float far) {
-  eye = vec3(0.0f, 0.0f, 1.0f);
-  center = vec3(0.0f, 0.0f, 0.0f);
-  up = vec3(0.0f, 1.0f, 0.0f);
+  eye = dvec3(0.0, 0.0, 1.0);
+  center = dvec3(0.0, 0.0, 0.0);
+  up = dvec3(0.0, 1.0, 0.0);
   viewMatrix = glm::lookAt(eye, center, up);
-  projectionMatrix = glm::perspective(90.0f, (GLfloat) w / (GLfloat) h, near, far);
+  projectionMatrix = glm::perspective(90.0, (double) w / (double) h, (double) near, (double) far);
 };
 
 void Camera::printCoordinates() {
@@ -16,32 +18,46 @@ void Camera::updateCenteredViewMatrix() {
   viewMatrix = glm::lookAt(eye, center, up);
 }
 
-vec3 Camera::getViewMatrixBackward() {
-  return vec3(viewMatrix[1][3], viewMatrix[2][3], viewMatrix[3][3]);
+void Camera::updateSphericalView() {
+  sphericalToCartesian();
+  eye = dvec3(y, x, z);
+  updateCenteredViewMatrix();
 }
 
-vec3 Camera::getViewMatrixForward() {
+dvec3 Camera::getViewMatrixBackward() {
+  return dvec3(viewMatrix[1][3], viewMatrix[2][3], viewMatrix[3][3]);
+}
+
+dvec3 Camera::getViewMatrixForward() {
   return -getViewMatrixBackward();
 }
 
+dvec3 Camera::getPosition() const {
+  return dvec3(glm::inverse(viewMatrix)[3]);
+}
+
+double Camera::getZoomStep() const {
+  return surfaceDistance > 0.0 ? deepZoomRate * surfaceDistance : coordZoomStep;
+}
+
 void Camera::rotateViewMatrixHorizontally(float a) {
-  viewMatrix = glm::rotate(a, vec3(0.0, 1.0, 0.0)) * viewMatrix;
+  viewMatrix = glm::rotate((double) a, dvec3(0.0, 1.0, 0.0)) * viewMatrix;
 }
 
 void Camera::rotateViewMatrixVertically(float a) {
-  viewMatrix = glm::rotate(a, vec3(1.0, 0.0, 0.0)) * viewMatrix;
+  viewMatrix = glm::rotate((double) a, dvec3(1.0, 0.0, 0.0)) * viewMatrix;
 }
 
-void Camera::translateViewMatrix(float v) {
-  vec3 tvec = glm::normalize(getViewMatrixForward());
-  tvec = vec3(tvec.x * v, tvec.y * v, tvec.z * v);
+void Camera::translateViewMatrix(double v) {
+  dvec3 tvec = glm::normalize(getViewMatrixForward());
+  tvec = dvec3(tvec.x * v, tvec.y * v, tvec.z * v);
   viewMatrix = glm::translate(tvec) * viewMatrix;
 }
 
 void Camera::handleKeyPressW() {
   theta -= coordTurnStep;
-  theta = std::max(0.0f, theta);
-  theta = std::min(PI, theta);
+  theta = std::max(0.0, theta);
+  theta = std::min((double) PI, theta);
 
   if (freeControlsActive)
     rotateViewMatrixVertically(-coordTurnStep);
@@ -49,8 +65,8 @@ void Camera::handleKeyPressW() {
 
 void Camera::handleKeyPressA() {
   phi -= coordTurnStep * 2.0f;  // Could be optimized by keeping track of doubled step. Requires ImGui callbacks
-  phi = std::max(0.0f, phi);
-  phi = std::min(TWO_PI, phi);
+  phi = std::max(0.0, phi);
+  phi = std::min((double) TWO_PI, phi);
 
   if (freeControlsActive)
     rotateViewMatrixHorizontally(-coordTurnStep);
@@ -58,8 +74,8 @@ void Camera::handleKeyPressA() {
 
 void Camera::handleKeyPressS() {
   theta += coordTurnStep;
-  theta = std::max(0.0f, theta);
-  theta = std::min(PI, theta);
+  theta = std::max(0.0, theta);
+  theta = std::min((double) PI, theta);
 
   if (freeControlsActive)
     rotateViewMatrixVertically(coordTurnStep);
@@ -67,25 +83,27 @@ void Camera::handleKeyPressS() {
 
 void Camera::handleKeyPressD() {
   phi += coordTurnStep * 2.0f;
-  phi = std::max(0.0f, phi);
-  phi = std::min(TWO_PI, phi);
+  phi = std::max(0.0, phi);
+  phi = std::min((double) TWO_PI, phi);
 
   if (freeControlsActive)
     rotateViewMatrixHorizontally(coordTurnStep);
 }
 
 void Camera::handleKeyPressZ() {
-  r -= coordZoomStep;
+  double step = getZoomStep();
+  r -= step;
 
   if (freeControlsActive)
-    translateViewMatrix(-coordZoomStep);
+    translateViewMatrix(-step);
 }
 
 void Camera::handleKeyPressX() {
-  r += coordZoomStep;
+  double step = getZoomStep();
+  r += step;
 
   if (freeControlsActive)
-    translateViewMatrix(coordZoomStep);
+    translateViewMatrix(step);
 }
 
 void Camera::resetCoords() {
@@ -95,8 +113,22 @@ void Camera::resetCoords() {
 }
 
 void Camera::sphericalToCartesian() {
-  x = r * sinf(theta) * cosf(phi);
-  y = r * sinf(theta) * sinf(phi);
-  z = r * cosf(theta);
+  x = r * std::sin(theta) * std::cos(phi);
+  y = r * std::sin(theta) * std::sin(phi);
+  z = r * std::cos(theta);
+}
+
+void Camera::copyControls(const Camera &other) {
+  coordTurnStep = other.coordTurnStep;
+  coordZoomStep = other.coordZoomStep;
+  freeControlsActive = other.freeControlsActive;
+  constantZoom = other.constantZoom;
+  deepZoomRate = other.deepZoomRate;
+  surfaceDistance = other.surfaceDistance;
 }
 
+void Camera::setSphericalCoords(double r, double theta, double phi) {
+  this->r = r;
+  this->theta = theta;
+  this->phi = phi;
+}
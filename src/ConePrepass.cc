@@ -0,0 +1,44 @@
+#include <iostream>
+#include "ConePrepass.hh"
+
+namespace {
+
+unsigned int blocks(unsigned int pixels, unsigned int blockSize) {
+  return (pixels + blockSize - 1) / blockSize;
+}
+
+}
+
+void ConePrepass::reserve(unsigned int w, unsigned int h, unsigned int blockSize) {
+  unsigned int bw = blocks(w, blockSize), bh = blocks(h, blockSize);
+  if (fbo && bw <= capacityWidth && bh <= capacityHeight)
+    return;
+
+  capacityWidth = bw > capacityWidth ? bw : capacityWidth;
+  capacityHeight = bh > capacityHeight ? bh : capacityHeight;
+
+  if (!fbo) {
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &distanceTexture);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, distanceTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, capacityWidth, capacityHeight, 0, GL_RG, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, distanceTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "Error: cone pre-pass framebuffer incomplete\n";
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ConePrepass::bind(unsigned int w, unsigned int h, unsigned int blockSize) {
+  unsigned int bw = blocks(w, blockSize), bh = blocks(h, blockSize);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glViewport(0, 0, bw < capacityWidth ? bw : capacityWidth, bh < capacityHeight ? bh : capacityHeight);
+}
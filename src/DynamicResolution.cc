@@ -0,0 +1,24 @@
+#include <algorithm>
+#include <cmath>
+#include "DynamicResolution.hh"
+
+float DynamicResolution::update(float frameMS) {
+  if (minScale > maxScale)
+    std::swap(minScale, maxScale);
+
+  // Single frames spike on GUI interaction and shader compiles, react to the trend
+  smoothedMS = smoothedMS > 0.0f ? smoothedMS + 0.1f * (frameMS - smoothedMS) : frameMS;
+
+  if (!enabled || frameMS <= 0.0f)
+    return getScale();
+
+  // Raymarch cost is roughly linear in pixel count, so the per axis scale
+  // goes with the square root of the ratio. Drop quickly, recover slowly,
+  // and leave a dead band so the resolution does not flicker around the target.
+  float ratio = targetMS / smoothedMS;
+  if (ratio < 0.95f || ratio > 1.05f)
+    scale *= std::min(std::max(std::sqrt(ratio), 0.9f), 1.02f);
+
+  scale = std::min(std::max(scale, minScale), maxScale);
+  return scale;
+}
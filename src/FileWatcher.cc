@@ -0,0 +1,97 @@
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FileWatcher.hh"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace {
+
+time_t modificationTime(const std::string &path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+}
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+  if (inotifyFd >= 0)
+    close(inotifyFd);
+}
+
+bool FileWatcher::watch(const std::string &path) {
+  WatchedFile file;
+  size_t slash = path.rfind('/');
+  file.path = path;
+  file.directory = slash == std::string::npos ? "." : path.substr(0, slash);
+  file.name = slash == std::string::npos ? path : path.substr(slash + 1);
+  file.modified = modificationTime(path);
+
+#ifdef __linux__
+  if (inotifyFd >= 0) {
+    int wd = inotify_add_watch(inotifyFd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+      return false;
+    directories[wd] = file.directory;
+  }
+#endif
+
+  if (inotifyFd < 0 && file.modified == 0)
+    return false;
+  files.push_back(file);
+  return true;
+}
+
+bool FileWatcher::poll() {
+  if (files.empty())
+    return false;
+  return inotifyFd >= 0 ? pollInotify() : pollModified();
+}
+
+bool FileWatcher::pollInotify() {
+  bool changed = false;
+#ifdef __linux__
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+    if (length <= 0)
+      break; // EAGAIN, nothing more for now
+
+    for (char *p = buffer; p < buffer + length;) {
+      auto event = (const inotify_event *) p;
+      p += sizeof(inotify_event) + event->len;
+      if (event->len == 0)
+        continue;
+      for (const WatchedFile &file : files)
+        if (file.name == event->name && directories[event->wd] == file.directory)
+          changed = true;
+    }
+  }
+#endif
+  return changed;
+}
+
+bool FileWatcher::pollModified() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - lastCheck < std::chrono::milliseconds(250))
+    return false;
+  lastCheck = now;
+
+  bool changed = false;
+  for (WatchedFile &file : files) {
+    time_t modified = modificationTime(file.path);
+    if (modified != file.modified) {
+      file.modified = modified;
+      changed = true;
+    }
+  }
+  return changed;
+}
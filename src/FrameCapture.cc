@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+#include <unistd.h>
+#include "FrameCapture.hh"
+#include "Image.hh"
+
+FrameCapture::~FrameCapture() {
+  // Without a context the buffers go with it, only the writer needs joining
+  finish();
+  if (writer.joinable())
+    writer.join();
+}
+
+bool FrameCapture::start(CaptureMode newMode, const std::string &newTarget, int newFps, unsigned int newFrameLimit) {
+  stop();
+  if (newMode == CAPTURE_OFF)
+    return true;
+
+  // The pattern goes to snprintf on the writer thread, anything but the frame number there is unsafe
+  if (newMode == CAPTURE_IMAGES && !validFramePattern(newTarget, newFrameLimit != 1)) {
+    std::cerr << "Error: image file names need exactly one %u, %0Nu or %d for the frame number, got "
+              << newTarget << std::endl;
+    return false;
+  }
+
+  video = nullptr;
+  videoWidth = videoHeight = 0;
+  if (newMode == CAPTURE_Y4M && newTarget == "-") {
+    // The video takes over stdout, everything printed from here on goes to stderr
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 || (video = fdopen(fd, "wb")) == nullptr) {
+      std::cerr << "Error: could not move stdout over for the video" << std::endl;
+      return false;
+    }
+  }
+  // A reader going away mid-video should end the capture, not the program
+  signal(SIGPIPE, SIG_IGN);
+
+  mode = newMode;
+  target = newTarget;
+  fps = std::max(newFps, 1);
+  frameLimit = newFrameLimit;
+  framesRead = framesDropped = 0;
+  framesWritten = 0;
+  writeFailed = false;
+  finishing = false;
+  writer = std::thread(&FrameCapture::writerLoop, this, mode);
+  return true;
+}
+
+void FrameCapture::stop() {
+  if (mode != CAPTURE_OFF)
+    collect(true);
+  finish();
+  if (writer.joinable())
+    writer.join();
+}
+
+void FrameCapture::finish() {
+  mode = CAPTURE_OFF;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finishing = true;
+  }
+  wake.notify_all();
+}
+
+void FrameCapture::capture(unsigned int w, unsigned int h) {
+  if (mode == CAPTURE_OFF)
+    return;
+
+  collect(false);
+  if (writeFailed) {
+    std::cerr << "Error: capture to " << target << " failed, stopping" << std::endl;
+    stop();
+    return;
+  }
+  if (frameLimit > 0 && framesRead + framesDropped + slotsInFlight >= frameLimit) {
+    // The writer finishes the last frames on its own, no need to wait on it here
+    if (slotsInFlight == 0)
+      finish();
+    return;
+  }
+
+  if (slotsInFlight == RING_SIZE) {
+    framesDropped++;
+    return;
+  }
+
+  if (slots[0].pbo == 0) {
+    for (Slot &slot : slots)
+      glGenBuffers(1, &slot.pbo);
+  }
+
+  Slot &slot = slots[(oldestSlot + slotsInFlight) % RING_SIZE];
+  size_t size = 4 * (size_t) w * h;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  if (slot.width != w || slot.height != h)
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glReadBuffer(GL_BACK);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = w;
+  slot.height = h;
+  slotsInFlight++;
+}
+
+void FrameCapture::collect(bool wait) {
+  while (slotsInFlight > 0) {
+    Slot &slot = slots[oldestSlot];
+    GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+    GLuint64 timeout = wait ? 1000000000 : 0; // 1 s
+    GLenum status = glClientWaitSync(slot.fence, flags, timeout);
+    if (status == GL_TIMEOUT_EXPIRED && !wait)
+      return;
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    oldestSlot = (oldestSlot + 1) % RING_SIZE;
+    slotsInFlight--;
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      framesDropped++;
+      continue;
+    }
+
+    Frame frame;
+    frame.width = slot.width;
+    frame.height = slot.height;
+    frame.index = framesRead;
+    size_t size = 4 * (size_t) slot.width * slot.height;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (queue.size() >= MAX_QUEUED) {
+        framesDropped++;
+        continue;
+      }
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    auto mapped = (const unsigned char *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped != nullptr) {
+      frame.pixels.assign(mapped, mapped + size);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (mapped == nullptr) {
+      framesDropped++;
+      continue;
+    }
+
+    framesRead++;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(std::move(frame));
+    }
+    wake.notify_one();
+  }
+}
+
+void FrameCapture::writerLoop(CaptureMode writeMode) {
+  if (writeMode == CAPTURE_Y4M && video == nullptr)
+    openVideo();
+
+  while (true) {
+    Frame frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this] { return finishing || !queue.empty(); });
+      if (queue.empty())
+        break;
+      frame = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    if (writeFailed)
+      continue; // Drain so stop() does not wait on frames that will never be written
+    bool ok = writeMode == CAPTURE_Y4M ? writeY4M(frame) : writeImage(frame);
+    if (ok)
+      framesWritten++;
+    else
+      writeFailed = true;
+  }
+
+  if (video != nullptr) {
+    fclose(video);
+    video = nullptr;
+  }
+}
+
+void FrameCapture::openVideo() {
+  // Opening a named pipe blocks until the reader shows up, which is why it happens here
+  video = fopen(target.c_str(), "wb");
+  if (video == nullptr) {
+    fprintf(stderr, "Failed to open %s for writing.\n", target.c_str());
+    writeFailed = true;
+  }
+}
+
+bool FrameCapture::writeImage(const Frame &frame) {
+  Image image(frame.width, frame.height);
+  for (unsigned int y = 0; y < frame.height; y++) {
+    const unsigned char *src = &frame.pixels[4 * (size_t) (frame.height - 1 - y) * frame.width];
+    unsigned char *dst = &image.pixels[3 * (size_t) y * frame.width];
+    for (unsigned int x = 0; x < frame.width; x++) {
+      dst[3 * x] = src[4 * x];
+      dst[3 * x + 1] = src[4 * x + 1];
+      dst[3 * x + 2] = src[4 * x + 2];
+    }
+  }
+
+  char fileName[1024];
+  snprintf(fileName, sizeof(fileName), target.c_str(), frame.index);
+  if (!image.write(fileName))
+    return false;
+  if (frameLimit == 1)
+    std::cerr << "Wrote " << fileName << std::endl;
+  return true;
+}
+
+bool FrameCapture::writeY4M(const Frame &frame) {
+  if (video == nullptr)
+    return false;
+
+  if (videoWidth == 0) {
+    videoWidth = frame.width;
+    videoHeight = frame.height;
+    fprintf(video, "YUV4MPEG2 W%u H%u F%d:1 Ip A1:1 C444\n", videoWidth, videoHeight, fps);
+  }
+  // The stream has one size, frames from before a resize has settled are left out
+  if (frame.width != videoWidth || frame.height != videoHeight)
+    return true;
+
+  // BT.601 limited range, full resolution chroma
+  size_t planeSize = (size_t) frame.width * frame.height;
+  std::vector<unsigned char> planes(3 * planeSize);
+  unsigned char *yPlane = planes.data(), *uPlane = yPlane + planeSize, *vPlane = uPlane + planeSize;
+  for (unsigned int y = 0; y < frame.height; y++) {
+    const unsigned char *src = &frame.pixels[4 * (size_t) (frame.height - 1 - y) * frame.width];
+    size_t row = (size_t) y * frame.width;
+    for (unsigned int x = 0; x < frame.width; x++) {
+      int r = src[4 * x], g = src[4 * x + 1], b = src[4 * x + 2];
+      yPlane[row + x] = (unsigned char) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+      uPlane[row + x] = (unsigned char) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+      vPlane[row + x] = (unsigned char) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+  }
+
+  fputs("FRAME\n", video);
+  fwrite(planes.data(), 1, planes.size(), video);
+  return ferror(video) == 0;
+}
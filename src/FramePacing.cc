@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <GLFW/glfw3.h>
+#include "FramePacing.hh"
+
+namespace {
+
+const char *SWAP_MODE_NAMES[] = {"driver", "off", "vsync", "half", "adaptive"};
+
+}
+
+bool FramePacing::parseSwapMode(const std::string &name, int &mode) {
+  for (int i = SWAP_DRIVER; i <= SWAP_ADAPTIVE; i++) {
+    if (name == SWAP_MODE_NAMES[i]) {
+      mode = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *FramePacing::swapModeName(int mode) {
+  return mode >= SWAP_DRIVER && mode <= SWAP_ADAPTIVE ? SWAP_MODE_NAMES[mode] : "?";
+}
+
+void FramePacing::applySwapMode() {
+  appliedSwapMode = swapMode;
+  switch (swapMode) {
+    case SWAP_DRIVER:
+      // GLFW can not hand the interval back to the driver once one was set
+      break;
+    case SWAP_OFF:
+      glfwSwapInterval(0);
+      break;
+    case SWAP_VSYNC:
+      glfwSwapInterval(1);
+      break;
+    case SWAP_HALF:
+      glfwSwapInterval(2);
+      break;
+    case SWAP_ADAPTIVE:
+      // Late frames tear instead of waiting a whole refresh
+      if (glfwExtensionSupported("GLX_EXT_swap_control_tear") || glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+        glfwSwapInterval(-1);
+      } else {
+        std::cerr << "Adaptive vsync is not supported here, using vsync" << std::endl;
+        glfwSwapInterval(1);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void FramePacing::syncGpuClock() {
+  // Read back to back, GL_TIMESTAMP is the GPU's clock now and does not wait for it
+  GLint64 gpuNS = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuNS);
+  gpuClockOffset = glfwGetTime() - (double) gpuNS * 1.0e-9;
+  gpuClockSynced = true;
+}
+
+void FramePacing::beginFrame() {
+  if (swapMode != appliedSwapMode)
+    applySwapMode();
+  if (!gpuClockSynced)
+    syncGpuClock();
+
+  // Retire what the GPU has finished, then wait on the oldest until few enough are left
+  while (!pending.empty()) {
+    bool full = framesInFlight > 0 && pending.size() >= (size_t) framesInFlight;
+    if (!finishOldest(full || pending.size() >= MAX_PENDING))
+      break;
+  }
+
+  double now = glfwGetTime();
+  if (maxFPS > 0) {
+    double next = lastFrameStart + 1.0 / maxFPS;
+    if (next > now) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(next - now));
+      now = glfwGetTime();
+    }
+  }
+  lastFrameStart = now;
+}
+
+void FramePacing::endFrame() {
+  GLuint timestamp;
+  if (freeQueries.empty()) {
+    glGenQueries(1, &timestamp);
+  } else {
+    timestamp = freeQueries.back();
+    freeQueries.pop_back();
+  }
+  glQueryCounter(timestamp, GL_TIMESTAMP);
+  pending.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), timestamp, frameInputTime});
+}
+
+bool FramePacing::finishOldest(bool wait) {
+  PendingFrame &frame = pending.front();
+  GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+  GLuint64 timeout = wait ? 1000000000 : 0; // 1 s
+  GLenum status = glClientWaitSync(frame.fence, flags, timeout);
+  if (status == GL_TIMEOUT_EXPIRED && !wait)
+    return false;
+
+  // A fence that did not signal within the timeout is given up on, not counted.
+  // Past the fence the timestamp before it is written, reading it does not wait.
+  if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(frame.timestamp, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_TRUE) {
+      GLuint64 gpuNS = 0;
+      glGetQueryObjectui64v(frame.timestamp, GL_QUERY_RESULT, &gpuNS);
+      record((double) gpuNS * 1.0e-9 + gpuClockOffset - frame.inputTime, glfwGetTime());
+    }
+  }
+  glDeleteSync(frame.fence);
+  freeQueries.push_back(frame.timestamp);
+  pending.pop_front();
+  return true;
+}
+
+void FramePacing::record(double latency, double now) {
+  latencySum += latency;
+  latencyMax = std::max(latencyMax, latency);
+  latencyCount++;
+  if (now - windowStart < 1.0)
+    return;
+
+  latencyMS = (float) (1000.0 * latencySum / latencyCount);
+  maxLatencyMS = (float) (1000.0 * latencyMax);
+  windowStart = now;
+  latencySum = latencyMax = 0.0;
+  latencyCount = 0;
+
+  // The two clocks drift apart, line them up again every window
+  gpuClockSynced = false;
+}
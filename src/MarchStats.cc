@@ -0,0 +1,65 @@
+#include "MarchStats.hh"
+
+void MarchStats::init() {
+  glGenBuffers(RING_SIZE, buffers);
+  for (GLuint buffer : buffers) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(MarchCounters), nullptr, GL_DYNAMIC_READ);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MarchStats::attach(GLuint program) const {
+
+  // Programs without the counters (the cone pre-pass) have the block optimized out
+  GLuint index = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, "MarchStats");
+  if (index != GL_INVALID_INDEX)
+    glShaderStorageBlockBinding(program, index, binding);
+}
+
+void MarchStats::begin() {
+
+  // Not read back in time, drop that frame rather than wait for it
+  current = (current + 1) % RING_SIZE;
+  if (fences[current]) {
+    glDeleteSync(fences[current]);
+    fences[current] = nullptr;
+  }
+
+  const MarchCounters zero = {};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[current]);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffers[current]);
+}
+
+void MarchStats::end() {
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool MarchStats::poll() {
+  bool updated = false;
+
+  // Oldest first, so latest ends up with the newest finished frame
+  for (int i = 1; i <= RING_SIZE; i++) {
+    int index = (current + i) % RING_SIZE;
+    if (!fences[index])
+      continue;
+
+    GLenum status = glClientWaitSync(fences[index], 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      continue;
+
+    glDeleteSync(fences[index]);
+    fences[index] = nullptr;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[index]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(latest), &latest);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    hasLatest = true;
+    updated = true;
+  }
+
+  return updated;
+}
@@ -0,0 +1,169 @@
+#include <cstdio>
+#include "Profiler.hh"
+
+const char *Profiler::sectionName(ProfileSection section) {
+  switch (section) {
+    case PROFILE_POLL_EVENTS: return "glfwPollEvents";
+    case PROFILE_INPUT: return "Input";
+    case PROFILE_PACING: return "Frame pacing";
+    case PROFILE_DISPLAY: return "display()";
+    case PROFILE_GUI: return "renderGui()";
+    case PROFILE_SWAP: return "Swap";
+    case PROFILE_CAPTURE: return "Capture";
+    case PROFILE_GPU_RAYMARCH: return "GPU raymarch";
+    case PROFILE_GPU_SHADOWS: return "GPU shadows";
+    case PROFILE_GPU_IMGUI: return "GPU ImGui";
+    case PROFILE_GPU_SWAP: return "GPU swap";
+    default: return "?";
+  }
+}
+
+double Profiler::nowUS() const {
+  return std::chrono::duration<double, std::micro>(Clock::now() - epoch).count();
+}
+
+void Profiler::record(ProfileSection section, double startUS, double durationUS) {
+  trace.push_back({section, startUS, durationUS});
+  while (trace.size() > maxTraceEvents)
+    trace.pop_front();
+}
+
+void Profiler::takeMainThreadEvents() {
+  std::lock_guard<std::mutex> lock(mainThreadMutex);
+  if (recording) {
+    for (const TraceEvent &e : mainThreadEvents) {
+      frameMS[e.section] += (float) (e.durationUS / 1.0e3);
+      record(e.section, e.startUS, e.durationUS);
+    }
+  }
+  mainThreadEvents.clear();
+}
+
+void Profiler::addMainThreadTime(ProfileSection section, double startUS) {
+  double duration = nowUS() - startUS;
+  std::lock_guard<std::mutex> lock(mainThreadMutex);
+
+  // Bounded for when the render thread is stuck or not recording for a while
+  if (mainThreadEvents.size() < 1024)
+    mainThreadEvents.push_back({section, startUS, duration});
+}
+
+void Profiler::readBack(unsigned int ringIndex) {
+  for (int section = 0; section < PROFILE_SECTION_COUNT; section++) {
+    GpuQuery &q = queries[ringIndex][section];
+    if (!q.pending)
+      continue;
+
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE)
+      continue;
+
+    GLuint64 elapsedNS = 0;
+    glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &elapsedNS);
+    q.pending = false;
+
+    frameMS[section] = (float) ((double) elapsedNS / 1.0e6);
+    record((ProfileSection) section, q.submitUS, (double) elapsedNS / 1.0e3);
+  }
+}
+
+void Profiler::beginFrame() {
+  recording = enabled;
+  if (!recording) {
+    takeMainThreadEvents();
+    return;
+  }
+
+  if (!queriesCreated) {
+    for (auto &ring : queries)
+      for (auto &q : ring)
+        glGenQueries(1, &q.query);
+    queriesCreated = true;
+  }
+
+  for (unsigned int i = 0; i < QUERY_FRAMES; i++)
+    readBack(i);
+
+  // Queries of this slot still in flight after QUERY_FRAMES frames are dropped
+  frame++;
+  for (auto &q : queries[frame % QUERY_FRAMES])
+    q.pending = false;
+
+  for (int section = 0; section < PROFILE_SECTION_COUNT; section++)
+    if (!isGpuSection((ProfileSection) section))
+      frameMS[section] = 0.0f;
+  takeMainThreadEvents();
+}
+
+void Profiler::endFrame() {
+  if (!recording)
+    return;
+
+  historyOffset = (historyOffset + 1) % HISTORY_SIZE;
+  for (int section = 0; section < PROFILE_SECTION_COUNT; section++) {
+    history[section][historyOffset] = frameMS[section];
+
+    float sum = 0.0f;
+    for (float ms : history[section])
+      sum += ms;
+    averageMS[section] = sum / (float) HISTORY_SIZE;
+  }
+}
+
+void Profiler::beginCpu(ProfileSection section) {
+  if (recording)
+    cpuStartUS[section] = nowUS();
+}
+
+void Profiler::endCpu(ProfileSection section) {
+  if (!recording)
+    return;
+
+  double duration = nowUS() - cpuStartUS[section];
+  frameMS[section] += (float) (duration / 1.0e3);
+  record(section, cpuStartUS[section], duration);
+}
+
+void Profiler::beginGpu(ProfileSection section) {
+  if (!recording || openGpuSection != PROFILE_SECTION_COUNT)
+    return;
+
+  GpuQuery &q = queries[frame % QUERY_FRAMES][section];
+  q.submitUS = nowUS();
+  glBeginQuery(GL_TIME_ELAPSED, q.query);
+  openGpuSection = section;
+}
+
+void Profiler::endGpu() {
+  if (openGpuSection == PROFILE_SECTION_COUNT)
+    return;
+
+  glEndQuery(GL_TIME_ELAPSED);
+  queries[frame % QUERY_FRAMES][openGpuSection].pending = true;
+  openGpuSection = PROFILE_SECTION_COUNT;
+}
+
+bool Profiler::writeChromeTrace(const char *fileName) const {
+  FILE *file = fopen(fileName, "w");
+  if (!file) {
+    fprintf(stderr, "Failed to open %s for writing.\n", fileName);
+    return false;
+  }
+
+  // A track per thread, GPU sections on another at the time they were submitted
+  fprintf(file, "{\"traceEvents\":[\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Render thread\"}},\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}},\n");
+  fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":3,\"args\":{\"name\":\"Main thread\"}}");
+  for (const TraceEvent &e : trace) {
+    int tid = isGpuSection(e.section) ? 2 : isMainThreadSection(e.section) ? 3 : 1;
+    fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            sectionName(e.section), isGpuSection(e.section) ? "gpu" : "cpu", tid, e.startUS, e.durationUS);
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
@@ -0,0 +1,158 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+#include "ProgramBinaryCache.hh"
+
+namespace {
+
+const char MAGIC[4] = {'M', 'B', 'P', 'B'};
+const uint32_t VERSION = 1;
+
+/**
+ * File header, followed by the driver string and the binary
+ */
+struct BinaryHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t driverLength;
+  uint32_t binaryLength;
+  float compileMS;
+};
+
+uint64_t fnv1a(uint64_t hash, const std::string &text) {
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+bool makeDirectory(const std::string &path) {
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+}
+
+void ProgramBinaryCache::init() {
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  supported = formats > 0;
+
+  auto glString = [](GLenum name) {
+    auto s = (const char *) glGetString(name);
+    return std::string(s ? s : "");
+  };
+  driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+  const char *xdgCache = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  if (xdgCache != nullptr && *xdgCache != '\0') {
+    directory = std::string(xdgCache) + "/mandelbulb";
+  } else if (home != nullptr) {
+    makeDirectory(std::string(home) + "/.cache");
+    directory = std::string(home) + "/.cache/mandelbulb";
+  } else {
+    supported = false;
+  }
+
+  if (supported && !makeDirectory(directory)) {
+    fprintf(stderr, "Failed to create %s, program binaries are not cached.\n", directory.c_str());
+    supported = false;
+  }
+}
+
+std::string ProgramBinaryCache::fileName(const std::string &vertSource, const std::string &fragSource) const {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  hash = fnv1a(hash, driver);
+  hash = fnv1a(hash, std::string(1, '\0') + vertSource);
+  hash = fnv1a(hash, std::string(1, '\0') + fragSource);
+
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) hash);
+  return directory + name;
+}
+
+GLuint ProgramBinaryCache::load(const std::string &vertSource, const std::string &fragSource, float &compileMS) const {
+  if (!supported)
+    return 0;
+
+  std::string path = fileName(vertSource, fragSource);
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr)
+    return 0;
+
+  // The driver string is checked as well, a hash collision must not hand the driver a foreign binary
+  BinaryHeader header = {};
+  std::string storedDriver;
+  std::vector<char> binary;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MAGIC, 4) == 0
+      && header.version == VERSION && header.driverLength == driver.size();
+  if (ok) {
+    storedDriver.resize(header.driverLength);
+    binary.resize(header.binaryLength);
+    ok = fread(&storedDriver[0], 1, storedDriver.size(), file) == storedDriver.size()
+        && fread(binary.data(), 1, binary.size(), file) == binary.size() && storedDriver == driver;
+  }
+  fclose(file);
+  if (!ok)
+    return 0;
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, (GLenum) header.format, binary.data(), (GLsizei) binary.size());
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (linked == GL_FALSE) {
+    // Stale after all, compile and store over it
+    glDeleteProgram(program);
+    remove(path.c_str());
+    return 0;
+  }
+
+  compileMS = header.compileMS;
+  return program;
+}
+
+void ProgramBinaryCache::store(GLuint program, const std::string &vertSource, const std::string &fragSource,
+                               float compileMS) const {
+  if (!supported)
+    return;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  std::vector<char> binary((size_t) length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  BinaryHeader header = {};
+  memcpy(header.magic, MAGIC, 4);
+  header.version = VERSION;
+  header.format = format;
+  header.driverLength = (uint32_t) driver.size();
+  header.binaryLength = (uint32_t) length;
+  header.compileMS = compileMS;
+
+  // Renamed into place when complete, so another instance never reads half a file
+  std::string path = fileName(vertSource, fragSource);
+  std::string partial = path + ".part";
+  FILE *file = fopen(partial.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Failed to open %s for writing.\n", partial.c_str());
+    return;
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(driver.data(), 1, driver.size(), file);
+  fwrite(binary.data(), 1, (size_t) length, file);
+  bool ok = ferror(file) == 0;
+  ok = fclose(file) == 0 && ok;
+
+  if (!ok || rename(partial.c_str(), path.c_str()) != 0)
+    remove(partial.c_str());
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include "RenderTarget.hh"
+
+void RenderTarget::allocate(GLuint texture, GLenum format) const {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, format, capacityWidth, capacityHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool RenderTarget::reserve(unsigned int w, unsigned int h) {
+  if (fbo && w <= capacityWidth && h <= capacityHeight)
+    return false;
+
+  capacityWidth = w > capacityWidth ? w : capacityWidth;
+  capacityHeight = h > capacityHeight ? h : capacityHeight;
+
+  if (!fbo) {
+    glGenFramebuffers(1, &fbo);
+    glGenFramebuffers(1, &colorFbo);
+    glGenTextures(1, &colorTexture);
+    glGenTextures(1, &litTexture);
+    glGenTextures(2, historyTextures);
+  }
+
+  // Float so it can hold a running mean of many samples without banding
+  allocate(colorTexture, GL_RGBA32F);
+  allocate(litTexture, GL_RGBA16F);
+  allocate(historyTextures[0], GL_RGBA32F);
+  allocate(historyTextures[1], GL_RGBA32F);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, historyTextures[historyWrite], 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, litTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "Error: render target framebuffer incomplete\n";
+
+  // Sampling the lit color and history while they are attached to the bound framebuffer would be a feedback loop
+  glBindFramebuffer(GL_FRAMEBUFFER, colorFbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "Error: render target color framebuffer incomplete\n";
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return true;
+}
+
+void RenderTarget::bind(unsigned int w, unsigned int h) {
+  width = w < capacityWidth ? w : capacityWidth;
+  height = h < capacityHeight ? h : capacityHeight;
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, drawBuffers);
+  glViewport(0, 0, width, height);
+}
+
+void RenderTarget::bindLit(unsigned int w, unsigned int h) {
+  bind(w, h);
+  const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, drawBuffers);
+}
+
+void RenderTarget::bindColor(unsigned int w, unsigned int h) {
+  width = w < capacityWidth ? w : capacityWidth;
+  height = h < capacityHeight ? h : capacityHeight;
+  glBindFramebuffer(GL_FRAMEBUFFER, colorFbo);
+  glViewport(0, 0, width, height);
+}
+
+void RenderTarget::blitToScreen(unsigned int screenWidth, unsigned int screenHeight) const {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, screenWidth, screenHeight);
+}
+
+void RenderTarget::swapHistory() {
+  historyWrite = 1 - historyWrite;
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, historyTextures[historyWrite], 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,368 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "EmbeddedShaders.hh"
+#include "ShaderCache.hh"
+#include "utils.hh"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Toggle bits of the permutation key, bits 4 to 7 hold the integer Mandelbulb
+// power and the factors take the three upper bytes
+const uint32_t MANDELBULB_BIT = 1u << 0;
+const uint32_t JULIA_BIT = 1u << 1;
+const uint32_t MANDELBOX_BIT = 1u << 2;
+
+namespace {
+
+std::string infoLog(GLuint object, bool program) {
+  GLint length = 0;
+  if (program)
+    glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+  else
+    glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+  if (length <= 1)
+    return "";
+
+  std::string log((size_t) length, '\0');
+  if (program)
+    glGetProgramInfoLog(object, length, nullptr, &log[0]);
+  else
+    glGetShaderInfoLog(object, length, nullptr, &log[0]);
+  log.resize(strlen(log.c_str()));
+  return log;
+}
+
+const char *PASS_NAMES[] = {"uber-shader", "cone prepass", "shadow pass", "shadow composite"};
+
+}
+
+const char *ShaderCache::passDefines(int pass) {
+  switch (pass) {
+    case PASS_CONE: return "#define CONE_PREPASS\n";
+    case PASS_SHADOW: return "#define SHADOW_PASS\n";
+    case PASS_SHADOW_COMPOSITE: return "#define SHADOW_COMPOSITE\n";
+    default: return "";
+  }
+}
+
+void ShaderCache::deleteEntry(Entry &entry) {
+  if (entry.job)
+    compileThread.cancel(entry.job);
+  if (entry.vertShader) glDeleteShader(entry.vertShader);
+  if (entry.fragShader) glDeleteShader(entry.fragShader);
+  if (entry.program) glDeleteProgram(entry.program);
+  entry = Entry();
+}
+
+void ShaderCache::clear() {
+  for (auto &it : programs)
+    deleteEntry(it.second);
+  programs.clear();
+}
+
+float ShaderCache::millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+bool ShaderCache::readSource(const char *fileName, std::string &source) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (file) {
+    std::ostringstream text;
+    text << file.rdbuf();
+    source = text.str();
+    return true;
+  }
+
+  const char *name = strrchr(fileName, '/');
+  const char *embedded = embeddedShader(name ? name + 1 : fileName);
+  if (embedded == nullptr)
+    fprintf(stderr, "Failed to read %s from disk and it is not built in.\n", fileName);
+  source = embedded ? embedded : "";
+  return false;
+}
+
+void ShaderCache::initCompile() {
+  if (binaryCacheReady)
+    return;
+  binaryCache.init();
+  binaryCacheReady = true;
+
+#ifdef GL_KHR_parallel_shader_compile
+  parallelCompile = GLEW_KHR_parallel_shader_compile;
+  if (parallelCompile)
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // As many as the driver likes
+#endif
+  if (!parallelCompile && compileContext) {
+    compileThread.start(compileContext);
+    printf("No KHR_parallel_shader_compile, compiling on a shared context thread\n");
+  } else if (!parallelCompile) {
+    printf("No KHR_parallel_shader_compile, specialized shaders are off and reloads block\n");
+  }
+}
+
+bool ShaderCache::startCompile(Entry &entry, const std::string &vs, const std::string &fs, float &cachedCompileMS,
+                               bool background) {
+  float compileMS = 0.0f;
+  entry.program = binaryCache.load(vs, fs, compileMS);
+  if (entry.program) {
+    entry.ready = true;
+    cachedCompileMS += compileMS;
+    return true;
+  }
+
+  // No status queries here, those would wait for the compile
+  if (background && compileThread.running())
+    entry.job = compileThread.submit(vs, fs);
+  else
+    entry.program = ShaderCompileThread::beginLink(vs, fs, entry.vertShader, entry.fragShader);
+  entry.startFrame = frame;
+  entry.startTime = Clock::now();
+  entry.vertSource = vs;
+  entry.fragSource = fs;
+  return false;
+}
+
+bool ShaderCache::isCompileDone(const Entry &entry) const {
+  if (entry.job)
+    return entry.job->done;
+  if (parallelCompile) {
+    GLint done = GL_FALSE;
+    glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+  }
+
+  // Without the extension or a compile thread there is no way to ask. Only reloads
+  // get here then, drivers that compile on their own threads get a few frames
+  // before the status query blocks.
+  return frame - entry.startFrame > 3;
+}
+
+bool ShaderCache::finishCompile(Entry &entry, const std::string &name, std::string &log) {
+  if (entry.job) {
+    entry.vertShader = entry.job->vertShader;
+    entry.fragShader = entry.job->fragShader;
+    entry.program = entry.job->program;
+    entry.job.reset();
+  }
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+
+  if (linked == GL_FALSE) {
+    log += "[" + name + "]\n" + infoLog(entry.vertShader, false) + infoLog(entry.fragShader, false)
+        + infoLog(entry.program, true);
+    entry.failed = true;
+  } else {
+    // Rounded up to the frame it was noticed in
+    entry.ready = true;
+    binaryCache.store(entry.program, entry.vertSource, entry.fragSource, millisecondsSince(entry.startTime));
+  }
+
+  glDetachShader(entry.program, entry.vertShader);
+  glDetachShader(entry.program, entry.fragShader);
+  glDeleteShader(entry.vertShader);
+  glDeleteShader(entry.fragShader);
+  entry.vertShader = 0;
+  entry.fragShader = 0;
+  entry.vertSource.clear();
+  entry.fragSource.clear();
+  return linked == GL_TRUE;
+}
+
+void ShaderCache::load() {
+  auto start = Clock::now();
+  initCompile();
+  clear();
+  for (Entry &entry : passes)
+    deleteEntry(entry);
+
+  // Files on disk win over the built-in copies, so shaders can be edited and reloaded without a rebuild
+  bool vertFromDisk = readSource(vertFileName, vertSource);
+  bool fragFromDisk = readSource(fragFileName, fragSource);
+  printf("Shaders: %s, %s\n", vertFromDisk ? vertFileName : "built-in vertex shader",
+         fragFromDisk ? fragFileName : "built-in fragment shader");
+
+  // Nothing to fall back on yet, a pass that fails is kept broken and shows its log
+  unsigned int fromCache = 0;
+  float cachedCompileMS = 0.0f;
+  errors.clear();
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    Entry &entry = passes[pass];
+    std::string defines = passDefines(pass);
+    if (startCompile(entry, utils::injectDefines((const unsigned char *) vertSource.c_str(), defines),
+                     utils::injectDefines((const unsigned char *) fragSource.c_str(), defines), cachedCompileMS,
+                     false))
+      fromCache++;
+    else
+      finishCompile(entry, PASS_NAMES[pass], errors);
+    readyFunc(entry.program);
+  }
+  if (!errors.empty())
+    fprintf(stderr, "Shader compile failed:\n%s\n", errors.c_str());
+
+  float loadMS = millisecondsSince(start);
+  if (fromCache == PASS_COUNT)
+    printf("Loaded %d programs from the binary cache in %.1f ms, compiling them took %.1f ms\n", PASS_COUNT,
+           loadMS, cachedCompileMS);
+  else if (binaryCache.enabled())
+    printf("Compiled %u programs in %.1f ms, cached in %s for the next launch\n", PASS_COUNT - fromCache, loadMS,
+           binaryCache.getDirectory().c_str());
+  else
+    printf("Compiled %u programs in %.1f ms, the driver has no program binary formats to cache them in\n",
+           PASS_COUNT - fromCache, loadMS);
+  fflush(stdout);
+  generation++;
+}
+
+void ShaderCache::reload() {
+  initCompile();
+  for (Entry &entry : reloadPasses)
+    deleteEntry(entry);
+
+  readSource(vertFileName, reloadVertSource);
+  readSource(fragFileName, reloadFragSource);
+  reloadErrors.clear();
+  reloadStart = Clock::now();
+  reloading = true;
+
+  float cachedCompileMS = 0.0f;
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    std::string defines = passDefines(pass);
+    startCompile(reloadPasses[pass], utils::injectDefines((const unsigned char *) reloadVertSource.c_str(), defines),
+                 utils::injectDefines((const unsigned char *) reloadFragSource.c_str(), defines), cachedCompileMS,
+                 true);
+  }
+}
+
+void ShaderCache::pollReload() {
+  bool done = true, failed = false;
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    Entry &entry = reloadPasses[pass];
+    if (!entry.ready && !entry.failed) {
+      if (isCompileDone(entry))
+        finishCompile(entry, PASS_NAMES[pass], reloadErrors);
+      else
+        done = false;
+    }
+    failed |= entry.failed;
+  }
+
+  // Nothing is swapped until every pass is through, and nothing at all if one failed
+  if (failed) {
+    for (Entry &entry : reloadPasses)
+      deleteEntry(entry);
+    reloading = false;
+    errors = reloadErrors;
+    fprintf(stderr, "Shader reload failed, keeping the previous programs\n");
+    return;
+  }
+  if (!done)
+    return;
+
+  // Permutations were built from the old sources
+  clear();
+  for (int pass = 0; pass < PASS_COUNT; pass++) {
+    deleteEntry(passes[pass]);
+    passes[pass] = reloadPasses[pass];
+    reloadPasses[pass] = Entry();
+    readyFunc(passes[pass].program);
+  }
+  vertSource.swap(reloadVertSource);
+  fragSource.swap(reloadFragSource);
+  reloading = false;
+  errors.clear();
+  generation++;
+  printf("Reloaded shaders in %.1f ms\n", millisecondsSince(reloadStart));
+  fflush(stdout);
+}
+
+bool ShaderCache::permutationKey(const FractalUniforms &u, const AppState &state, uint32_t &key) {
+  int boxFoldFactor = state.boxFoldingOn ? u.boxFoldFactor : 0;
+  int sphereFoldFactor = state.sphereFoldingOn ? u.sphereFoldFactor : 0;
+  int tetraFactor = state.recursiveTetraOn ? u.tetraFactor : 0;
+  int integerPower = state.mandelbulbOn ? u.integerPower() : 0;
+
+  // Factors get a byte each, anything outside stays on the uber-shader
+  for (int factor : {boxFoldFactor, sphereFoldFactor, tetraFactor})
+    if (factor < 0 || factor > 0xFF)
+      return false;
+
+  key = (state.mandelbulbOn ? MANDELBULB_BIT : 0u)
+      | (u.julia ? JULIA_BIT : 0u)
+      | (state.mandelBoxOn ? MANDELBOX_BIT : 0u)
+      | ((uint32_t) integerPower << 4)
+      | ((uint32_t) boxFoldFactor << 8)
+      | ((uint32_t) sphereFoldFactor << 16)
+      | ((uint32_t) tetraFactor << 24);
+  return true;
+}
+
+std::string ShaderCache::permutationDefines(uint32_t key) {
+  std::ostringstream defines;
+  defines << "#define PERMUTATION\n"
+          << "#define MANDELBULB_ON " << ((key & MANDELBULB_BIT) ? "true" : "false") << "\n"
+          << "#define JULIA_ON " << ((key & JULIA_BIT) ? "true" : "false") << "\n"
+          << "#define MANDELBOX_ON " << ((key & MANDELBOX_BIT) ? "true" : "false") << "\n"
+          << "#define BOX_FOLD_FACTOR " << ((key >> 8) & 0xFF) << "\n"
+          << "#define SPHERE_FOLD_FACTOR " << ((key >> 16) & 0xFF) << "\n"
+          << "#define TETRA_FACTOR " << ((key >> 24) & 0xFF) << "\n";
+  if ((key >> 4) & 0xF)
+    defines << "#define MANDELBULB_POWER " << ((key >> 4) & 0xF) << "\n";
+  return defines.str();
+}
+
+void ShaderCache::poll() {
+  frame++;
+  for (auto &it : programs) {
+    Entry &entry = it.second;
+    if (entry.ready || entry.failed || !isCompileDone(entry))
+      continue;
+
+    char name[32];
+    snprintf(name, sizeof(name), "permutation %08x", it.first);
+    std::string log;
+    if (finishCompile(entry, name, log))
+      readyFunc(entry.program);
+    else
+      errors = log;
+  }
+
+  if (reloading)
+    pollReload();
+}
+
+GLuint ShaderCache::programFor(const FractalUniforms &u, const AppState &state) {
+  uint32_t key;
+  if (!canSpecialize() || fragSource.empty() || !permutationKey(u, state, key))
+    return uberProgram();
+
+  auto it = programs.find(key);
+  if (it == programs.end()) {
+    Entry &entry = programs[key];
+    std::string fs = utils::injectDefines((const unsigned char *) fragSource.c_str(), permutationDefines(key));
+    float cachedCompileMS = 0.0f;
+    if (startCompile(entry, vertSource, fs, cachedCompileMS, true))
+      readyFunc(entry.program);
+    return entry.ready ? entry.program : uberProgram();
+  }
+
+  return it->second.ready ? it->second.program : uberProgram();
+}
+
+unsigned int ShaderCache::pendingCount() const {
+  unsigned int count = 0;
+  for (auto &it : programs)
+    if (!it.second.ready && !it.second.failed) count++;
+  return count;
+}
+
+unsigned int ShaderCache::readyCount() const {
+  unsigned int count = 0;
+  for (auto &it : programs)
+    if (it.second.ready) count++;
+  return count;
+}
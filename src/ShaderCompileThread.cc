@@ -0,0 +1,106 @@
+#include <algorithm>
+#include "ShaderCompileThread.hh"
+
+ShaderCompileThread::~ShaderCompileThread() {
+  stop();
+}
+
+GLuint ShaderCompileThread::beginLink(const std::string &vs, const std::string &fs,
+                                      GLuint &vertShader, GLuint &fragShader) {
+  const char *vertStrings[1] = {vs.c_str()};
+  const char *fragStrings[1] = {fs.c_str()};
+
+  vertShader = glCreateShader(GL_VERTEX_SHADER);
+  fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(vertShader, 1, vertStrings, nullptr);
+  glShaderSource(fragShader, 1, fragStrings, nullptr);
+  glCompileShader(vertShader);
+  glCompileShader(fragShader);
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertShader);
+  glAttachShader(program, fragShader);
+  glBindAttribLocation(program, 0, "in_Position");
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(program);
+  return program;
+}
+
+void ShaderCompileThread::deleteObjects(Job &job) {
+  if (job.vertShader) glDeleteShader(job.vertShader);
+  if (job.fragShader) glDeleteShader(job.fragShader);
+  if (job.program) glDeleteProgram(job.program);
+  job.vertShader = job.fragShader = job.program = 0;
+}
+
+void ShaderCompileThread::start(GLFWwindow *sharedContext) {
+  if (running())
+    return;
+  context = sharedContext;
+  stopping = false;
+  thread = std::thread(&ShaderCompileThread::loop, this);
+}
+
+void ShaderCompileThread::stop() {
+  if (!running())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    queue.clear();
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+std::shared_ptr<ShaderCompileThread::Job> ShaderCompileThread::submit(const std::string &vs, const std::string &fs) {
+  auto job = std::make_shared<Job>();
+  job->vertSource = vs;
+  job->fragSource = fs;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(job);
+  }
+  wake.notify_one();
+  return job;
+}
+
+void ShaderCompileThread::cancel(const std::shared_ptr<Job> &job) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto queued = std::find(queue.begin(), queue.end(), job);
+  if (queued != queue.end())
+    queue.erase(queued);
+  else if (job->done)
+    deleteObjects(*job);
+  else
+    job->cancelled = true; // Being compiled, the thread deletes it once linked
+}
+
+void ShaderCompileThread::loop() {
+  glfwMakeContextCurrent(context);
+  while (true) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (stopping)
+        break;
+      job = queue.front();
+      queue.pop_front();
+    }
+
+    // The status query waits for the link here rather than on the render thread, and
+    // glFinish makes the finished program visible to the render context
+    job->program = beginLink(job->vertSource, job->fragSource, job->vertShader, job->fragShader);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(job->program, GL_LINK_STATUS, &linked);
+    glFinish();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (job->cancelled)
+      deleteObjects(*job);
+    else
+      job->done = true;
+  }
+  glfwMakeContextCurrent(nullptr);
+}
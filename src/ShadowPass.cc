@@ -0,0 +1,45 @@
+#include <iostream>
+#include "ShadowPass.hh"
+
+namespace {
+
+unsigned int blocks(unsigned int pixels, unsigned int scale) {
+  return (pixels + scale - 1) / scale;
+}
+
+}
+
+void ShadowPass::reserve(unsigned int w, unsigned int h, unsigned int scale) {
+  unsigned int bw = blocks(w, scale), bh = blocks(h, scale);
+  if (fbo && bw <= capacityWidth && bh <= capacityHeight)
+    return;
+
+  capacityWidth = bw > capacityWidth ? bw : capacityWidth;
+  capacityHeight = bh > capacityHeight ? bh : capacityHeight;
+
+  if (!fbo) {
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &shadowTexture);
+  }
+
+  // Half floats keep the hit distance to about a thousandth, plenty to tell surfaces apart
+  glBindTexture(GL_TEXTURE_2D, shadowTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, capacityWidth, capacityHeight, 0, GL_RG, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, shadowTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "Error: shadow pass framebuffer incomplete\n";
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowPass::bind(unsigned int w, unsigned int h, unsigned int scale) {
+  unsigned int bw = blocks(w, scale), bh = blocks(h, scale);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glViewport(0, 0, bw < capacityWidth ? bw : capacityWidth, bh < capacityHeight ? bh : capacityHeight);
+}
@@ -0,0 +1,114 @@
+#include "UniformBlocks.hh"
+
+CameraBlock packCameraBlock(const mat4 &inverseVP, const mat4 &viewProjection, vec3 eyePos,
+                            float nearPlane, float farPlane, vec2 screenSize) {
+  CameraBlock b = {};
+  b.inverseVP = inverseVP;
+  b.viewProjection = viewProjection;
+  b.prevInverseVP = b.inverseVP;
+  b.eyePos = eyePos;
+  b.nearPlane = nearPlane;
+  b.screenSize = screenSize;
+  b.farPlane = farPlane;
+  b.screenRatio = screenSize.x / screenSize.y;
+  b.prevScreenSize = screenSize;
+  return b;
+}
+
+void packReprojection(CameraBlock &b, const FractalUniforms &u, const mat4 &prevInverseVP, vec2 prevScreenSize) {
+  b.prevInverseVP = prevInverseVP;
+  b.prevScreenSize = prevScreenSize;
+  b.reprojectionFraction = u.reprojectionFraction;
+  b.reprojection = 1;
+}
+
+void packConePrepass(CameraBlock &b, int blockSize) {
+  b.coneBlockSize = blockSize;
+}
+
+void packShadowPass(CameraBlock &b, int scale) {
+  b.shadowScale = scale;
+}
+
+void packDeepZoom(CameraBlock &b, dvec3 reference, int iterations) {
+  b.referenceHi = vec3(reference);
+  b.referenceLo = vec3(reference - dvec3(b.referenceHi));
+  b.deepIterations = iterations;
+  b.deepZoom = 1;
+}
+
+FractalBlock packFractalBlock(const FractalUniforms &u, const AppState &state) {
+
+  // Every member is assigned and the padding zeroed, so two packs of the same values compare equal byte for byte
+  FractalBlock b = {};
+
+  // Renderer
+  b.maxRaySteps = u.maxRaySteps;
+  b.minDistance = u.minDistance;
+  b.fractalIters = u.fractalIters;
+  b.bailLimit = u.bailLimit;
+  b.fudgeFactor = u.fudgeFactor;
+
+  // Fractals
+  b.mandelbulbOn = state.mandelbulbOn;
+  b.derivativeBias = u.derivativeBias;
+  b.power = u.power;
+  b.julia = u.julia;
+  b.juliaC = u.juliaC;
+
+  b.boxFoldFactor = state.boxFoldingOn ? u.boxFoldFactor : 0;
+  b.boxFoldingLimit = u.boxFoldingLimit;
+
+  b.sphereFoldFactor = state.sphereFoldingOn ? u.sphereFoldFactor : 0;
+  b.sphereMinRadius = u.sphereMinRadius;
+  b.sphereFixedRadius = u.sphereFixedRadius;
+  b.sphereMinTimeVariance = u.sphereMinTimeVariance;
+
+  b.mandelBoxOn = state.mandelBoxOn;
+  b.mandelBoxScale = u.mandelBoxScale;
+
+  b.tetraFactor = state.recursiveTetraOn ? u.tetraFactor : 0;
+  b.tetraScale = u.tetraScale;
+
+  // Graphics
+  b.orbitStrength = u.orbitStrength;
+  b.color0 = u.otColor0;
+  b.color1 = u.otColor1;
+  b.color2 = u.otColor2;
+  b.color3 = u.otColor3;
+  b.colorBase = u.otColorBase;
+  b.baseColorStrength = u.otBaseStrength;
+  b.otDist0to1 = u.otDist0to1;
+  b.otDist1to2 = u.otDist1to2;
+  b.otDist2to3 = u.otDist2to3;
+  b.otDist3to0 = u.otDist3to0;
+  b.otCycleIntensity = u.otCycleIntensity;
+  b.otPaletteOffset = u.otPaletteOffset;
+
+  b.shadowRayMinStepsTaken = u.shadowRayMinStepsTaken;
+  b.lightSource = u.lightSource;
+  b.phongShadingMixFactor = u.phongShadingMixFactor;
+  b.lightPos = u.lightPos;
+  b.shadowBrightness = u.shadowBrightness;
+  b.shadowSharpness = u.shadowSharpness;
+  b.bgColor = u.bgColor;
+  b.glowColor = u.glowColor;
+  b.glowFactor = u.glowFactor;
+  b.showBgGradient = u.showBgGradient;
+  b.noiseFactor = u.noiseFactor;
+  b.noiseTexture = u.noiseTexture;
+  b.ambientIntensity = u.ambientIntensity;
+  b.diffuseIntensity = u.diffuseIntensity;
+  b.specularIntensity = u.specularIntensity;
+  b.shininess = u.shininess;
+  b.gammaCorrection = u.gammaCorrection;
+  b.debugView = u.debugView;
+  b.marchStats = u.marchStats;
+  b.normalMode = u.normalMode;
+  return b;
+}
+
+void packDistanceGrid(FractalBlock &b, float extent) {
+  b.distanceGrid = 1;
+  b.gridExtent = extent;
+}
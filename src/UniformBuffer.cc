@@ -0,0 +1,47 @@
+#include <cstring>
+#include <iostream>
+#include "UniformBuffer.hh"
+
+void UniformBuffer::init() {
+  glGenBuffers(1, &ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferData(GL_UNIFORM_BUFFER, uploaded.size(), nullptr, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  hasData = false;
+}
+
+void UniformBuffer::attach(GLuint program) const {
+  GLuint index = glGetUniformBlockIndex(program, blockName);
+  if (index == GL_INVALID_INDEX) {
+    std::cout << "Error: uniform block " << blockName << " not found in shader\n";
+    return;
+  }
+
+  GLint blockSize = 0;
+  glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+  if ((size_t) blockSize > uploaded.size())
+    std::cout << "Error: uniform block " << blockName << " is " << blockSize
+              << " bytes in the shader but " << uploaded.size() << " on the host\n";
+
+  glUniformBlockBinding(program, index, binding);
+}
+
+bool UniformBuffer::update(const void *data, size_t size) {
+  if (size != uploaded.size()) {
+    std::cout << "Error: wrong size for uniform block " << blockName << "\n";
+    return false;
+  }
+
+  if (hasData && std::memcmp(uploaded.data(), data, size) == 0)
+    return false;
+
+  std::memcpy(uploaded.data(), data, size);
+  hasData = true;
+  uploads++;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  return true;
+}
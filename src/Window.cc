@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <iostream>
+#include <thread>
 #include <imgui_impl_glfw_gl3.hh>
 #include <imgui.h>
 #include "Window.hh"
@@ -34,7 +35,15 @@ bool Window::init(FrameBufferSizeCallback resizeCallback,
     return false;
   }
 
+  // For compiling shaders off the render thread, same hints as the window
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  compileContext = glfwCreateWindow(1, 1, "Mandelbulb shader compiles", nullptr, window);
+  glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+  if (!compileContext)
+    std::cout << "Error: glfw failed to create the shader compile context\n";
+
   ImGui_ImplGlfwGL3_Init(window, true);
+  ImGui_ImplGlfwGL3_PollInput();
 
   glfwMakeContextCurrent(window);
   glfwSetFramebufferSizeCallback(window, resizeCallback);
@@ -44,19 +53,72 @@ bool Window::init(FrameBufferSizeCallback resizeCallback,
 }
 
 void Window::display() {
+  glfwMakeContextCurrent(nullptr);
+  std::thread renderThread(&Window::renderLoop, this);
+
+  const double tick = 1.0 / INPUT_HZ;
+  double nextTick = glfwGetTime();
+  while (!glfwWindowShouldClose(window)) {
+    double wait = nextTick - glfwGetTime();
+    double pollStart = profiler.nowUS();
+    if (wait > 0.0)
+      glfwWaitEventsTimeout(wait);
+    else
+      glfwPollEvents();
+    ImGui_ImplGlfwGL3_PollInput();
+    profiler.addMainThreadTime(PROFILE_POLL_EVENTS, pollStart);
+
+    // Dragging the window blocks event processing, that time is skipped rather than replayed
+    double now = glfwGetTime();
+    if (now - nextTick > MAX_CATCH_UP_TICKS * tick)
+      nextTick = now;
+    double inputStart = profiler.nowUS();
+    while (nextTick <= now) {
+      inputFunc(window);
+      nextTick += tick;
+    }
+    profiler.addMainThreadTime(PROFILE_INPUT, inputStart);
+  }
+
+  renderThread.join();
+  if (compileContext)
+    glfwDestroyWindow(compileContext);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+}
+
+void Window::renderLoop() {
+  glfwMakeContextCurrent(window);
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+    profiler.beginFrame();
+
+    // Waits here, before display() takes the newest input
+    profiler.beginCpu(PROFILE_PACING);
+    pacing.beginFrame();
+    profiler.endCpu(PROFILE_PACING);
+
     ImGui_ImplGlfwGL3_NewFrame();
-    inputFunc(window);
 
+    profiler.beginCpu(PROFILE_DISPLAY);
     displayFunc();
+    profiler.endCpu(PROFILE_DISPLAY);
 
+    profiler.beginGpu(PROFILE_GPU_IMGUI);
     ImGui::Render();
+    profiler.endGpu();
+
+    profiler.beginCpu(PROFILE_SWAP);
+    profiler.beginGpu(PROFILE_GPU_SWAP);
     glfwSwapBuffers(window);
-  }
+    profiler.endGpu();
+    profiler.endCpu(PROFILE_SWAP);
+    pacing.endFrame();
 
-  glfwDestroyWindow(window);
-  glfwTerminate();
+    profiler.endFrame();
+  }
+  if (shutdownFunc)
+    shutdownFunc();
+  glfwMakeContextCurrent(nullptr);
 }
 
 void Window::onClose(GLFWwindow *win) {
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include "Benchmark.hh"
+#include "DistanceEstimator.hh"
+
+namespace {
+
+// Once around the vertical axis, looking at the center from a little above
+const char *ORBIT_PATH =
+    "keyframe 0\n eye 0 0.8 3\n"
+    "keyframe 30\n eye 2.12132 0.8 2.12132\n"
+    "keyframe 60\n eye 3 0.8 0\n"
+    "keyframe 90\n eye 2.12132 0.8 -2.12132\n"
+    "keyframe 120\n eye 0 0.8 -3\n"
+    "keyframe 150\n eye -2.12132 0.8 -2.12132\n"
+    "keyframe 180\n eye -3 0.8 0\n"
+    "keyframe 210\n eye -2.12132 0.8 2.12132\n"
+    "keyframe 239\n eye 0 0.8 3\n";
+
+// Free mode, skimming close to the surface and looking past the center
+const char *FLYTHROUGH_PATH =
+    "keyframe 0\n eye 0 0.4 3.2\n center 0 0 0\n"
+    "keyframe 60\n eye 1.4 0.9 1.8\n center 0.2 0.1 0\n"
+    "keyframe 120\n eye 1.6 -0.2 0.2\n center 0.3 0 -0.6\n"
+    "keyframe 180\n eye 0.6 -1.3 -1.2\n center 0 -0.2 -0.3\n"
+    "keyframe 240\n eye -1.2 -0.4 -1.5\n center -0.3 0 0\n"
+    "keyframe 299\n eye -2.2 0.8 0.6\n center 0 0 0\n";
+
+// Frames in each path, one past its last keyframe
+const unsigned int ORBIT_FRAMES = 240;
+const unsigned int FLYTHROUGH_FRAMES = 300;
+const unsigned int DEEP_ZOOM_FRAMES = 240;
+const double DEEP_ZOOM_DEPTH = 1e-6; // Distance to the surface at the end, relative to the start
+
+const std::vector<std::string> PRESETS = {"mandelbulb", "julia", "mandelbox", "tetra", "bulb-folds", "bulb-tetra"};
+const std::vector<std::string> PATHS = {"orbit", "deep-zoom", "flythrough"};
+
+/**
+ * Names from a comma separated list, all of them for "all"
+ */
+bool selectNames(const std::string &list, const std::vector<std::string> &known, const char *kind,
+                 std::vector<std::string> &selected) {
+  if (list == "all") {
+    selected = known;
+    return true;
+  }
+
+  std::istringstream names(list);
+  std::string name;
+  while (std::getline(names, name, ',')) {
+    if (std::find(known.begin(), known.end(), name) == known.end()) {
+      std::cerr << "Unknown benchmark " << kind << " " << name << "\n";
+      return false;
+    }
+    selected.push_back(name);
+  }
+  return !selected.empty();
+}
+
+std::string jsonString(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out + "\"";
+}
+
+double mean(const std::vector<double> &values) {
+  double sum = 0.0;
+  for (double v : values)
+    sum += v;
+  return values.empty() ? 0.0 : sum / values.size();
+}
+
+}
+
+double percentile(std::vector<double> values, double p) {
+  if (values.empty())
+    return 0.0;
+  std::sort(values.begin(), values.end());
+  auto rank = (size_t) std::ceil(p / 100.0 * values.size());
+  return values[std::min(std::max(rank, (size_t) 1), values.size()) - 1];
+}
+
+const std::vector<std::string> &BenchmarkSuite::presetNames() {
+  return PRESETS;
+}
+
+const std::vector<std::string> &BenchmarkSuite::pathNames() {
+  return PATHS;
+}
+
+bool BenchmarkSuite::applyPreset(const std::string &name, FractalUniforms &u, AppState &state) {
+  if (std::find(PRESETS.begin(), PRESETS.end(), name) == PRESETS.end())
+    return false;
+
+  // The beat is the only thing u_time moves, pinned or not
+  u.sphereMinTimeVariance = false;
+  u.julia = name == "julia";
+  state.mandelbulbOn = name != "mandelbox" && name != "tetra";
+  state.boxFoldingOn = name == "bulb-folds";
+  state.sphereFoldingOn = name == "bulb-folds";
+  state.mandelBoxOn = name == "mandelbox";
+  state.recursiveTetraOn = name == "tetra" || name == "bulb-tetra";
+  state.deepZoom = false;
+  return true;
+}
+
+unsigned int BenchmarkSuite::pathLength(const std::string &path) {
+  if (path == "deep-zoom")
+    return DEEP_ZOOM_FRAMES;
+  return path == "orbit" ? ORBIT_FRAMES : FLYTHROUGH_FRAMES;
+}
+
+bool BenchmarkSuite::init(const std::string &presets, const std::string &paths, const FractalUniforms &u,
+                          const AppState &state, float pinnedTime) {
+  std::vector<std::string> selectedPresets, selectedPaths;
+  if (!selectNames(presets, PRESETS, "preset", selectedPresets) || !selectNames(paths, PATHS, "path", selectedPaths))
+    return false;
+
+  runs.clear();
+  for (const std::string &preset : selectedPresets) {
+    for (const std::string &path : selectedPaths) {
+      BenchmarkRun run;
+      run.preset = preset;
+      run.path = path;
+      runs.push_back(run);
+    }
+  }
+
+  baseU = u;
+  baseState = state;
+  time = pinnedTime;
+  runIndex = 0;
+  startRun();
+  return true;
+}
+
+void BenchmarkSuite::startRun() {
+  const BenchmarkRun &run = runs[runIndex];
+  FractalUniforms u = baseU;
+  AppState state = baseState;
+  applyPreset(run.preset, u, state);
+
+  phase = WARM_UP;
+  frameIndex = 0;
+  warmUpLeft = WARM_UP_FRAMES;
+
+  if (run.path == "deep-zoom") {
+    state.deepZoom = true;
+    u.updateMinDistance();
+    deepZoomBase = Keyframe();
+    deepZoomBase.u = u;
+    deepZoomBase.state = state;
+
+    // March toward the center from the start in double, the target is where the ray lands
+    dvec3 start(0.35, 0.55, 2.6);
+    deepZoomDirection = glm::normalize(-start);
+    DistanceEstimator de(u, state, time);
+    double t = 0.0;
+    for (int i = 0; i < 4000 && t < 10.0; i++) {
+      double d = de.estimate(start + t * deepZoomDirection);
+      if (d < 1e-9)
+        break;
+      t += d;
+    }
+    if (t >= 10.0)
+      t = glm::length(start); // Missed, zoom in on the center instead
+    deepZoomTarget = start + t * deepZoomDirection;
+    deepZoomDistance = t;
+    return;
+  }
+
+  std::istringstream text(run.path == "orbit" ? ORBIT_PATH : FLYTHROUGH_PATH);
+  track.parse(text, run.path, u, state);
+}
+
+Keyframe BenchmarkSuite::frame() const {
+  Keyframe key;
+  if (runs[runIndex].path == "deep-zoom") {
+    // Same zoom factor every frame, like holding Z in deep zoom
+    key = deepZoomBase;
+    double f = (double) frameIndex / (DEEP_ZOOM_FRAMES - 1);
+    key.eye = deepZoomTarget - deepZoomDirection * (deepZoomDistance * std::pow(DEEP_ZOOM_DEPTH, f));
+    key.center = deepZoomTarget;
+    key.up = dvec3(0.0, 1.0, 0.0);
+  } else {
+    key = track.at(frameIndex);
+  }
+  key.frame = frameIndex;
+  key.time = time;
+  return key;
+}
+
+void BenchmarkSuite::finishFrame(double ms, double deCalls, bool ready) {
+  if (phase == DONE)
+    return;
+
+  BenchmarkRun &run = runs[runIndex];
+  unsigned int length = pathLength(run.path);
+  switch (phase) {
+    case WARM_UP:
+      if (warmUpLeft > 0)
+        warmUpLeft--;
+      if (warmUpLeft == 0 && ready)
+        phase = TIMING;
+      break;
+    case TIMING:
+      run.frameMS.push_back(ms);
+      if (++frameIndex == length) {
+        phase = COUNTING;
+        frameIndex = 0;
+      }
+      break;
+    case COUNTING:
+      run.deCalls.push_back(deCalls);
+      if (++frameIndex == length) {
+        if (++runIndex == runs.size())
+          phase = DONE;
+        else
+          startRun();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+std::string BenchmarkSuite::status() const {
+  if (phase == DONE)
+    return "done";
+
+  const BenchmarkRun &run = runs[runIndex];
+  const char *phaseName = phase == WARM_UP ? "warm-up" : phase == TIMING ? "timing" : "counting";
+  char text[128];
+  snprintf(text, sizeof(text), "%s/%s %s %u/%u (run %zu of %zu)", run.preset.c_str(), run.path.c_str(), phaseName,
+           frameIndex, pathLength(run.path), runIndex + 1, runs.size());
+  return text;
+}
+
+bool BenchmarkSuite::write(const std::string &fileName, const std::string &renderer, unsigned int width,
+                           unsigned int height) const {
+  FILE *file = fopen(fileName.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "Failed to open %s for writing.\n", fileName.c_str());
+    return false;
+  }
+
+  bool csv = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0;
+  if (csv) {
+    fprintf(file, "preset,path,frames,width,height,time,mean_ms,p50_ms,p95_ms,p99_ms,"
+                  "mean_de_calls,p50_de_calls,p95_de_calls,p99_de_calls\n");
+  } else {
+    fprintf(file, "{\n  \"renderer\": %s,\n  \"width\": %u,\n  \"height\": %u,\n  \"time\": %g,\n  \"runs\": [",
+            jsonString(renderer).c_str(), width, height, time);
+  }
+
+  for (size_t i = 0; i < runs.size(); i++) {
+    const BenchmarkRun &run = runs[i];
+    const std::vector<double> &ms = run.frameMS, &de = run.deCalls;
+    if (csv) {
+      fprintf(file, "%s,%s,%zu,%u,%u,%g,%.4f,%.4f,%.4f,%.4f,%.0f,%.0f,%.0f,%.0f\n", run.preset.c_str(),
+              run.path.c_str(), ms.size(), width, height, time, mean(ms), percentile(ms, 50), percentile(ms, 95),
+              percentile(ms, 99), mean(de), percentile(de, 50), percentile(de, 95), percentile(de, 99));
+      continue;
+    }
+    fprintf(file, "%s\n    {\"preset\": %s, \"path\": %s, \"frames\": %zu,\n", i ? "," : "",
+            jsonString(run.preset).c_str(), jsonString(run.path).c_str(), ms.size());
+    fprintf(file, "     \"frameMS\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f},\n",
+            mean(ms), percentile(ms, 50), percentile(ms, 95), percentile(ms, 99));
+    fprintf(file, "     \"deCallsPerFrame\": {\"mean\": %.0f, \"p50\": %.0f, \"p95\": %.0f, \"p99\": %.0f}}",
+            mean(de), percentile(de, 50), percentile(de, 95), percentile(de, 99));
+  }
+  if (!csv)
+    fprintf(file, "\n  ]\n}\n");
+
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+void BenchmarkSuite::printSummary() const {
+  printf("%-12s %-11s %9s %9s %9s %14s\n", "preset", "path", "p50 ms", "p95 ms", "p99 ms", "DE calls/frame");
+  for (const BenchmarkRun &run : runs) {
+    printf("%-12s %-11s %9.3f %9.3f %9.3f %14.0f\n", run.preset.c_str(), run.path.c_str(),
+           percentile(run.frameMS, 50), percentile(run.frameMS, 95), percentile(run.frameMS, 99), mean(run.deCalls));
+  }
+  fflush(stdout);
+}
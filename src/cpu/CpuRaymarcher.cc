@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <cmath>
+#include "CpuRaymarcher.hh"
+#include "NoiseVolume.hh"
+#include "SimplexNoise.hh"
+
+#define LOW_P_ZERO 0.00001f
+
+namespace {
+
+const vec2 quadCorners[4] = {
+    {-1.0f, -1.0f},
+    {1.0f, -1.0f},
+    {-1.0f, 1.0f},
+    {1.0f, 1.0f}
+};
+
+float fract(float x) {
+  return x - std::floor(x);
+}
+
+}
+
+CpuRaymarcher::CpuRaymarcher(const FractalUniforms &uniforms, const AppState &state, const RenderView &view)
+    : de(uniforms, state, view.time), u(uniforms), view(view), simdLevel(bestSimdLevel()), deepZoom(state.deepZoom) {
+
+  // Same as mandel_raymarch.vert, including its swapped near/far planes
+  for (int i = 0; i < 4; i++) {
+    dvec4 farPlane = view.inverseVP * dvec4(quadCorners[i].x, quadCorners[i].y, view.nearPlane, 1.0);
+    dvec4 nearPlane = view.inverseVP * dvec4(quadCorners[i].x, quadCorners[i].y, view.farPlane, 1.0);
+
+    farPlane /= farPlane.w;
+    nearPlane /= nearPlane.w;
+
+    cornerOrigin[i] = dvec3(nearPlane);
+    cornerDirection[i] = dvec3(farPlane) - dvec3(nearPlane);
+  }
+
+  // The shader's dFdx of the ray direction, taken at the center of the view
+  dvec3 center = 0.5 * (cornerDirection[0] + cornerDirection[3]);
+  pixelAngle = (float) (glm::length(cornerDirection[1] - cornerDirection[0]) / view.width / glm::length(center));
+
+  if (deepZoom)
+    u.minDistance = de.deepMinDistance(view.eyePos, pixelAngle);
+}
+
+template<typename V>
+void CpuRaymarcher::interpolateRay(vec2 fragCoord, V &origin, V &direction) const {
+  typedef decltype(V().x) T;
+  T s = T(fragCoord.x) / T(view.width);
+  T t = T(fragCoord.y) / T(view.height);
+  V o[4], d[4];
+  for (int i = 0; i < 4; i++) {
+    o[i] = V(cornerOrigin[i]);
+    d[i] = V(cornerDirection[i]);
+  }
+
+  // Triangle strip: (0, 1, 2) below the diagonal, (1, 2, 3) above it
+  if (s + t <= T(1)) {
+    origin = o[0] + s * (o[1] - o[0]) + t * (o[2] - o[0]);
+    direction = d[0] + s * (d[1] - d[0]) + t * (d[2] - d[0]);
+  } else {
+    origin = o[3] + (T(1) - s) * (o[2] - o[3]) + (T(1) - t) * (o[1] - o[3]);
+    direction = d[3] + (T(1) - s) * (d[2] - d[3]) + (T(1) - t) * (d[1] - d[3]);
+  }
+}
+
+void CpuRaymarcher::primaryRay(vec2 fragCoord, vec3 &origin, vec3 &direction) const {
+  interpolateRay(fragCoord, origin, direction);
+}
+
+void CpuRaymarcher::primaryRay(vec2 fragCoord, dvec3 &origin, dvec3 &direction) const {
+  interpolateRay(fragCoord, origin, direction);
+}
+
+template<typename V>
+float CpuRaymarcher::simpleMarch(V from, V dir, int &stepsTaken, V &pos, vec4 &orbitTrap) const {
+  typedef decltype(V().x) T;
+  T totalDistance = T(0);
+  int steps;
+  V p = from;
+
+  for (steps = 0; steps < u.maxRaySteps; steps++) {
+    p = from + totalDistance * dir;
+    T distance = de.estimate(p, orbitTrap);
+    totalDistance += distance;
+
+    if (distance < u.minDistance)
+      break;
+  }
+
+  stepsTaken = steps;
+  pos = p;
+  return 1.0f - float(steps) / u.maxRaySteps;
+}
+
+template<typename V>
+decltype(V().x) CpuRaymarcher::normalEpsilon(V pos) const {
+  typedef decltype(V().x) T;
+  return glm::max(T(pixelAngle) * glm::length(pos - V(view.eyePos)), T(u.minDistance));
+}
+
+template<typename V>
+vec3 CpuRaymarcher::calcNormal(V pos) const {
+  typedef decltype(V().x) T;
+
+  // The analytic normal is float only, deep zoom takes the tetrahedron like the shader
+  if (u.normalMode == 2 && !deepZoom)
+    return de.analyticNormal(vec3(pos));
+
+  T e = normalEpsilon(pos);
+  if (u.normalMode != 0) {
+    const V a = V(1, -1, -1), b = V(-1, -1, 1), c = V(-1, 1, -1), d = V(1, 1, 1);
+    return vec3(glm::normalize(a * de.estimate(pos + a * e) + b * de.estimate(pos + b * e)
+                               + c * de.estimate(pos + c * e) + d * de.estimate(pos + d * e)));
+  }
+
+  return vec3(glm::normalize(V(
+      de.estimate(pos + V(e, 0, 0)) - de.estimate(pos - V(e, 0, 0)),
+      de.estimate(pos + V(0, e, 0)) - de.estimate(pos - V(0, e, 0)),
+      de.estimate(pos + V(0, 0, e)) - de.estimate(pos - V(0, 0, e))
+  )));
+}
+
+template<typename V>
+vec3 CpuRaymarcher::calculateBlinnPhong(vec3 diffColor, V p) const {
+  vec3 ambientColor = diffColor * 0.8f;
+  const vec3 lightColor = vec3(1.0f);
+  const vec3 specColor = vec3(1.0f);
+  const float screenGamma = 2.2f;
+
+  vec3 normal = calcNormal(p);
+
+  vec3 eyeVec = glm::normalize(vec3(V(view.eyePos) - p));
+  vec3 lightVec = glm::normalize(u.lightPos - vec3(p));
+  vec3 H = glm::normalize(lightVec + eyeVec);
+
+  float lightPower = 0.4f;
+
+  float lambertian = glm::max(glm::dot(lightVec, normal), 0.0f);
+  float specular = glm::max(glm::dot(H, normal), 0.0f);
+  specular = std::pow(specular, u.shininess);
+
+  vec3 BPColor = u.ambientIntensity * ambientColor +
+      u.diffuseIntensity * diffColor * lambertian * lightColor * lightPower +
+      u.specularIntensity * specColor * specular * lightColor * lightPower;
+
+  // pow() of a negative channel is NaN here, so only take it when it is mixed in
+  if (!u.gammaCorrection)
+    return BPColor;
+  return glm::pow(BPColor, vec3(1.0f / screenGamma));
+}
+
+template<typename V>
+float CpuRaymarcher::softShadow(V from, decltype(V().x) startDistance) const {
+  typedef decltype(V().x) T;
+  const int maxSteps = 64;
+  V toLight = V(u.lightPos) - from;
+  T lightDistance = glm::length(toLight);
+  V dir = toLight / lightDistance;
+
+  float light = 1.0f;
+  T totalDistance = startDistance;
+  for (int steps = 0; steps < maxSteps && totalDistance < lightDistance; steps++) {
+    T distance = de.estimate(from + totalDistance * dir);
+
+    if (steps > u.shadowRayMinStepsTaken) {
+      light = glm::min(light, u.shadowSharpness * float(distance / totalDistance));
+      if (light < 0.01f)
+        return 0.0f;
+    }
+    totalDistance += glm::max(distance, T(u.minDistance));
+  }
+
+  return glm::smoothstep(0.0f, 1.0f, light);
+}
+
+vec3 CpuRaymarcher::getColorFromOrbitTrap(vec4 orbitTrap) const {
+  float paletteCycleDist = u.otDist0to1 + u.otDist1to2 + u.otDist2to3 + u.otDist3to0;
+  float dist01 = u.otDist0to1 / paletteCycleDist;
+  float dist12 = u.otDist1to2 / paletteCycleDist;
+  float dist23 = u.otDist2to3 / paletteCycleDist;
+  float dist30 = u.otDist3to0 / paletteCycleDist;
+  float cycleIntensity = u.otCycleIntensity * 0.1f;
+  float pOffset = u.otPaletteOffset / 100.0f;
+  float baseMix = glm::smoothstep(0.0f, 1.0f, u.otBaseStrength);
+  vec3 colorMix;
+
+  float orbitTot = glm::dot(u.orbitStrength, orbitTrap);
+  orbitTot = fract(std::abs(orbitTot) * cycleIntensity);
+  orbitTot = fract(orbitTot + pOffset);
+
+  if (orbitTot <= dist01) {
+    colorMix = glm::mix(u.otColor0, u.otColor1, glm::smoothstep(0.1f, 1.0f, std::abs(orbitTot) / dist01));
+  } else if (orbitTot <= dist01 + dist12) {
+    colorMix = glm::mix(u.otColor1, u.otColor2, glm::smoothstep(0.1f, 1.0f, std::abs(orbitTot - dist01) / std::abs(dist12)));
+  } else if (orbitTot <= dist01 + dist12 + dist23) {
+    colorMix = glm::mix(u.otColor2, u.otColor3,
+                        glm::smoothstep(0.1f, 1.0f, std::abs(orbitTot - dist01 - dist12) / std::abs(dist23)));
+  } else {
+    colorMix = glm::mix(u.otColor3, u.otColor0,
+                        glm::smoothstep(0.1f, 1.0f, std::abs(orbitTot - dist01 - dist12 - dist23) / std::abs(dist30)));
+  }
+  colorMix = glm::mix(colorMix, u.otColorBase, baseMix);
+
+  return glm::clamp(colorMix, 0.0f, 1.0f);
+}
+
+void CpuRaymarcher::marchPacket(int count, const vec3 *origins, const vec3 *directions,
+                                MarchResult *results) const {
+  float x[DE_PACKET_MAX_WIDTH], y[DE_PACKET_MAX_WIDTH], z[DE_PACKET_MAX_WIDTH];
+  float distance[DE_PACKET_MAX_WIDTH];
+  float trap[4 * DE_PACKET_MAX_WIDTH];
+  float totalDistance[DE_PACKET_MAX_WIDTH];
+  bool active[DE_PACKET_MAX_WIDTH];
+
+  for (int l = 0; l < count; l++) {
+    totalDistance[l] = 0.0f;
+    active[l] = true;
+    results[l].stepsTaken = 0;
+    results[l].pos = origins[l];
+    for (int c = 0; c < 4; c++)
+      trap[c * count + l] = 10000.0f;
+  }
+
+  // Finished lanes keep re-evaluating their final position, which leaves
+  // their orbit trap unchanged since min() over the same orbit is idempotent
+  int remaining = count;
+  for (int steps = 0; steps < u.maxRaySteps && remaining > 0; steps++) {
+    for (int l = 0; l < count; l++) {
+      if (active[l])
+        results[l].pos = origins[l] + totalDistance[l] * directions[l];
+      x[l] = results[l].pos.x;
+      y[l] = results[l].pos.y;
+      z[l] = results[l].pos.z;
+    }
+
+    de.estimatePacket(simdLevel, (size_t) count, x, y, z, distance, trap);
+
+    for (int l = 0; l < count; l++) {
+      if (!active[l]) continue;
+
+      totalDistance[l] += distance[l];
+      results[l].stepsTaken = steps + 1;
+      if (distance[l] < u.minDistance) {
+        results[l].stepsTaken = steps;
+        active[l] = false;
+        remaining--;
+      }
+    }
+  }
+
+  for (int l = 0; l < count; l++) {
+    results[l].gsValue = 1.0f - float(results[l].stepsTaken) / u.maxRaySteps;
+    results[l].orbitTrap = vec4(trap[l], trap[count + l], trap[2 * count + l], trap[3 * count + l]);
+  }
+}
+
+template<typename V>
+vec3 CpuRaymarcher::shade(vec2 fragCoord, const MarchResult &march, V mandelPos) const {
+  typedef decltype(V().x) T;
+  vec2 uv = vec2(fragCoord.x / (float) view.width, fragCoord.y / (float) view.height);
+  vec3 noisePos = vec3(mandelPos);
+  float gsValue = march.gsValue;
+
+  // Ray miss completely; bg plane color
+  if (gsValue < LOW_P_ZERO)
+    return u.showBgGradient ? glm::mix(u.bgColor, u.bgColor * 0.8f, uv.y) : u.bgColor;
+
+  // Ray hit
+  float noise;
+  if (u.noiseTexture) {
+    const NoiseVolume &volume = NoiseVolume::shared();
+    noise = volume.sample(5.0f * noisePos) + 0.5f * volume.sample(10.0f * noisePos);
+  } else {
+    noise = snoise(5.0f * noisePos) + 0.5f * snoise(10.0f * noisePos);
+  }
+  noise = 0.1f * u.noiseFactor * noise;
+
+  vec3 color = getColorFromOrbitTrap(march.orbitTrap) - noise;
+
+  // Mix in blinn-phong shading
+  if (u.lightSource)
+    color = glm::mix(color, calculateBlinnPhong(color, mandelPos), u.phongShadingMixFactor);
+
+  // Mix in glow
+  color = glm::mix(u.glowFactor * u.glowColor, color, glm::smoothstep(0.0f, 0.7f, gsValue));
+
+  // Soft shadows, the explorer's shadow pass marches the same rays at a lower resolution
+  if (u.lightSource)
+    color *= glm::mix(1.0f, u.shadowBrightness, 1.0f - softShadow(mandelPos, T(2) * normalEpsilon(mandelPos)));
+
+  return glm::clamp(color, 0.0f, 1.0f);
+}
+
+vec3 CpuRaymarcher::shadeMarch(vec2 fragCoord, const MarchResult &march) const {
+  return shade(fragCoord, march, march.pos);
+}
+
+template<typename V>
+vec3 CpuRaymarcher::marchFragment(vec2 fragCoord) const {
+  V rayOrigin, rayDirection, pos;
+  interpolateRay(fragCoord, rayOrigin, rayDirection);
+
+  MarchResult march;
+  march.orbitTrap = vec4(10000.0f);
+  march.gsValue = simpleMarch(rayOrigin, rayDirection, march.stepsTaken, pos, march.orbitTrap);
+  march.pos = vec3(pos);
+  return shade(fragCoord, march, pos);
+}
+
+vec3 CpuRaymarcher::shadeFragment(vec2 fragCoord) const {
+  if (deepZoom)
+    return marchFragment<dvec3>(fragCoord);
+  return marchFragment<vec3>(fragCoord);
+}
+
+void CpuRaymarcher::renderTile(Image &image, const Tile &tile, unsigned int originX, unsigned int originY) const {
+  int width = packetMarch && !deepZoom ? simdWidth(simdLevel) : 1;
+
+  for (unsigned int y = tile.y0; y < tile.y1; y++) {
+
+    // Image rows go top down, gl_FragCoord bottom up
+    float fragY = (float) (view.height - 1 - y) + 0.5f;
+
+    if (!packetMarch || deepZoom) {
+      for (unsigned int x = tile.x0; x < tile.x1; x++)
+        image.setPixel(x - originX, y - originY, shadeFragment(vec2((float) x + 0.5f, fragY)));
+      continue;
+    }
+
+    // Neighbouring pixels of a row share a packet
+    for (unsigned int x0 = tile.x0; x0 < tile.x1; x0 += width) {
+      int count = (int) std::min<unsigned int>((unsigned int) width, tile.x1 - x0);
+      vec3 origins[DE_PACKET_MAX_WIDTH], directions[DE_PACKET_MAX_WIDTH];
+      MarchResult results[DE_PACKET_MAX_WIDTH];
+
+      for (int l = 0; l < count; l++)
+        primaryRay(vec2((float) (x0 + l) + 0.5f, fragY), origins[l], directions[l]);
+
+      marchPacket(count, origins, directions, results);
+
+      for (int l = 0; l < count; l++) {
+        vec2 fragCoord = vec2((float) (x0 + l) + 0.5f, fragY);
+        image.setPixel(x0 + l - originX, y - originY, shadeMarch(fragCoord, results[l]));
+      }
+    }
+  }
+}
+
+void CpuRaymarcher::render(Image &image, ThreadPool &pool, unsigned int tileSize) const {
+  if (image.width != view.width || image.height != view.height)
+    image = Image(view.width, view.height);
+
+  for (unsigned int y = 0; y < view.height; y += tileSize) {
+    for (unsigned int x = 0; x < view.width; x += tileSize) {
+      Tile tile = {x, y, std::min(x + tileSize, view.width), std::min(y + tileSize, view.height)};
+      pool.submit([this, &image, tile] { renderTile(image, tile); });
+    }
+  }
+
+  pool.wait();
+}
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstring>
+#include "DEPacketKernel.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DE_PACKET_X86
+void estimatePacketSSE41(const DEParams &p, const float *x, const float *y, const float *z,
+                         float *distance, float *orbitTrap);
+void estimatePacketAVX2(const DEParams &p, const float *x, const float *y, const float *z,
+                        float *distance, float *orbitTrap);
+void estimatePacketAVX512(const DEParams &p, const float *x, const float *y, const float *z,
+                          float *distance, float *orbitTrap);
+#endif
+
+namespace {
+
+// One lane, the fallback for CPUs (or architectures) without the vector units
+struct VecScalar {
+  typedef bool Mask;
+  static const int width = 1;
+
+  float v;
+
+  VecScalar() = default;
+  VecScalar(float s) : v(s) {};
+
+  static VecScalar load(const float *p) { return *p; }
+  void store(float *p) const { *p = v; }
+
+  friend VecScalar operator+(VecScalar a, VecScalar b) { return a.v + b.v; }
+  friend VecScalar operator-(VecScalar a, VecScalar b) { return a.v - b.v; }
+  friend VecScalar operator*(VecScalar a, VecScalar b) { return a.v * b.v; }
+  friend VecScalar operator/(VecScalar a, VecScalar b) { return a.v / b.v; }
+
+  static VecScalar sqrt(VecScalar a) { return std::sqrt(a.v); }
+  static VecScalar floor(VecScalar a) { return std::floor(a.v); }
+  static VecScalar min(VecScalar a, VecScalar b) { return std::min(a.v, b.v); }
+  static VecScalar max(VecScalar a, VecScalar b) { return std::max(a.v, b.v); }
+  static VecScalar abs(VecScalar a) { return std::abs(a.v); }
+
+  static Mask lt(VecScalar a, VecScalar b) { return a.v < b.v; }
+  static Mask le(VecScalar a, VecScalar b) { return a.v <= b.v; }
+  static Mask gt(VecScalar a, VecScalar b) { return a.v > b.v; }
+  static Mask andMask(Mask a, Mask b) { return a && b; }
+  static Mask orMask(Mask a, Mask b) { return a || b; }
+  static bool any(Mask m) { return m; }
+  static VecScalar select(Mask m, VecScalar a, VecScalar b) { return m ? a : b; }
+
+  static VecScalar exp2i(VecScalar n) { return std::ldexp(1.0f, (int) n.v); }
+
+  static void frexp(VecScalar x, VecScalar &mantissa, VecScalar &exponent) {
+    int e;
+    mantissa = 2.0f * std::frexp(x.v, &e);
+    exponent = (float) (e - 1);
+  }
+};
+
+void estimatePacketScalar(const DEParams &p, const float *x, const float *y, const float *z,
+                          float *distance, float *orbitTrap) {
+  packet::estimate<VecScalar>(p, x, y, z, distance, orbitTrap);
+}
+
+DEPacketKernel kernelFor(SimdLevel level) {
+  switch (level) {
+#ifdef DE_PACKET_X86
+    case SimdLevel::SSE41: return estimatePacketSSE41;
+    case SimdLevel::AVX2: return estimatePacketAVX2;
+    case SimdLevel::AVX512: return estimatePacketAVX512;
+#endif
+    default: return estimatePacketScalar;
+  }
+}
+
+}
+
+int simdWidth(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::SSE41: return 4;
+    case SimdLevel::AVX2: return 8;
+    case SimdLevel::AVX512: return 16;
+    default: return 1;
+  }
+}
+
+const char *simdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::SSE41: return "sse4.1";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    default: return "scalar";
+  }
+}
+
+bool parseSimdLevel(const char *name, SimdLevel &level) {
+  const SimdLevel all[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512};
+  for (SimdLevel candidate : all) {
+    if (std::strcmp(name, simdLevelName(candidate)) == 0) {
+      level = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool simdLevelSupported(SimdLevel level) {
+#ifdef DE_PACKET_X86
+  switch (level) {
+    case SimdLevel::SSE41: return __builtin_cpu_supports("sse4.1");
+    case SimdLevel::AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case SimdLevel::AVX512: return __builtin_cpu_supports("avx512f");
+    default: return true;
+  }
+#else
+  return level == SimdLevel::Scalar;
+#endif
+}
+
+SimdLevel bestSimdLevel() {
+  static const SimdLevel best = [] {
+    const SimdLevel order[] = {SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE41};
+    for (SimdLevel level : order)
+      if (simdLevelSupported(level))
+        return level;
+    return SimdLevel::Scalar;
+  }();
+  return best;
+}
+
+void estimatePacket(SimdLevel level, const DEParams &p, size_t count,
+                    const float *x, const float *y, const float *z,
+                    float *distance, float *orbitTrap) {
+  DEPacketKernel kernel = kernelFor(level);
+  auto width = (size_t) simdWidth(level);
+
+  // Kernels read whole packets, so copy every packet into padded lanes.
+  // The tail repeats its last position rather than feeding garbage to the math.
+  float lanes[4][DE_PACKET_MAX_WIDTH];
+  float trap[4 * DE_PACKET_MAX_WIDTH];
+  float out[DE_PACKET_MAX_WIDTH];
+
+  for (size_t start = 0; start < count; start += width) {
+    size_t n = std::min(width, count - start);
+
+    // Whole packets whose trap layout already matches go straight through
+    if (n == width && (!orbitTrap || count == width)) {
+      kernel(p, x + start, y + start, z + start, distance + start, orbitTrap);
+      continue;
+    }
+
+    for (size_t l = 0; l < width; l++) {
+      size_t src = start + std::min(l, n - 1);
+      lanes[0][l] = x[src];
+      lanes[1][l] = y[src];
+      lanes[2][l] = z[src];
+      if (orbitTrap)
+        for (int c = 0; c < 4; c++)
+          trap[c * width + l] = orbitTrap[c * count + src];
+    }
+
+    kernel(p, lanes[0], lanes[1], lanes[2], out, orbitTrap ? trap : nullptr);
+
+    std::memcpy(distance + start, out, n * sizeof(float));
+    if (orbitTrap)
+      for (int c = 0; c < 4; c++)
+        std::memcpy(orbitTrap + c * count + start, trap + c * width, n * sizeof(float));
+  }
+}
@@ -0,0 +1,62 @@
+// Compiled with -mavx2 -mfma, only called after a runtime CPU check
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include "DEPacketKernel.hh"
+
+namespace {
+
+struct VecAVX2 {
+  typedef __m256 Mask;
+  static const int width = 8;
+
+  __m256 v;
+
+  VecAVX2() = default;
+  VecAVX2(__m256 v) : v(v) {};
+  VecAVX2(float s) : v(_mm256_set1_ps(s)) {};
+
+  static VecAVX2 load(const float *p) { return _mm256_loadu_ps(p); }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+  friend VecAVX2 operator+(VecAVX2 a, VecAVX2 b) { return _mm256_add_ps(a.v, b.v); }
+  friend VecAVX2 operator-(VecAVX2 a, VecAVX2 b) { return _mm256_sub_ps(a.v, b.v); }
+  friend VecAVX2 operator*(VecAVX2 a, VecAVX2 b) { return _mm256_mul_ps(a.v, b.v); }
+  friend VecAVX2 operator/(VecAVX2 a, VecAVX2 b) { return _mm256_div_ps(a.v, b.v); }
+
+  static VecAVX2 sqrt(VecAVX2 a) { return _mm256_sqrt_ps(a.v); }
+  static VecAVX2 floor(VecAVX2 a) { return _mm256_floor_ps(a.v); }
+  static VecAVX2 min(VecAVX2 a, VecAVX2 b) { return _mm256_min_ps(a.v, b.v); }
+  static VecAVX2 max(VecAVX2 a, VecAVX2 b) { return _mm256_max_ps(a.v, b.v); }
+  static VecAVX2 abs(VecAVX2 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+
+  static Mask lt(VecAVX2 a, VecAVX2 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+  static Mask le(VecAVX2 a, VecAVX2 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+  static Mask gt(VecAVX2 a, VecAVX2 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+  static Mask andMask(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+  static Mask orMask(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+  static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+  static VecAVX2 select(Mask m, VecAVX2 a, VecAVX2 b) { return _mm256_blendv_ps(b.v, a.v, m); }
+
+  static VecAVX2 exp2i(VecAVX2 n) {
+    __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(e, 23));
+  }
+
+  static void frexp(VecAVX2 x, VecAVX2 &mantissa, VecAVX2 &exponent) {
+    __m256i bits = _mm256_castps_si256(x.v);
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    __m256i m = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000));
+    exponent = _mm256_cvtepi32_ps(e);
+    mantissa = _mm256_castsi256_ps(m);
+  }
+};
+
+}
+
+void estimatePacketAVX2(const DEParams &p, const float *x, const float *y, const float *z,
+                        float *distance, float *orbitTrap) {
+  packet::estimate<VecAVX2>(p, x, y, z, distance, orbitTrap);
+}
+
+#endif
@@ -0,0 +1,69 @@
+// Compiled with -mavx512f, only called after a runtime CPU check
+#if defined(__x86_64__) || defined(__i386__)
+
+// GCC 12 flags the _mm512_undefined_ps() pass-through operand inside its own intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#include "DEPacketKernel.hh"
+
+namespace {
+
+struct VecAVX512 {
+  typedef __mmask16 Mask;
+  static const int width = 16;
+
+  __m512 v;
+
+  VecAVX512() = default;
+  VecAVX512(__m512 v) : v(v) {};
+  VecAVX512(float s) : v(_mm512_set1_ps(s)) {};
+
+  static VecAVX512 load(const float *p) { return _mm512_loadu_ps(p); }
+  void store(float *p) const { _mm512_storeu_ps(p, v); }
+
+  friend VecAVX512 operator+(VecAVX512 a, VecAVX512 b) { return _mm512_add_ps(a.v, b.v); }
+  friend VecAVX512 operator-(VecAVX512 a, VecAVX512 b) { return _mm512_sub_ps(a.v, b.v); }
+  friend VecAVX512 operator*(VecAVX512 a, VecAVX512 b) { return _mm512_mul_ps(a.v, b.v); }
+  friend VecAVX512 operator/(VecAVX512 a, VecAVX512 b) { return _mm512_div_ps(a.v, b.v); }
+
+  static VecAVX512 sqrt(VecAVX512 a) { return _mm512_sqrt_ps(a.v); }
+  static VecAVX512 floor(VecAVX512 a) { return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+  static VecAVX512 min(VecAVX512 a, VecAVX512 b) { return _mm512_min_ps(a.v, b.v); }
+  static VecAVX512 max(VecAVX512 a, VecAVX512 b) { return _mm512_max_ps(a.v, b.v); }
+  static VecAVX512 abs(VecAVX512 a) {
+    return _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7fffffff)));
+  }
+
+  static Mask lt(VecAVX512 a, VecAVX512 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+  static Mask le(VecAVX512 a, VecAVX512 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ); }
+  static Mask gt(VecAVX512 a, VecAVX512 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+  static Mask andMask(Mask a, Mask b) { return (Mask) (a & b); }
+  static Mask orMask(Mask a, Mask b) { return (Mask) (a | b); }
+  static bool any(Mask m) { return m != 0; }
+  static VecAVX512 select(Mask m, VecAVX512 a, VecAVX512 b) { return _mm512_mask_blend_ps(m, b.v, a.v); }
+
+  static VecAVX512 exp2i(VecAVX512 n) {
+    __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n.v), _mm512_set1_epi32(127));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(e, 23));
+  }
+
+  static void frexp(VecAVX512 x, VecAVX512 &mantissa, VecAVX512 &exponent) {
+    __m512i bits = _mm512_castps_si512(x.v);
+    __m512i e = _mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127));
+    __m512i m = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)), _mm512_set1_epi32(0x3f800000));
+    exponent = _mm512_cvtepi32_ps(e);
+    mantissa = _mm512_castsi512_ps(m);
+  }
+};
+
+}
+
+void estimatePacketAVX512(const DEParams &p, const float *x, const float *y, const float *z,
+                          float *distance, float *orbitTrap) {
+  packet::estimate<VecAVX512>(p, x, y, z, distance, orbitTrap);
+}
+
+#endif
@@ -0,0 +1,62 @@
+// Compiled with -msse4.1, only called after a runtime CPU check
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <smmintrin.h>
+#include "DEPacketKernel.hh"
+
+namespace {
+
+struct VecSSE41 {
+  typedef __m128 Mask;
+  static const int width = 4;
+
+  __m128 v;
+
+  VecSSE41() = default;
+  VecSSE41(__m128 v) : v(v) {};
+  VecSSE41(float s) : v(_mm_set1_ps(s)) {};
+
+  static VecSSE41 load(const float *p) { return _mm_loadu_ps(p); }
+  void store(float *p) const { _mm_storeu_ps(p, v); }
+
+  friend VecSSE41 operator+(VecSSE41 a, VecSSE41 b) { return _mm_add_ps(a.v, b.v); }
+  friend VecSSE41 operator-(VecSSE41 a, VecSSE41 b) { return _mm_sub_ps(a.v, b.v); }
+  friend VecSSE41 operator*(VecSSE41 a, VecSSE41 b) { return _mm_mul_ps(a.v, b.v); }
+  friend VecSSE41 operator/(VecSSE41 a, VecSSE41 b) { return _mm_div_ps(a.v, b.v); }
+
+  static VecSSE41 sqrt(VecSSE41 a) { return _mm_sqrt_ps(a.v); }
+  static VecSSE41 floor(VecSSE41 a) { return _mm_floor_ps(a.v); }
+  static VecSSE41 min(VecSSE41 a, VecSSE41 b) { return _mm_min_ps(a.v, b.v); }
+  static VecSSE41 max(VecSSE41 a, VecSSE41 b) { return _mm_max_ps(a.v, b.v); }
+  static VecSSE41 abs(VecSSE41 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+  static Mask lt(VecSSE41 a, VecSSE41 b) { return _mm_cmplt_ps(a.v, b.v); }
+  static Mask le(VecSSE41 a, VecSSE41 b) { return _mm_cmple_ps(a.v, b.v); }
+  static Mask gt(VecSSE41 a, VecSSE41 b) { return _mm_cmpgt_ps(a.v, b.v); }
+  static Mask andMask(Mask a, Mask b) { return _mm_and_ps(a, b); }
+  static Mask orMask(Mask a, Mask b) { return _mm_or_ps(a, b); }
+  static bool any(Mask m) { return _mm_movemask_ps(m) != 0; }
+  static VecSSE41 select(Mask m, VecSSE41 a, VecSSE41 b) { return _mm_blendv_ps(b.v, a.v, m); }
+
+  static VecSSE41 exp2i(VecSSE41 n) {
+    __m128i e = _mm_add_epi32(_mm_cvtps_epi32(n.v), _mm_set1_epi32(127));
+    return _mm_castsi128_ps(_mm_slli_epi32(e, 23));
+  }
+
+  static void frexp(VecSSE41 x, VecSSE41 &mantissa, VecSSE41 &exponent) {
+    __m128i bits = _mm_castps_si128(x.v);
+    __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128i m = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000));
+    exponent = _mm_cvtepi32_ps(e);
+    mantissa = _mm_castsi128_ps(m);
+  }
+};
+
+}
+
+void estimatePacketSSE41(const DEParams &p, const float *x, const float *y, const float *z,
+                         float *distance, float *orbitTrap) {
+  packet::estimate<VecSSE41>(p, x, y, z, distance, orbitTrap);
+}
+
+#endif
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cmath>
+#include "DistanceEstimator.hh"
+
+DistanceEstimator::DistanceEstimator(const FractalUniforms &uniforms, const AppState &state, float time)
+    : u(uniforms) {
+  p.fractalIters = u.fractalIters;
+  p.bailLimit = u.bailLimit;
+  p.fudgeFactor = u.fudgeFactor;
+
+  p.mandelbulbOn = state.mandelbulbOn;
+  p.power = u.power;
+  p.integerPower = u.integerPower();
+  p.derivativeBias = u.derivativeBias;
+  p.julia = u.julia;
+  p.juliaC = u.juliaC;
+
+  p.boxFoldFactor = state.boxFoldingOn ? u.boxFoldFactor : 0;
+  p.boxFoldingLimit = u.boxFoldingLimit;
+
+  p.sphereFoldFactor = state.sphereFoldingOn ? u.sphereFoldFactor : 0;
+  p.sphereMinRadius = u.sphereMinRadius;
+  if (u.sphereMinTimeVariance)
+    p.sphereMinRadius += 0.02f * std::abs(std::sin(time)) * std::abs(std::sin(0.1f * time));
+  p.sphereFixedRadius = u.sphereFixedRadius;
+
+  p.mandelBoxOn = state.mandelBoxOn;
+  p.mandelBoxScale = u.mandelBoxScale;
+
+  p.tetraFactor = state.recursiveTetraOn ? u.tetraFactor : 0;
+  p.tetraScale = u.tetraScale;
+}
+
+template<typename V>
+void DistanceEstimator::recTetra(V &z) const {
+  typedef decltype(V().x) T;
+  const V a1 = V(1, 1, 1);
+  const V a2 = V(-1, -1, 1);
+  const V a3 = V(1, -1, -1);
+  const V a4 = V(-1, 1, -1);
+
+  V c = a1;
+  T dist = glm::length(z - a1);
+  T d;
+
+  d = glm::length(z - a2);
+  if (d < dist) {
+    c = a2;
+    dist = d;
+  }
+
+  d = glm::length(z - a3);
+  if (d < dist) {
+    c = a3;
+    dist = d;
+  }
+
+  d = glm::length(z - a4);
+  if (d < dist)
+    c = a4;
+
+  z = T(p.tetraScale) * z - c * T(p.tetraScale - 1.0f);
+}
+
+template<typename V>
+void DistanceEstimator::sphereFold(V &z, decltype(V().x) &dz) const {
+  typedef decltype(V().x) T;
+  T r2 = glm::dot(z, z);
+
+  if (r2 < p.sphereMinRadius) {
+    // linear inner scaling
+    T temp = T(p.sphereFixedRadius) / T(p.sphereMinRadius);
+    z *= temp;
+    dz *= temp;
+  } else if (r2 < p.sphereFixedRadius) {
+    // this is the actual sphere inversion
+    T temp = T(p.sphereFixedRadius) / r2;
+    z *= temp;
+    dz *= temp;
+  }
+}
+
+template<typename V>
+void DistanceEstimator::boxFold(V &z) const {
+  typedef decltype(V().x) T;
+  z = glm::clamp(z, T(-p.boxFoldingLimit), T(p.boxFoldingLimit)) * T(2) - z;
+}
+
+template<typename V>
+void DistanceEstimator::mandelbox(V &z, decltype(V().x) &dr) const {
+  typedef decltype(V().x) T;
+  V pos = z;
+  for (int i = 0; i < p.fractalIters; i++) {
+    boxFold(z);
+    sphereFold(z, dr);
+    z = T(p.mandelBoxScale) * z + pos;
+    dr = dr * T(std::abs(p.mandelBoxScale)) + T(1);
+  }
+}
+
+template<typename V>
+void DistanceEstimator::mandelbulb(V &z, decltype(V().x) &dr, decltype(V().x) r) const {
+  typedef decltype(V().x) T;
+  T power = T(p.power);
+  T theta = std::asin(z.z / r);
+  T phi = std::atan2(z.y, z.x);
+
+  // With Mermelada's tweak to reduce errors
+  dr = glm::max(dr * T(p.derivativeBias), std::pow(r, power - T(1)) * power * dr + T(1));
+
+  // scale and rotate the point
+  T zr = std::pow(r, power);
+  theta = theta * power;
+  phi = phi * power;
+
+  z = zr * V(std::cos(theta) * std::cos(phi), std::cos(theta) * std::sin(phi), std::sin(theta));
+}
+
+namespace {
+
+// (re, im)^N by squaring, unrolled by the compiler since N is a constant
+template<int N, typename T>
+void complexPow(T &re, T &im) {
+  T resultRe = T(1), resultIm = T(0);
+  for (int e = N; e > 0; e >>= 1) {
+    if (e & 1) {
+      T t = resultRe * re - resultIm * im;
+      resultIm = resultRe * im + resultIm * re;
+      resultRe = t;
+    }
+    T t = re * re - im * im;
+    im = T(2) * re * im;
+    re = t;
+  }
+  re = resultRe;
+  im = resultIm;
+}
+
+template<int N, typename T>
+T intPow(T x) {
+  T result = T(1);
+  for (int e = N; e > 0; e >>= 1) {
+    if (e & 1) result *= x;
+    x *= x;
+  }
+  return result;
+}
+
+}
+
+template<int POWER, typename V>
+void DistanceEstimator::mandelbulbPower(V &z, decltype(V().x) &dr, decltype(V().x) r) const {
+  typedef decltype(V().x) T;
+
+  // cos and sin of theta and phi as unit complex numbers, multiplying those
+  // POWER times gives the cos and sin of POWER * theta and POWER * phi
+  T rho = std::sqrt(z.x * z.x + z.y * z.y);
+  T cosTheta = rho / r, sinTheta = z.z / r;
+  T cosPhi = rho > T(0) ? z.x / rho : T(1);
+  T sinPhi = rho > T(0) ? z.y / rho : T(0);
+  complexPow<POWER>(cosTheta, sinTheta);
+  complexPow<POWER>(cosPhi, sinPhi);
+
+  T rPowMinusOne = intPow<POWER - 1>(r);
+  dr = glm::max(dr * T(p.derivativeBias), rPowMinusOne * T(POWER) * dr + T(1));
+
+  T zr = rPowMinusOne * r;
+  z = zr * V(cosTheta * cosPhi, cosTheta * sinPhi, sinTheta);
+}
+
+mat3 DistanceEstimator::mandelbulbJacobian(vec3 z, float r) const {
+  float rho = glm::max(glm::length(vec2(z)), 1e-10f);
+  float theta = std::asin(z.z / r) * p.power;
+  float phi = std::atan2(z.y, z.x) * p.power;
+  float zr = std::pow(r, p.power);
+
+  vec3 dR = p.power * std::pow(r, p.power - 1.0f)
+      * vec3(std::cos(theta) * std::cos(phi), std::cos(theta) * std::sin(phi), std::sin(theta));
+  vec3 dTheta = zr * p.power * vec3(-std::sin(theta) * std::cos(phi), -std::sin(theta) * std::sin(phi), std::cos(theta));
+  vec3 dPhi = zr * p.power * vec3(-std::cos(theta) * std::sin(phi), std::cos(theta) * std::cos(phi), 0.0f);
+
+  vec3 gradR = z / r;
+  vec3 gradTheta = (vec3(0.0f, 0.0f, 1.0f) - z.z * z / (r * r)) / rho;
+  vec3 gradPhi = vec3(-z.y, z.x, 0.0f) / (rho * rho);
+  return glm::outerProduct(dR, gradR) + glm::outerProduct(dTheta, gradTheta) + glm::outerProduct(dPhi, gradPhi);
+}
+
+mat3 DistanceEstimator::boxFoldJacobian(vec3 z) const {
+  mat3 J(1.0f);
+  for (int i = 0; i < 3; i++)
+    if (std::abs(z[i]) > p.boxFoldingLimit)
+      J[i][i] = -1.0f;
+  return J;
+}
+
+mat3 DistanceEstimator::sphereFoldJacobian(vec3 z) const {
+  float r2 = glm::dot(z, z);
+  if (r2 < p.sphereMinRadius)
+    return mat3(p.sphereFixedRadius / p.sphereMinRadius);
+  if (r2 < p.sphereFixedRadius)
+    return p.sphereFixedRadius / r2 * (mat3(1.0f) - 2.0f * glm::outerProduct(z, z) / r2);
+  return mat3(1.0f);
+}
+
+vec3 DistanceEstimator::analyticNormal(vec3 pos) const {
+  vec3 z = pos;
+  mat3 J(1.0f);
+  float invScale = 1.0f;
+  float dr = 1.0f;
+  float r = glm::length(z);
+
+  for (int i = 0; i < p.fractalIters; i++) {
+    if (r > p.bailLimit) break;
+
+    if (p.mandelbulbOn) {
+      J = mandelbulbJacobian(z, r) * J;
+      mandelbulb(z, dr, r);
+    }
+
+    if (p.boxFoldFactor > 0) {
+      J = float(p.boxFoldFactor) * boxFoldJacobian(z) * J;
+      boxFold(z);
+      z *= float(p.boxFoldFactor);
+    }
+
+    if (p.sphereFoldFactor > 0) {
+      J = float(p.sphereFoldFactor) * sphereFoldJacobian(z) * J;
+      sphereFold(z, dr);
+      z *= float(p.sphereFoldFactor);
+    }
+
+    if (p.mandelBoxOn) {
+      vec3 boxPos = z;
+      mat3 boxJ = J;
+      for (int j = 0; j < p.fractalIters; j++) {
+        J = boxFoldJacobian(z) * J;
+        boxFold(z);
+        J = sphereFoldJacobian(z) * J;
+        sphereFold(z, dr);
+        z = p.mandelBoxScale * z + boxPos;
+        J = p.mandelBoxScale * J + boxJ;
+      }
+    }
+
+    if (p.tetraFactor > 0) {
+      J *= p.tetraScale * float(p.tetraFactor);
+      recTetra(z);
+      z *= float(p.tetraFactor);
+    }
+
+    z += p.julia ? p.juliaC : pos;
+    if (!p.julia)
+      J += mat3(invScale);
+    r = glm::length(z);
+
+    float size = glm::length(J[0]) + glm::length(J[1]) + glm::length(J[2]);
+    if (size > 1e10f) {
+      J /= size;
+      invScale /= size;
+    }
+  }
+
+  return glm::normalize(glm::transpose(J) * z);
+}
+
+template<int POWER, typename V>
+decltype(V().x) DistanceEstimator::estimatePower(V pos, vec4 &orbitTrap) const {
+  typedef decltype(V().x) T;
+  V z = pos;
+  T dr = T(1);
+  T r = glm::length(z);
+  V add = p.julia ? V(p.juliaC) : pos;
+
+  for (int i = 0; i < p.fractalIters; i++) {
+    if (r > p.bailLimit) break;
+
+    if (p.mandelbulbOn) {
+      if (POWER > 0)
+        mandelbulbPower<POWER>(z, dr, r);
+      else
+        mandelbulb(z, dr, r);
+    }
+
+    if (p.boxFoldFactor > 0) {
+      boxFold(z);
+      z *= T(p.boxFoldFactor);
+    }
+
+    if (p.sphereFoldFactor > 0) {
+      sphereFold(z, dr);
+      z *= T(p.sphereFoldFactor);
+    }
+
+    if (p.mandelBoxOn)
+      mandelbox(z, dr);
+
+    if (p.tetraFactor > 0) {
+      recTetra(z);
+      z *= T(p.tetraFactor);
+    }
+
+    z += add;
+    r = glm::length(z);
+    orbitTrap = glm::min(orbitTrap, glm::abs(vec4(vec3(z), float(glm::dot(z, z)))));
+  }
+
+  return T(p.fudgeFactor) * T(0.5) * std::log(r) * r / dr;
+}
+
+template<typename V>
+decltype(V().x) DistanceEstimator::estimateWith(V pos, vec4 &orbitTrap) const {
+  switch (p.integerPower) {
+    case 2: return estimatePower<2>(pos, orbitTrap);
+    case 3: return estimatePower<3>(pos, orbitTrap);
+    case 4: return estimatePower<4>(pos, orbitTrap);
+    case 5: return estimatePower<5>(pos, orbitTrap);
+    case 6: return estimatePower<6>(pos, orbitTrap);
+    case 7: return estimatePower<7>(pos, orbitTrap);
+    case 8: return estimatePower<8>(pos, orbitTrap);
+    case 9: return estimatePower<9>(pos, orbitTrap);
+    case 10: return estimatePower<10>(pos, orbitTrap);
+    default: return estimatePower<0>(pos, orbitTrap);
+  }
+}
+
+float DistanceEstimator::estimate(vec3 pos, vec4 &orbitTrap) const {
+  return estimateWith(pos, orbitTrap);
+}
+
+float DistanceEstimator::estimate(vec3 pos) const {
+  vec4 orbitTrap = vec4(10000.0f);
+  return estimate(pos, orbitTrap);
+}
+
+double DistanceEstimator::estimate(dvec3 pos, vec4 &orbitTrap) const {
+  return estimateWith(pos, orbitTrap);
+}
+
+double DistanceEstimator::estimate(dvec3 pos) const {
+  vec4 orbitTrap = vec4(10000.0f);
+  return estimate(pos, orbitTrap);
+}
+
+float DistanceEstimator::deepMinDistance(dvec3 eye, float pixelAngle) const {
+  double surfaceDistance = std::abs(estimate(eye));
+  return std::min(u.minDistance, (float) (0.5 * pixelAngle * surfaceDistance));
+}
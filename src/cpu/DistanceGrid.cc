@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include "DistanceGrid.hh"
+
+namespace {
+
+bool sameParams(const DEParams &a, const DEParams &b) {
+  return a.fractalIters == b.fractalIters && a.bailLimit == b.bailLimit && a.fudgeFactor == b.fudgeFactor
+      && a.mandelbulbOn == b.mandelbulbOn && a.power == b.power && a.integerPower == b.integerPower
+      && a.derivativeBias == b.derivativeBias && a.julia == b.julia && a.juliaC == b.juliaC
+      && a.boxFoldFactor == b.boxFoldFactor && a.boxFoldingLimit == b.boxFoldingLimit
+      && a.sphereFoldFactor == b.sphereFoldFactor && a.sphereMinRadius == b.sphereMinRadius
+      && a.sphereFixedRadius == b.sphereFixedRadius && a.mandelBoxOn == b.mandelBoxOn
+      && a.mandelBoxScale == b.mandelBoxScale && a.tetraFactor == b.tetraFactor && a.tetraScale == b.tetraScale;
+}
+
+}
+
+DistanceGrid::~DistanceGrid() {
+  cancelled = true;
+}
+
+void DistanceGrid::request(const DistanceEstimator &de) {
+  const DEParams &p = de.params();
+
+  // Compared against the newest grid that will be there once everything queued is done
+  if (requested ? sameParams(requested->params(), p) : inFlight && sameParams(inFlight->params(), p))
+    return;
+  if (!inFlight && built && sameParams(builtParams, p)) {
+    requested.reset();
+    return;
+  }
+
+  requested = std::make_shared<const DistanceEstimator>(de);
+  if (inFlight)
+    cancelled = true;
+  else
+    start();
+}
+
+void DistanceGrid::start() {
+  inFlight = std::move(requested);
+  requested.reset();
+
+  // One core is left to the render thread
+  if (!pool)
+    pool.reset(new ThreadPool(std::max(2u, std::thread::hardware_concurrency()) - 1));
+
+  nextBounds.resize((size_t) SIZE * SIZE * SIZE);
+  cancelled = false;
+  slicesLeft = SIZE;
+  buildStart = std::chrono::steady_clock::now();
+
+  std::shared_ptr<const DistanceEstimator> de = inFlight;
+  for (unsigned int z = 0; z < SIZE; z++) {
+    pool->submit([this, de, z] {
+      if (!cancelled)
+        buildSlice(*de, z);
+      slicesLeft--;
+    });
+  }
+}
+
+void DistanceGrid::buildSlice(const DistanceEstimator &de, unsigned int z) {
+  const float sliceExtent = extentFor(de.params().bailLimit);
+  const float cellSize = 2.0f * sliceExtent / (float) SIZE;
+  const float halfDiagonal = 0.5f * std::sqrt(3.0f) * cellSize;
+  const size_t count = (size_t) SIZE * SIZE;
+
+  std::vector<float> xs(count), ys(count), zs(count), distance(count);
+  for (unsigned int y = 0; y < SIZE; y++) {
+    for (unsigned int x = 0; x < SIZE; x++) {
+      size_t i = (size_t) y * SIZE + x;
+      xs[i] = -sliceExtent + ((float) x + 0.5f) * cellSize;
+      ys[i] = -sliceExtent + ((float) y + 0.5f) * cellSize;
+      zs[i] = -sliceExtent + ((float) z + 0.5f) * cellSize;
+    }
+  }
+
+  de.estimatePacket(bestSimdLevel(), count, xs.data(), ys.data(), zs.data(), distance.data());
+
+  // The DE is taken to grow no faster than the distance, which the march relies on
+  // too. Written so a NaN estimate also lands on 0.
+  float *slice = nextBounds.data() + (size_t) z * count;
+  for (size_t i = 0; i < count; i++) {
+    float bound = distance[i] * (1.0f - DE_ERROR_MARGIN) - halfDiagonal;
+    slice[i] = bound > 0.0f ? bound : 0.0f;
+  }
+}
+
+bool DistanceGrid::poll() {
+  if (!inFlight || slicesLeft > 0)
+    return false;
+
+  bool finished = !cancelled;
+  if (finished) {
+    bounds.swap(nextBounds);
+    builtParams = inFlight->params();
+    extent = extentFor(builtParams.bailLimit);
+    built = true;
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - buildStart;
+    buildMS = (float) elapsed.count();
+  }
+
+  inFlight.reset();
+  if (requested)
+    start();
+  return finished;
+}
+
+bool DistanceGrid::matches(const DistanceEstimator &de) const {
+  return built && sameParams(builtParams, de.params());
+}
@@ -0,0 +1,177 @@
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "FarmProtocol.hh"
+
+namespace {
+
+const size_t HEADER_SIZE = 12;
+
+void putU32(std::vector<unsigned char> &out, uint32_t v) {
+  out.push_back((unsigned char) (v & 0xFF));
+  out.push_back((unsigned char) ((v >> 8) & 0xFF));
+  out.push_back((unsigned char) ((v >> 16) & 0xFF));
+  out.push_back((unsigned char) ((v >> 24) & 0xFF));
+}
+
+uint32_t getU32(const unsigned char *in) {
+  return (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+bool writeAll(int fd, const unsigned char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= (size_t) written;
+  }
+  return true;
+}
+
+bool readAll(int fd, unsigned char *data, size_t size) {
+  while (size > 0) {
+    ssize_t got = read(fd, data, size);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return false;
+    data += got;
+    size -= (size_t) got;
+  }
+  return true;
+}
+
+void putTile(std::vector<unsigned char> &out, uint32_t id, const Tile &tile) {
+  putU32(out, id);
+  putU32(out, tile.x0);
+  putU32(out, tile.y0);
+  putU32(out, tile.x1);
+  putU32(out, tile.y1);
+}
+
+bool getTile(const FarmMessage &message, uint32_t &id, Tile &tile) {
+  if (message.payload.size() < 20)
+    return false;
+
+  const unsigned char *p = message.payload.data();
+  id = getU32(p);
+  tile = {getU32(p + 4), getU32(p + 8), getU32(p + 12), getU32(p + 16)};
+  return tile.x0 < tile.x1 && tile.y0 < tile.y1;
+}
+
+}
+
+bool FarmMessageReader::readAvailable(int fd) {
+  unsigned char chunk[65536];
+  while (true) {
+    ssize_t got = read(fd, chunk, sizeof(chunk));
+    if (got > 0) {
+      buffer.insert(buffer.end(), chunk, chunk + got);
+      continue;
+    }
+    if (got < 0 && errno == EINTR)
+      continue;
+    return got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+}
+
+bool FarmMessageReader::next(FarmMessage &message) {
+  if (corrupt || buffer.size() < HEADER_SIZE)
+    return false;
+
+  uint32_t length = getU32(buffer.data() + 8);
+  if (getU32(buffer.data()) != FARM_MAGIC || length > FARM_MAX_PAYLOAD) {
+    corrupt = true;
+    return false;
+  }
+  if (buffer.size() < HEADER_SIZE + length)
+    return false;
+
+  message.type = getU32(buffer.data() + 4);
+  message.payload.assign(buffer.begin() + HEADER_SIZE, buffer.begin() + HEADER_SIZE + length);
+  buffer.erase(buffer.begin(), buffer.begin() + HEADER_SIZE + length);
+  return true;
+}
+
+bool sendFarmMessage(int fd, const FarmMessage &message) {
+  std::vector<unsigned char> header;
+  putU32(header, FARM_MAGIC);
+  putU32(header, message.type);
+  putU32(header, (uint32_t) message.payload.size());
+  return writeAll(fd, header.data(), header.size())
+      && writeAll(fd, message.payload.data(), message.payload.size());
+}
+
+bool receiveFarmMessage(int fd, FarmMessage &message) {
+  unsigned char header[HEADER_SIZE];
+  if (!readAll(fd, header, HEADER_SIZE))
+    return false;
+
+  uint32_t length = getU32(header + 8);
+  if (getU32(header) != FARM_MAGIC || length > FARM_MAX_PAYLOAD)
+    return false;
+
+  message.type = getU32(header + 4);
+  message.payload.resize(length);
+  return readAll(fd, message.payload.data(), length);
+}
+
+FarmMessage farmJobMessage(unsigned int width, unsigned int height, const std::string &keyframe) {
+  FarmMessage message;
+  message.type = FARM_JOB;
+  putU32(message.payload, width);
+  putU32(message.payload, height);
+  message.payload.insert(message.payload.end(), keyframe.begin(), keyframe.end());
+  return message;
+}
+
+bool parseFarmJob(const FarmMessage &message, unsigned int &width, unsigned int &height, std::string &keyframe) {
+  if (message.type != FARM_JOB || message.payload.size() < 8)
+    return false;
+
+  width = getU32(message.payload.data());
+  height = getU32(message.payload.data() + 4);
+  keyframe.assign(message.payload.begin() + 8, message.payload.end());
+  return width > 0 && height > 0;
+}
+
+FarmMessage farmTileMessage(uint32_t id, const Tile &tile) {
+  FarmMessage message;
+  message.type = FARM_TILE;
+  putTile(message.payload, id, tile);
+  return message;
+}
+
+bool parseFarmTile(const FarmMessage &message, uint32_t &id, Tile &tile) {
+  return message.type == FARM_TILE && getTile(message, id, tile);
+}
+
+FarmMessage farmResultMessage(uint32_t id, const Tile &tile, const Image &pixels) {
+  FarmMessage message;
+  message.type = FARM_RESULT;
+  putTile(message.payload, id, tile);
+  message.payload.insert(message.payload.end(), pixels.pixels.begin(), pixels.pixels.end());
+  return message;
+}
+
+bool parseFarmResult(const FarmMessage &message, uint32_t &id, Tile &tile, const unsigned char *&pixels) {
+  if (message.type != FARM_RESULT || !getTile(message, id, tile))
+    return false;
+
+  size_t expected = 20 + 3 * (size_t) (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+  if (message.payload.size() != expected)
+    return false;
+
+  pixels = message.payload.data() + 20;
+  return true;
+}
+
+FarmMessage farmTextMessage(uint32_t type, const std::string &text) {
+  FarmMessage message;
+  message.type = type;
+  message.payload.assign(text.begin(), text.end());
+  return message;
+}
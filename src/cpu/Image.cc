@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include "Image.hh"
+
+namespace {
+
+struct CrcTable {
+  uint32_t entries[256];
+
+  CrcTable() {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      entries[n] = c;
+    }
+  }
+};
+
+uint32_t crc32(const unsigned char *data, size_t length) {
+  static const CrcTable table;
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < length; i++)
+    crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+void putU32(std::vector<unsigned char> &out, uint32_t v) {
+  out.push_back((unsigned char) (v >> 24));
+  out.push_back((unsigned char) (v >> 16));
+  out.push_back((unsigned char) (v >> 8));
+  out.push_back((unsigned char) v);
+}
+
+void writeChunk(FILE *file, const char *type, const std::vector<unsigned char> &data) {
+  std::vector<unsigned char> chunk;
+  putU32(chunk, (uint32_t) data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  putU32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+  fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+}
+
+void Image::setPixel(unsigned int x, unsigned int y, vec3 color) {
+  color = glm::clamp(color, 0.0f, 1.0f);
+  unsigned char *p = &pixels[3 * (y * width + x)];
+  p[0] = (unsigned char) (color.r * 255.0f + 0.5f);
+  p[1] = (unsigned char) (color.g * 255.0f + 0.5f);
+  p[2] = (unsigned char) (color.b * 255.0f + 0.5f);
+}
+
+bool Image::writePPM(const std::string &fileName) const {
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if (file == nullptr) {
+    std::cout << "Error: Cannot open file. " << fileName << std::endl;
+    return false;
+  }
+
+  fprintf(file, "P6\n%u %u\n255\n", width, height);
+  fwrite(pixels.data(), 1, pixels.size(), file);
+  fclose(file);
+  return true;
+}
+
+bool Image::writePNG(const std::string &fileName) const {
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if (file == nullptr) {
+    std::cout << "Error: Cannot open file. " << fileName << std::endl;
+    return false;
+  }
+
+  const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  fwrite(signature, 1, sizeof(signature), file);
+
+  std::vector<unsigned char> header;
+  putU32(header, width);
+  putU32(header, height);
+  header.push_back(8); // Bit depth
+  header.push_back(2); // Truecolor
+  header.push_back(0); // Deflate
+  header.push_back(0); // Adaptive filtering
+  header.push_back(0); // No interlace
+  writeChunk(file, "IHDR", header);
+
+  // Every scanline is prefixed with filter type 0 (none)
+  std::vector<unsigned char> raw;
+  size_t stride = 3 * (size_t) width;
+  raw.reserve((stride + 1) * height);
+  for (unsigned int y = 0; y < height; y++) {
+    raw.push_back(0);
+    raw.insert(raw.end(), pixels.begin() + y * stride, pixels.begin() + (y + 1) * stride);
+  }
+
+  // zlib stream made of stored blocks of at most 65535 bytes
+  std::vector<unsigned char> zlib = {0x78, 0x01};
+  uint32_t adlerA = 1, adlerB = 0;
+  size_t offset = 0;
+  do {
+    auto blockSize = (uint16_t) std::min<size_t>(65535, raw.size() - offset);
+    bool last = offset + blockSize == raw.size();
+    zlib.push_back(last ? 1 : 0);
+    zlib.push_back((unsigned char) (blockSize & 0xff));
+    zlib.push_back((unsigned char) (blockSize >> 8));
+    zlib.push_back((unsigned char) (~blockSize & 0xff));
+    zlib.push_back((unsigned char) ((uint16_t) ~blockSize >> 8));
+
+    for (size_t i = offset; i < offset + blockSize; i++) {
+      adlerA = (adlerA + raw[i]) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+    }
+    zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+    offset += blockSize;
+  } while (offset < raw.size());
+  putU32(zlib, (adlerB << 16) | adlerA);
+
+  writeChunk(file, "IDAT", zlib);
+  writeChunk(file, "IEND", {});
+  fclose(file);
+  return true;
+}
+
+bool Image::write(const std::string &fileName) const {
+  auto dot = fileName.rfind('.');
+  if (dot != std::string::npos && fileName.substr(dot) == ".ppm")
+    return writePPM(fileName);
+  return writePNG(fileName);
+}
+
+bool validFramePattern(const std::string &pattern, bool numbered) {
+  unsigned int conversions = 0;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    if (pattern[i] != '%')
+      continue;
+    if (++i < pattern.size() && pattern[i] == '%')
+      continue;
+
+    // A zero padded width of at most two digits, then the conversion
+    size_t digits = 0;
+    if (i < pattern.size() && pattern[i] == '0') {
+      for (i++; i < pattern.size() && pattern[i] >= '0' && pattern[i] <= '9'; i++)
+        digits++;
+      if (digits == 0 || digits > 2)
+        return false;
+    }
+    if (i >= pattern.size() || (pattern[i] != 'u' && (pattern[i] != 'd' || digits > 0)))
+      return false;
+    conversions++;
+  }
+  return conversions == 1 || (!numbered && conversions == 0);
+}
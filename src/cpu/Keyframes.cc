@@ -0,0 +1,335 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "glm/gtc/matrix_transform.hpp"
+#include "Keyframes.hh"
+
+namespace {
+
+struct FloatParam {
+  const char *name;
+  float FractalUniforms::*member;
+};
+
+struct Vec3Param {
+  const char *name;
+  vec3 FractalUniforms::*member;
+};
+
+struct IntParam {
+  const char *name;
+  int FractalUniforms::*member;
+};
+
+struct BoolParam {
+  const char *name;
+  bool FractalUniforms::*member;
+};
+
+struct StateParam {
+  const char *name;
+  bool AppState::*member;
+};
+
+const FloatParam floatParams[] = {
+    {"maxRaySteps", &FractalUniforms::maxRaySteps},
+    {"bailLimit", &FractalUniforms::bailLimit},
+    {"power", &FractalUniforms::power},
+    {"boxFoldingLimit", &FractalUniforms::boxFoldingLimit},
+    {"sphereMinRadius", &FractalUniforms::sphereMinRadius},
+    {"sphereFixedRadius", &FractalUniforms::sphereFixedRadius},
+    {"mandelBoxScale", &FractalUniforms::mandelBoxScale},
+    {"tetraScale", &FractalUniforms::tetraScale},
+    {"fudgeFactor", &FractalUniforms::fudgeFactor},
+    {"noiseFactor", &FractalUniforms::noiseFactor},
+    {"glowFactor", &FractalUniforms::glowFactor},
+    {"otBaseStrength", &FractalUniforms::otBaseStrength},
+    {"otDist0to1", &FractalUniforms::otDist0to1},
+    {"otDist1to2", &FractalUniforms::otDist1to2},
+    {"otDist2to3", &FractalUniforms::otDist2to3},
+    {"otDist3to0", &FractalUniforms::otDist3to0},
+    {"otCycleIntensity", &FractalUniforms::otCycleIntensity},
+    {"otPaletteOffset", &FractalUniforms::otPaletteOffset},
+    {"shadowBrightness", &FractalUniforms::shadowBrightness},
+    {"shadowSharpness", &FractalUniforms::shadowSharpness},
+    {"phongShadingMixFactor", &FractalUniforms::phongShadingMixFactor},
+    {"ambientIntensity", &FractalUniforms::ambientIntensity},
+    {"diffuseIntensity", &FractalUniforms::diffuseIntensity},
+    {"specularIntensity", &FractalUniforms::specularIntensity},
+    {"shininess", &FractalUniforms::shininess},
+};
+
+const Vec3Param vec3Params[] = {
+    {"juliaC", &FractalUniforms::juliaC},
+    {"bgColor", &FractalUniforms::bgColor},
+    {"glowColor", &FractalUniforms::glowColor},
+    {"otColor0", &FractalUniforms::otColor0},
+    {"otColor1", &FractalUniforms::otColor1},
+    {"otColor2", &FractalUniforms::otColor2},
+    {"otColor3", &FractalUniforms::otColor3},
+    {"otColorBase", &FractalUniforms::otColorBase},
+    {"lightPos", &FractalUniforms::lightPos},
+};
+
+const IntParam intParams[] = {
+    {"minDistanceFactor", &FractalUniforms::minDistanceFactor},
+    {"fractalIters", &FractalUniforms::fractalIters},
+    {"derivativeBias", &FractalUniforms::derivativeBias},
+    {"boxFoldFactor", &FractalUniforms::boxFoldFactor},
+    {"sphereFoldFactor", &FractalUniforms::sphereFoldFactor},
+    {"tetraFactor", &FractalUniforms::tetraFactor},
+    {"shadowRayMinStepsTaken", &FractalUniforms::shadowRayMinStepsTaken},
+    {"normalMode", &FractalUniforms::normalMode},
+    {"deepIterations", &FractalUniforms::deepIterations},
+};
+
+const BoolParam boolParams[] = {
+    {"julia", &FractalUniforms::julia},
+    {"sphereMinTimeVariance", &FractalUniforms::sphereMinTimeVariance},
+    {"showBgGradient", &FractalUniforms::showBgGradient},
+    {"noiseTexture", &FractalUniforms::noiseTexture},
+    {"lightSource", &FractalUniforms::lightSource},
+    {"gammaCorrection", &FractalUniforms::gammaCorrection},
+};
+
+const StateParam stateParams[] = {
+    {"mandelbulbOn", &AppState::mandelbulbOn},
+    {"boxFoldingOn", &AppState::boxFoldingOn},
+    {"sphereFoldingOn", &AppState::sphereFoldingOn},
+    {"mandelBoxOn", &AppState::mandelBoxOn},
+    {"recursiveTetraOn", &AppState::recursiveTetraOn},
+    {"deepZoom", &AppState::deepZoom},
+};
+
+bool readVec3(std::istringstream &line, vec3 &v) {
+  return (bool) (line >> v.x >> v.y >> v.z);
+}
+
+bool readVec3(std::istringstream &line, dvec3 &v) {
+  return (bool) (line >> v.x >> v.y >> v.z);
+}
+
+bool readVec4(std::istringstream &line, vec4 &v) {
+  return (bool) (line >> v.x >> v.y >> v.z >> v.w);
+}
+
+/**
+ * Sets one named value, false if the name is unknown or the value does not parse
+ */
+bool parseSetting(const std::string &name, std::istringstream &line, Keyframe &key) {
+  if (name == "eye") return readVec3(line, key.eye);
+  if (name == "center") return readVec3(line, key.center);
+  if (name == "up") return readVec3(line, key.up);
+  if (name == "time") return (bool) (line >> key.time);
+  if (name == "orbitStrength") return readVec4(line, key.u.orbitStrength);
+
+  if (name == "camera") {
+    double r, theta, phi;
+    if (!(line >> r >> theta >> phi))
+      return false;
+
+    // Same as Camera::updateSphericalView()
+    double x = r * std::sin(theta) * std::cos(phi);
+    double y = r * std::sin(theta) * std::sin(phi);
+    double z = r * std::cos(theta);
+    key.eye = dvec3(y, x, z);
+    key.center = dvec3(0.0);
+    key.up = dvec3(0.0, 1.0, 0.0);
+    return true;
+  }
+
+  for (const FloatParam &p : floatParams)
+    if (name == p.name) return (bool) (line >> key.u.*p.member);
+  for (const Vec3Param &p : vec3Params)
+    if (name == p.name) return readVec3(line, key.u.*p.member);
+  for (const IntParam &p : intParams)
+    if (name == p.name) return (bool) (line >> key.u.*p.member);
+  for (const BoolParam &p : boolParams)
+    if (name == p.name) return (bool) (line >> key.u.*p.member);
+  for (const StateParam &p : stateParams)
+    if (name == p.name) return (bool) (line >> key.state.*p.member);
+  return false;
+}
+
+/**
+ * Hermite segment between p1 at frame f1 and p2 at f2, with Catmull-Rom
+ * tangents scaled to the frame spacing so uneven keyframes keep a smooth speed
+ */
+template<typename T>
+T spline(const T &p0, const T &p1, const T &p2, const T &p3, float f0, float f1, float f2, float f3, float f) {
+  float h = f2 - f1;
+  float t = (f - f1) / h;
+  T m1 = (p2 - p0) * (h / (f2 - f0));
+  T m2 = (p3 - p1) * (h / (f3 - f1));
+
+  float t2 = t * t, t3 = t2 * t;
+  return (2.0f * t3 - 3.0f * t2 + 1.0f) * p1 + (t3 - 2.0f * t2 + t) * m1
+      + (-2.0f * t3 + 3.0f * t2) * p2 + (t3 - t2) * m2;
+}
+
+/**
+ * Same segment for the camera, with double weights since float ones would
+ * round a deep zoom position by more than a pixel
+ */
+dvec3 spline(const dvec3 &p0, const dvec3 &p1, const dvec3 &p2, const dvec3 &p3,
+             float f0, float f1, float f2, float f3, float f) {
+  double h = (double) f2 - f1;
+  double t = (f - f1) / h;
+  dvec3 m1 = (p2 - p0) * (h / ((double) f2 - f0));
+  dvec3 m2 = (p3 - p1) * (h / ((double) f3 - f1));
+
+  double t2 = t * t, t3 = t2 * t;
+  return (2.0 * t3 - 3.0 * t2 + 1.0) * p1 + (t3 - 2.0 * t2 + t) * m1
+      + (-2.0 * t3 + 3.0 * t2) * p2 + (t3 - t2) * m2;
+}
+
+}
+
+bool KeyframeTrack::load(const std::string &fileName, const FractalUniforms &u, const AppState &state) {
+  std::ifstream file(fileName);
+  if (!file) {
+    std::cerr << "Failed to read " << fileName << "\n";
+    return false;
+  }
+
+  return parse(file, fileName, u, state);
+}
+
+bool KeyframeTrack::parse(std::istream &file, const std::string &fileName, const FractalUniforms &u,
+                          const AppState &state) {
+  keys.clear();
+  Keyframe defaults;
+  defaults.u = u;
+  defaults.state = state;
+
+  std::string text;
+  for (unsigned int lineNumber = 1; std::getline(file, text); lineNumber++) {
+    size_t comment = text.find('#');
+    if (comment != std::string::npos)
+      text.erase(comment);
+
+    std::istringstream line(text);
+    std::string name;
+    if (!(line >> name))
+      continue;
+
+    if (name == "keyframe") {
+      Keyframe key = keys.empty() ? defaults : keys.back();
+      if (!(line >> key.frame) || (!keys.empty() && key.frame <= keys.back().frame)) {
+        std::cerr << fileName << ":" << lineNumber << ": keyframe numbers must increase\n";
+        return false;
+      }
+      keys.push_back(key);
+      continue;
+    }
+
+    if (keys.empty()) {
+      std::cerr << fileName << ":" << lineNumber << ": " << name << " before the first keyframe\n";
+      return false;
+    }
+
+    if (!parseSetting(name, line, keys.back())) {
+      std::cerr << fileName << ":" << lineNumber << ": bad setting " << name << "\n";
+      return false;
+    }
+  }
+
+  if (keys.empty()) {
+    std::cerr << fileName << " has no keyframes\n";
+    return false;
+  }
+
+  for (Keyframe &key : keys)
+    key.u.updateMinDistance();
+  return true;
+}
+
+Keyframe KeyframeTrack::at(unsigned int frame) const {
+  if (frame <= keys.front().frame)
+    return keys.front();
+  if (frame >= keys.back().frame)
+    return keys.back();
+
+  size_t k = 0;
+  while (keys[k + 1].frame <= frame)
+    k++;
+
+  // Ends repeat their keyframe, which flattens the tangent there
+  const Keyframe &k0 = keys[k > 0 ? k - 1 : k];
+  const Keyframe &k1 = keys[k];
+  const Keyframe &k2 = keys[k + 1];
+  const Keyframe &k3 = keys[k + 2 < keys.size() ? k + 2 : k + 1];
+  float f0 = (float) k0.frame, f1 = (float) k1.frame, f2 = (float) k2.frame, f3 = (float) k3.frame;
+  if (f0 == f1) f0 = f1 - (f2 - f1);
+  if (f3 == f2) f3 = f2 + (f2 - f1);
+  float f = (float) frame;
+
+  // Ints and bools hold from k1
+  Keyframe key = k1;
+  key.frame = frame;
+  key.eye = spline(k0.eye, k1.eye, k2.eye, k3.eye, f0, f1, f2, f3, f);
+  key.center = spline(k0.center, k1.center, k2.center, k3.center, f0, f1, f2, f3, f);
+  key.up = spline(k0.up, k1.up, k2.up, k3.up, f0, f1, f2, f3, f);
+  key.time = spline(k0.time, k1.time, k2.time, k3.time, f0, f1, f2, f3, f);
+  key.u.orbitStrength = spline(k0.u.orbitStrength, k1.u.orbitStrength, k2.u.orbitStrength, k3.u.orbitStrength,
+                               f0, f1, f2, f3, f);
+
+  for (const FloatParam &p : floatParams)
+    key.u.*p.member = spline(k0.u.*p.member, k1.u.*p.member, k2.u.*p.member, k3.u.*p.member, f0, f1, f2, f3, f);
+  for (const Vec3Param &p : vec3Params)
+    key.u.*p.member = spline(k0.u.*p.member, k1.u.*p.member, k2.u.*p.member, k3.u.*p.member, f0, f1, f2, f3, f);
+
+  return key;
+}
+
+std::string KeyframeTrack::format(const Keyframe &key) {
+  std::ostringstream text;
+  text.precision(9); // Enough digits for a float to read back the same
+  auto line = [&text](const char *name, vec3 v) { text << name << " " << v.x << " " << v.y << " " << v.z << "\n"; };
+
+  // And for a double, the camera is one
+  auto cameraLine = [&text](const char *name, dvec3 v) {
+    text.precision(17);
+    text << name << " " << v.x << " " << v.y << " " << v.z << "\n";
+    text.precision(9);
+  };
+
+  text << "keyframe " << key.frame << "\n";
+  cameraLine("eye", key.eye);
+  cameraLine("center", key.center);
+  cameraLine("up", key.up);
+  text << "time " << key.time << "\n";
+  text << "orbitStrength " << key.u.orbitStrength.x << " " << key.u.orbitStrength.y << " "
+       << key.u.orbitStrength.z << " " << key.u.orbitStrength.w << "\n";
+
+  for (const FloatParam &p : floatParams)
+    text << p.name << " " << key.u.*p.member << "\n";
+  for (const Vec3Param &p : vec3Params)
+    line(p.name, key.u.*p.member);
+  for (const IntParam &p : intParams)
+    text << p.name << " " << key.u.*p.member << "\n";
+  for (const BoolParam &p : boolParams)
+    text << p.name << " " << (key.u.*p.member ? 1 : 0) << "\n";
+  for (const StateParam &p : stateParams)
+    text << p.name << " " << (key.state.*p.member ? 1 : 0) << "\n";
+  text << "\n";
+  return text.str();
+}
+
+RenderView keyframeView(const Keyframe &key, unsigned int width, unsigned int height,
+                        float fov, float nearPlane, float farPlane) {
+  double screenRatio = (double) width / (double) height;
+  dmat4 projection = glm::perspective(glm::radians((double) fov), screenRatio, (double) nearPlane, (double) farPlane);
+  dmat4 view = glm::lookAt(key.eye, key.center, key.up);
+
+  RenderView v;
+  v.inverseVP = glm::inverse(projection * view);
+  v.eyePos = key.eye;
+  v.nearPlane = nearPlane;
+  v.farPlane = farPlane;
+  v.time = key.time;
+  v.width = width;
+  v.height = height;
+  return v;
+}
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include "MeshExtractor.hh"
+
+namespace {
+
+// Corners of a cell as bits x, y, z of their index, and its edges between them
+const int cellEdges[12][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7},
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+vec3 cornerOffset(int corner) {
+  return vec3((float) (corner & 1), (float) ((corner >> 1) & 1), (float) ((corner >> 2) & 1));
+}
+
+}
+
+struct MeshExtractor::ChunkMesh {
+  unsigned int first[3] = {0, 0, 0}; // First cell of the chunk
+  unsigned int cells[3] = {0, 0, 0}; // Cells along each axis
+
+  std::vector<vec3> vertices;
+  std::vector<uint32_t> vertexCells; // Local cell of each vertex, ascending
+  std::vector<int64_t> quads; // 4 per quad, a local vertex or -1 - the global key of a cell in an earlier chunk
+  uint64_t samples = 0;
+  bool skipped = false;
+};
+
+struct MeshExtractor::Slab {
+  std::vector<ChunkMesh> chunks;
+  std::mutex mutex;
+  std::condition_variable done;
+  unsigned int chunksLeft = 0;
+};
+
+MeshExtractor::MeshExtractor(const DistanceEstimator &de, const MeshVolume &volume)
+    : de(de), volume(volume) {
+  cellSize = 2.0f * volume.extent / (float) volume.resolution;
+  iso = volume.iso > 0.0f ? volume.iso : 0.5f * cellSize;
+  chunksPerSide = (volume.resolution + volume.chunkSize - 1) / volume.chunkSize;
+}
+
+void MeshExtractor::polygonise(ChunkMesh &chunk) const {
+  const unsigned int nx = chunk.cells[0], ny = chunk.cells[1], nz = chunk.cells[2];
+  const unsigned int px = nx + 1, py = ny + 1, pz = nz + 1;
+  const vec3 origin = volume.center - volume.extent;
+  const vec3 first = vec3((float) chunk.first[0], (float) chunk.first[1], (float) chunk.first[2]);
+
+  // Nothing to do when the DE at the center clears the whole chunk, either way
+  vec3 size = vec3((float) nx, (float) ny, (float) nz);
+  float centerField = de.estimate(origin + (first + 0.5f * size) * cellSize) - iso;
+  chunk.samples = 1;
+  if (std::abs(centerField) > 0.5f * cellSize * glm::length(size)) {
+    chunk.skipped = true;
+    return;
+  }
+
+  // Field at every grid point of the chunk, negative inside
+  size_t count = (size_t) px * py * pz;
+  std::vector<float> xs(count), ys(count), zs(count), field(count);
+  for (unsigned int z = 0, i = 0; z < pz; z++) {
+    for (unsigned int y = 0; y < py; y++) {
+      for (unsigned int x = 0; x < px; x++, i++) {
+        vec3 p = origin + (first + vec3((float) x, (float) y, (float) z)) * cellSize;
+        xs[i] = p.x;
+        ys[i] = p.y;
+        zs[i] = p.z;
+      }
+    }
+  }
+  de.estimatePacket(bestSimdLevel(), count, xs.data(), ys.data(), zs.data(), field.data());
+  for (float &f : field)
+    f -= iso;
+  chunk.samples += count;
+
+  auto point = [&](unsigned int x, unsigned int y, unsigned int z) {
+    return field[((size_t) z * py + y) * px + x];
+  };
+
+  // A vertex per cell with corners on both sides, NaN counts as outside
+  std::vector<int32_t> cellVertex((size_t) nx * ny * nz, -1);
+  for (unsigned int z = 0, cell = 0; z < nz; z++) {
+    for (unsigned int y = 0; y < ny; y++) {
+      for (unsigned int x = 0; x < nx; x++, cell++) {
+        float f[8];
+        unsigned int inside = 0;
+        for (int c = 0; c < 8; c++) {
+          f[c] = point(x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1));
+          if (f[c] < 0.0f)
+            inside |= 1u << c;
+        }
+        if (inside == 0 || inside == 0xFF)
+          continue;
+
+        vec3 sum = vec3(0.0f);
+        int crossings = 0;
+        for (const int *edge : cellEdges) {
+          if (((inside >> edge[0]) & 1) == ((inside >> edge[1]) & 1))
+            continue;
+          float t = f[edge[0]] / (f[edge[0]] - f[edge[1]]);
+          if (!(t >= 0.0f && t <= 1.0f))
+            t = 0.5f;
+          sum += glm::mix(cornerOffset(edge[0]), cornerOffset(edge[1]), t);
+          crossings++;
+        }
+
+        cellVertex[cell] = (int32_t) chunk.vertices.size();
+        chunk.vertexCells.push_back(cell);
+        chunk.vertices.push_back(origin + (first + vec3((float) x, (float) y, (float) z)
+                                           + sum / (float) crossings) * cellSize);
+      }
+    }
+  }
+
+  // A quad around each crossed edge whose four cells end in this chunk. The
+  // edge runs along axis from a grid point, the cells sit at -1 and 0 from it
+  // along the other two, listed counterclockwise seen from +axis.
+  const int around[4][2] = {{-1, -1}, {0, -1}, {0, 0}, {-1, 0}};
+  const unsigned int n = volume.resolution;
+  for (int axis = 0; axis < 3; axis++) {
+    int b = (axis + 1) % 3, c = (axis + 2) % 3;
+
+    for (unsigned int z = 0; z < nz; z++) {
+      for (unsigned int y = 0; y < ny; y++) {
+        for (unsigned int x = 0; x < nx; x++) {
+          unsigned int local[3] = {x, y, z};
+          if (chunk.first[b] + local[b] == 0 || chunk.first[c] + local[c] == 0)
+            continue;
+
+          unsigned int end[3] = {x, y, z};
+          end[axis]++;
+          bool startInside = point(x, y, z) < 0.0f;
+          if (startInside == (point(end[0], end[1], end[2]) < 0.0f))
+            continue;
+
+          int64_t quad[4];
+          bool complete = true;
+          for (int k = 0; k < 4; k++) {
+            int cell[3] = {(int) x, (int) y, (int) z};
+            cell[b] += around[k][0];
+            cell[c] += around[k][1];
+
+            if (cell[b] >= 0 && cell[c] >= 0) {
+              quad[k] = cellVertex[((size_t) cell[2] * ny + cell[1]) * nx + cell[0]];
+              complete = complete && quad[k] >= 0;
+            } else {
+              uint64_t gx = chunk.first[0] + cell[0], gy = chunk.first[1] + cell[1], gz = chunk.first[2] + cell[2];
+              quad[k] = -1 - (int64_t) ((gz * n + gy) * n + gx);
+            }
+          }
+          if (!complete)
+            continue;
+
+          // Facing out of the surface, towards the end of the edge that is outside
+          if (!startInside)
+            std::swap(quad[1], quad[3]);
+          chunk.quads.insert(chunk.quads.end(), quad, quad + 4);
+        }
+      }
+    }
+  }
+}
+
+void MeshExtractor::submitSlab(ThreadPool &pool, Slab &slab, unsigned int cz) const {
+  const unsigned int size = volume.chunkSize, n = volume.resolution;
+  slab.chunks.assign((size_t) chunksPerSide * chunksPerSide, ChunkMesh());
+  slab.chunksLeft = (unsigned int) slab.chunks.size();
+
+  for (unsigned int cy = 0, i = 0; cy < chunksPerSide; cy++) {
+    for (unsigned int cx = 0; cx < chunksPerSide; cx++, i++) {
+      ChunkMesh &chunk = slab.chunks[i];
+      unsigned int first[3] = {cx * size, cy * size, cz * size};
+      for (int axis = 0; axis < 3; axis++) {
+        chunk.first[axis] = first[axis];
+        chunk.cells[axis] = std::min(size, n - first[axis]);
+      }
+
+      pool.submit([this, &slab, &chunk] {
+        polygonise(chunk);
+        std::lock_guard<std::mutex> lock(slab.mutex);
+        if (--slab.chunksLeft == 0)
+          slab.done.notify_all();
+      });
+    }
+  }
+}
+
+bool MeshExtractor::writeChunk(ChunkMesh &chunk, MeshFile &file, MeshProgress &progress) {
+  progress.samples += chunk.samples;
+  if (chunk.skipped) {
+    progress.chunksSkipped++;
+    return true;
+  }
+
+  uint64_t base = progress.vertices;
+  if (base + chunk.vertices.size() > UINT32_MAX) {
+    std::cerr << "More than 2^32 vertices, lower the resolution\n";
+    return false;
+  }
+
+  // Cells on the far faces are what later chunks refer to
+  const unsigned int nx = chunk.cells[0], ny = chunk.cells[1], nz = chunk.cells[2];
+  const uint64_t n = volume.resolution;
+  for (size_t i = 0; i < chunk.vertexCells.size(); i++) {
+    unsigned int cell = chunk.vertexCells[i];
+    unsigned int x = cell % nx, y = (cell / nx) % ny, z = cell / (nx * ny);
+    if (x == nx - 1 || y == ny - 1 || z == nz - 1) {
+      uint64_t key = ((chunk.first[2] + z) * n + chunk.first[1] + y) * n + chunk.first[0] + x;
+      currentBorder[key] = (uint32_t) (base + i);
+    }
+  }
+
+  auto resolve = [&](int64_t ref, uint32_t &index) {
+    if (ref >= 0) {
+      index = (uint32_t) (base + ref);
+      return true;
+    }
+
+    uint64_t key = (uint64_t) (-1 - ref);
+    auto it = currentBorder.find(key);
+    if (it == currentBorder.end()) {
+      it = previousBorder.find(key);
+      if (it == previousBorder.end())
+        return false;
+    }
+    index = it->second;
+    return true;
+  };
+
+  // Each quad split into two triangles
+  std::vector<uint32_t> triangles;
+  triangles.reserve(chunk.quads.size() / 4 * 6);
+  for (size_t q = 0; q < chunk.quads.size(); q += 4) {
+    uint32_t v[4];
+    if (!resolve(chunk.quads[q], v[0]) || !resolve(chunk.quads[q + 1], v[1])
+        || !resolve(chunk.quads[q + 2], v[2]) || !resolve(chunk.quads[q + 3], v[3]))
+      continue;
+    triangles.insert(triangles.end(), {v[0], v[1], v[2], v[0], v[2], v[3]});
+  }
+
+  if (!file.addVertices(chunk.vertices.data(), chunk.vertices.size())
+      || !file.addTriangles(triangles.data(), triangles.size() / 3))
+    return false;
+
+  progress.vertices += chunk.vertices.size();
+  progress.triangles += triangles.size() / 3;
+  return true;
+}
+
+bool MeshExtractor::extract(ThreadPool &pool, MeshFile &file, const MeshProgressFunc &progressFunc) {
+  MeshProgress progress;
+  progress.slabCount = chunksPerSide;
+  previousBorder.clear();
+  currentBorder.clear();
+  auto start = std::chrono::steady_clock::now();
+
+  std::unique_ptr<Slab> slabs[2] = {std::unique_ptr<Slab>(new Slab()), std::unique_ptr<Slab>(new Slab())};
+  submitSlab(pool, *slabs[0], 0);
+
+  for (unsigned int cz = 0; cz < chunksPerSide; cz++) {
+    Slab &slab = *slabs[cz % 2];
+    {
+      std::unique_lock<std::mutex> lock(slab.mutex);
+      slab.done.wait(lock, [&] { return slab.chunksLeft == 0; });
+    }
+
+    // The next slab computes while this one is written
+    if (cz + 1 < chunksPerSide)
+      submitSlab(pool, *slabs[(cz + 1) % 2], cz + 1);
+
+    for (ChunkMesh &chunk : slab.chunks) {
+      if (!writeChunk(chunk, file, progress)) {
+        pool.wait();
+        return false;
+      }
+    }
+    slab.chunks.clear();
+    previousBorder.swap(currentBorder);
+    currentBorder.clear();
+
+    progress.slabsDone = cz + 1;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    progress.seconds = elapsed.count();
+    if (progressFunc)
+      progressFunc(progress);
+  }
+
+  return true;
+}
@@ -0,0 +1,124 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "MeshFile.hh"
+
+namespace {
+
+bool endsWith(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool copyFile(FILE *from, FILE *to) {
+  std::vector<char> buffer(1 << 20);
+  rewind(from);
+  size_t n;
+  while ((n = fread(buffer.data(), 1, buffer.size(), from)) > 0)
+    if (fwrite(buffer.data(), 1, n, to) != n)
+      return false;
+  return !ferror(from);
+}
+
+}
+
+MeshFile::~MeshFile() {
+  discard();
+}
+
+std::string MeshFile::sideFileName(const char *part) const {
+  return fileName + "." + part + ".part";
+}
+
+void MeshFile::discard() {
+  if (out) fclose(out);
+  if (faces) fclose(faces);
+  out = nullptr;
+  faces = nullptr;
+  std::remove(sideFileName("vertices").c_str());
+  std::remove(sideFileName("faces").c_str());
+}
+
+bool MeshFile::open(const std::string &name) {
+  discard();
+  fileName = name;
+  obj = endsWith(fileName, ".obj");
+  vertexCount = 0;
+  triangleCount = 0;
+
+  out = fopen(sideFileName("vertices").c_str(), "w+b");
+  if (!obj)
+    faces = fopen(sideFileName("faces").c_str(), "w+b");
+  if (!out || (!obj && !faces)) {
+    fprintf(stderr, "Failed to open %s for writing.\n", sideFileName("vertices").c_str());
+    discard();
+    return false;
+  }
+
+  if (obj)
+    fprintf(out, "# Mandelbulb explorer mesh\n");
+  return true;
+}
+
+bool MeshFile::addVertices(const vec3 *vertices, size_t count) {
+  vertexCount += count;
+  if (obj) {
+    for (size_t i = 0; i < count; i++)
+      fprintf(out, "v %.7g %.7g %.7g\n", vertices[i].x, vertices[i].y, vertices[i].z);
+    return !ferror(out);
+  }
+
+  // vec3 is three packed floats, the PLY vertex record as it is on little endian hosts
+  static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 is not packed");
+  return fwrite(vertices, sizeof(vec3), count, out) == count;
+}
+
+bool MeshFile::addTriangles(const uint32_t *indices, size_t count) {
+  triangleCount += count;
+  if (obj) {
+    for (size_t i = 0; i < count; i++)
+      fprintf(out, "f %u %u %u\n", indices[3 * i] + 1, indices[3 * i + 1] + 1, indices[3 * i + 2] + 1);
+    return !ferror(out);
+  }
+
+  // uchar count then three uints per face
+  std::vector<unsigned char> records(13 * count);
+  for (size_t i = 0; i < count; i++) {
+    records[13 * i] = 3;
+    std::memcpy(&records[13 * i + 1], &indices[3 * i], 3 * sizeof(uint32_t));
+  }
+  return fwrite(records.data(), 1, records.size(), faces) == records.size();
+}
+
+bool MeshFile::close() {
+  if (!out)
+    return false;
+
+  std::string partial = sideFileName("vertices");
+  bool ok = true;
+  if (!obj) {
+    partial = fileName + ".part";
+    FILE *file = fopen(partial.c_str(), "wb");
+    if (!file) {
+      fprintf(stderr, "Failed to open %s for writing.\n", partial.c_str());
+      discard();
+      return false;
+    }
+
+    fprintf(file, "ply\nformat binary_little_endian 1.0\n"
+                  "element vertex %llu\nproperty float x\nproperty float y\nproperty float z\n"
+                  "element face %llu\nproperty list uchar uint vertex_indices\nend_header\n",
+            (unsigned long long) vertexCount, (unsigned long long) triangleCount);
+    ok = copyFile(out, file) && copyFile(faces, file);
+    ok = fclose(file) == 0 && ok;
+  }
+
+  ok = fclose(out) == 0 && ok;
+  out = nullptr;
+  ok = ok && std::rename(partial.c_str(), fileName.c_str()) == 0;
+  if (!ok) {
+    std::cerr << "Failed to write " << fileName << "\n";
+    std::remove(partial.c_str());
+  }
+  discard();
+  return ok;
+}
@@ -0,0 +1,132 @@
+#include <cmath>
+#include <cstdio>
+#include "NoiseVolume.hh"
+
+namespace {
+
+const uint32_t NOISE_MAGIC = 0x314e424d; // "MBN1"
+
+// Edges of a cube, Perlin's improved noise gradients
+const vec3 gradients[12] = {
+    {1, 1, 0}, {-1, 1, 0}, {1, -1, 0}, {-1, -1, 0},
+    {1, 0, 1}, {-1, 0, 1}, {1, 0, -1}, {-1, 0, -1},
+    {0, 1, 1}, {0, -1, 1}, {0, 1, -1}, {0, -1, -1}
+};
+
+int wrap(int i, int n) {
+  return ((i % n) + n) % n;
+}
+
+// Integer hash of a lattice point taken modulo the period, which is what makes the noise tile
+uint32_t latticeHash(int x, int y, int z) {
+  uint32_t h = (uint32_t) wrap(x, NoiseVolume::PERIOD) * 73856093u
+      ^ (uint32_t) wrap(y, NoiseVolume::PERIOD) * 19349663u
+      ^ (uint32_t) wrap(z, NoiseVolume::PERIOD) * 83492791u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+float fade(float t) {
+  return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+float corner(int x, int y, int z, vec3 offset) {
+  return glm::dot(gradients[latticeHash(x, y, z) % 12], offset);
+}
+
+float periodicNoise(vec3 p) {
+  vec3 cell = glm::floor(p);
+  vec3 f = p - cell;
+  int x = (int) cell.x, y = (int) cell.y, z = (int) cell.z;
+  vec3 w = vec3(fade(f.x), fade(f.y), fade(f.z));
+
+  float x00 = glm::mix(corner(x, y, z, f), corner(x + 1, y, z, f - vec3(1, 0, 0)), w.x);
+  float x10 = glm::mix(corner(x, y + 1, z, f - vec3(0, 1, 0)), corner(x + 1, y + 1, z, f - vec3(1, 1, 0)), w.x);
+  float x01 = glm::mix(corner(x, y, z + 1, f - vec3(0, 0, 1)), corner(x + 1, y, z + 1, f - vec3(1, 0, 1)), w.x);
+  float x11 = glm::mix(corner(x, y + 1, z + 1, f - vec3(0, 1, 1)), corner(x + 1, y + 1, z + 1, f - vec3(1, 1, 1)), w.x);
+  return glm::mix(glm::mix(x00, x10, w.y), glm::mix(x01, x11, w.y), w.z);
+}
+
+}
+
+void NoiseVolume::bake() {
+  texels.resize((size_t) SIZE * SIZE * SIZE);
+  const float texelSize = (float) PERIOD / (float) SIZE;
+
+  // Texel centers, where GL_LINEAR returns the stored value. Gradient noise
+  // peaks around 0.7 where simplex noise reaches about 1, hence the scale.
+  size_t i = 0;
+  for (unsigned int z = 0; z < SIZE; z++) {
+    for (unsigned int y = 0; y < SIZE; y++) {
+      for (unsigned int x = 0; x < SIZE; x++) {
+        vec3 p = (vec3((float) x, (float) y, (float) z) + 0.5f) * texelSize;
+        float n = glm::clamp(1.4f * periodicNoise(p), -1.0f, 1.0f);
+        texels[i++] = (uint8_t) std::lround((0.5f * n + 0.5f) * 255.0f);
+      }
+    }
+  }
+}
+
+bool NoiseVolume::load(const std::string &fileName) {
+  FILE *file = fopen(fileName.c_str(), "rb");
+  if (!file)
+    return false;
+
+  uint32_t header[3];
+  std::vector<uint8_t> data((size_t) SIZE * SIZE * SIZE);
+  bool ok = fread(header, sizeof(header), 1, file) == 1
+      && header[0] == NOISE_MAGIC && header[1] == SIZE && header[2] == (uint32_t) PERIOD
+      && fread(data.data(), 1, data.size(), file) == data.size();
+  fclose(file);
+
+  if (ok)
+    texels.swap(data);
+  return ok;
+}
+
+bool NoiseVolume::save(const std::string &fileName) const {
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if (!file) {
+    fprintf(stderr, "Failed to open %s for writing.\n", fileName.c_str());
+    return false;
+  }
+
+  const uint32_t header[3] = {NOISE_MAGIC, SIZE, (uint32_t) PERIOD};
+  bool ok = fwrite(header, sizeof(header), 1, file) == 1
+      && fwrite(texels.data(), 1, texels.size(), file) == texels.size();
+  ok = fclose(file) == 0 && ok;
+  return ok;
+}
+
+float NoiseVolume::sample(vec3 p) const {
+
+  // Texel space with the centers on integers, then the 8 wrapped neighbours
+  vec3 t = p * ((float) SIZE / (float) PERIOD) - 0.5f;
+  vec3 base = glm::floor(t);
+  vec3 f = t - base;
+  int x0 = wrap((int) base.x, SIZE), y0 = wrap((int) base.y, SIZE), z0 = wrap((int) base.z, SIZE);
+  int x1 = (x0 + 1) % SIZE, y1 = (y0 + 1) % SIZE, z1 = (z0 + 1) % SIZE;
+
+  auto texel = [&](int x, int y, int z) {
+    return (float) texels[((size_t) z * SIZE + y) * SIZE + x] / 255.0f;
+  };
+
+  float c00 = glm::mix(texel(x0, y0, z0), texel(x1, y0, z0), f.x);
+  float c10 = glm::mix(texel(x0, y1, z0), texel(x1, y1, z0), f.x);
+  float c01 = glm::mix(texel(x0, y0, z1), texel(x1, y0, z1), f.x);
+  float c11 = glm::mix(texel(x0, y1, z1), texel(x1, y1, z1), f.x);
+  return 2.0f * glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z) - 1.0f;
+}
+
+const NoiseVolume &NoiseVolume::shared() {
+  static const NoiseVolume volume = [] {
+    NoiseVolume v;
+    v.bake();
+    return v;
+  }();
+  return volume;
+}
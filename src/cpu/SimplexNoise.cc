@@ -0,0 +1,105 @@
+//
+// Description : Array and textureless GLSL 2D/3D/4D simplex
+//               noise functions.
+//      Author : Ian McEwan, Ashima Arts.
+//  Maintainer : stegu
+//     Lastmod : 20110822 (ijm)
+//     License : Copyright (C) 2011 Ashima Arts. All rights reserved.
+//               Distributed under the MIT License. See LICENSE file.
+//               https://github.com/ashima/webgl-noise
+//               https://github.com/stegu/webgl-noise
+//
+// Ported from shaders/mandel_raymarch.frag, swizzles written out by hand.
+
+#include "SimplexNoise.hh"
+
+namespace {
+
+vec3 mod289(vec3 x) {
+  return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+}
+
+vec4 mod289(vec4 x) {
+  return x - glm::floor(x * (1.0f / 289.0f)) * 289.0f;
+}
+
+vec4 permute(vec4 x) {
+  return mod289(((x * 34.0f) + 1.0f) * x);
+}
+
+vec4 taylorInvSqrt(vec4 r) {
+  return 1.79284291400159f - 0.85373472095314f * r;
+}
+
+float step(float edge, float x) {
+  return x < edge ? 0.0f : 1.0f;
+}
+
+}
+
+float snoise(vec3 v) {
+  const vec2 C = vec2(1.0f / 6.0f, 1.0f / 3.0f);
+
+  // First corner
+  vec3 i = glm::floor(v + glm::dot(v, vec3(C.y)));
+  vec3 x0 = v - i + glm::dot(i, vec3(C.x));
+
+  // Other corners
+  vec3 g = vec3(step(x0.y, x0.x), step(x0.z, x0.y), step(x0.x, x0.z));
+  vec3 l = 1.0f - g;
+  vec3 i1 = vec3(glm::min(g.x, l.z), glm::min(g.y, l.x), glm::min(g.z, l.y));
+  vec3 i2 = vec3(glm::max(g.x, l.z), glm::max(g.y, l.x), glm::max(g.z, l.y));
+
+  vec3 x1 = x0 - i1 + C.x;
+  vec3 x2 = x0 - i2 + C.y; // 2.0*C.x = 1/3 = C.y
+  vec3 x3 = x0 - 0.5f;     // -1.0+3.0*C.x = -0.5 = -D.y
+
+  // Permutations
+  i = mod289(i);
+  vec4 p = permute(permute(permute(
+      i.z + vec4(0.0f, i1.z, i2.z, 1.0f))
+      + i.y + vec4(0.0f, i1.y, i2.y, 1.0f))
+      + i.x + vec4(0.0f, i1.x, i2.x, 1.0f));
+
+  // Gradients: 7x7 points over a square, mapped onto an octahedron.
+  // The ring size 17*17 = 289 is close to a multiple of 49 (49*6 = 294)
+  const float n_ = 0.142857142857f; // 1.0/7.0
+  vec3 ns = vec3(2.0f * n_, 0.5f * n_ - 1.0f, n_);
+
+  vec4 j = p - 49.0f * glm::floor(p * ns.z * ns.z);  //  mod(p,7*7)
+
+  vec4 x_ = glm::floor(j * ns.z);
+  vec4 y_ = glm::floor(j - 7.0f * x_);    // mod(j,N)
+
+  vec4 x = x_ * ns.x + ns.y;
+  vec4 y = y_ * ns.x + ns.y;
+  vec4 h = 1.0f - glm::abs(x) - glm::abs(y);
+
+  vec4 b0 = vec4(x.x, x.y, y.x, y.y);
+  vec4 b1 = vec4(x.z, x.w, y.z, y.w);
+
+  vec4 s0 = glm::floor(b0) * 2.0f + 1.0f;
+  vec4 s1 = glm::floor(b1) * 2.0f + 1.0f;
+  vec4 sh = -vec4(step(h.x, 0.0f), step(h.y, 0.0f), step(h.z, 0.0f), step(h.w, 0.0f));
+
+  vec4 a0 = vec4(b0.x, b0.z, b0.y, b0.w) + vec4(s0.x, s0.z, s0.y, s0.w) * vec4(sh.x, sh.x, sh.y, sh.y);
+  vec4 a1 = vec4(b1.x, b1.z, b1.y, b1.w) + vec4(s1.x, s1.z, s1.y, s1.w) * vec4(sh.z, sh.z, sh.w, sh.w);
+
+  vec3 p0 = vec3(a0.x, a0.y, h.x);
+  vec3 p1 = vec3(a0.z, a0.w, h.y);
+  vec3 p2 = vec3(a1.x, a1.y, h.z);
+  vec3 p3 = vec3(a1.z, a1.w, h.w);
+
+  // Normalise gradients
+  vec4 norm = taylorInvSqrt(vec4(glm::dot(p0, p0), glm::dot(p1, p1), glm::dot(p2, p2), glm::dot(p3, p3)));
+  p0 *= norm.x;
+  p1 *= norm.y;
+  p2 *= norm.z;
+  p3 *= norm.w;
+
+  // Mix final noise value
+  vec4 m = glm::max(0.6f - vec4(glm::dot(x0, x0), glm::dot(x1, x1), glm::dot(x2, x2), glm::dot(x3, x3)), vec4(0.0f));
+  m = m * m;
+  return 42.0f * glm::dot(m * m, vec4(glm::dot(p0, x0), glm::dot(p1, x1),
+                                       glm::dot(p2, x2), glm::dot(p3, x3)));
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include "ThreadPool.hh"
+
+namespace {
+
+// Index of the pool worker running on this thread, -1 elsewhere
+thread_local int currentWorker = -1;
+thread_local const ThreadPool *currentPool = nullptr;
+
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) : nextQueue(0), queued(0), pending(0) {
+  if (threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  for (unsigned int i = 0; i < threadCount; ++i)
+    queues.emplace_back(new WorkQueue());
+
+  for (unsigned int i = 0; i < threadCount; ++i)
+    workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wakeCondition.notify_all();
+
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::submit(Task task) {
+  unsigned int index;
+  if (currentPool == this && currentWorker >= 0)
+    index = (unsigned int) currentWorker;
+  else
+    index = nextQueue++ % (unsigned int) queues.size();
+
+  pending++;
+  {
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->tasks.push_back(std::move(task));
+    queued++;
+  }
+
+  // Pass through the sleep mutex so a worker about to wait cannot miss it
+  { std::lock_guard<std::mutex> lock(sleepMutex); }
+  wakeCondition.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(sleepMutex);
+  doneCondition.wait(lock, [this] { return pending == 0; });
+}
+
+bool ThreadPool::popTask(unsigned int index, Task &task) {
+
+  // Own work first, newest task for cache locality
+  {
+    WorkQueue &own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued--;
+      return true;
+    }
+  }
+
+  // Steal the oldest task from the others
+  auto count = (unsigned int) queues.size();
+  for (unsigned int offset = 1; offset < count; ++offset) {
+    WorkQueue &victim = *queues[(index + offset) % count];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ThreadPool::workerLoop(unsigned int index) {
+  currentWorker = (int) index;
+  currentPool = this;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      wakeCondition.wait(lock, [this] { return queued > 0 || stopping; });
+      if (stopping && queued == 0)
+        return;
+    }
+
+    Task task;
+    if (!popTask(index, task))
+      continue; // Someone else got there first
+
+    task();
+
+    if (--pending == 0) {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      doneCondition.notify_all();
+    }
+  }
+}
@@ -13,12 +13,27 @@
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <cfloat>
+#include <mutex>
+#include <vector>
 
 // Data
 static GLFWwindow*  g_Window = NULL;
 static double       g_Time = 0.0f;
+
+// Input gathered on the main thread by the callbacks and PollInput(), handed to ImGui by NewFrame() on the render thread
+static std::mutex   g_InputMutex;
 static bool         g_MouseJustPressed[3] = { false, false, false };
 static float        g_MouseWheel = 0.0f;
+static bool         g_KeysDown[512] = {};
+static std::vector<unsigned short> g_InputCharacters;
+static int          g_WindowSize[2] = { 0, 0 }, g_FramebufferSize[2] = { 0, 0 };
+static bool         g_Focused = false;
+static double       g_CursorPos[2] = { 0.0, 0.0 };
+static bool         g_MouseButtons[3] = { false, false, false };
+static bool         g_MouseDrawCursor = false;
+static bool         g_MoveCursor = false;
+static ImVec2       g_MoveCursorTo;
 static GLuint       g_FontTexture = 0;
 static int          g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
@@ -144,35 +159,54 @@ static void ImGui_ImplGlfwGL3_SetClipboardText(void* user_data, const char* text
 
 void ImGui_ImplGlfwGL3_MouseButtonCallback(GLFWwindow*, int button, int action, int /*mods*/)
 {
+    std::lock_guard<std::mutex> lock(g_InputMutex);
     if (action == GLFW_PRESS && button >= 0 && button < 3)
         g_MouseJustPressed[button] = true;
 }
 
 void ImGui_ImplGlfwGL3_ScrollCallback(GLFWwindow*, double /*xoffset*/, double yoffset)
 {
+    std::lock_guard<std::mutex> lock(g_InputMutex);
     g_MouseWheel += (float)yoffset; // Use fractional mouse wheel.
 }
 
 void ImGui_ImplGlfwGL3_KeyCallback(GLFWwindow*, int key, int, int action, int mods)
 {
-    ImGuiIO& io = ImGui::GetIO();
+    (void)mods; // Modifiers are not reliable across systems, they come from KeysDown in NewFrame()
+    if (key < 0 || key >= 512)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_InputMutex);
     if (action == GLFW_PRESS)
-        io.KeysDown[key] = true;
+        g_KeysDown[key] = true;
     if (action == GLFW_RELEASE)
-        io.KeysDown[key] = false;
-
-    (void)mods; // Modifiers are not reliable across systems
-    io.KeyCtrl = io.KeysDown[GLFW_KEY_LEFT_CONTROL] || io.KeysDown[GLFW_KEY_RIGHT_CONTROL];
-    io.KeyShift = io.KeysDown[GLFW_KEY_LEFT_SHIFT] || io.KeysDown[GLFW_KEY_RIGHT_SHIFT];
-    io.KeyAlt = io.KeysDown[GLFW_KEY_LEFT_ALT] || io.KeysDown[GLFW_KEY_RIGHT_ALT];
-    io.KeySuper = io.KeysDown[GLFW_KEY_LEFT_SUPER] || io.KeysDown[GLFW_KEY_RIGHT_SUPER];
+        g_KeysDown[key] = false;
 }
 
 void ImGui_ImplGlfwGL3_CharCallback(GLFWwindow*, unsigned int c)
 {
-    ImGuiIO& io = ImGui::GetIO();
+    std::lock_guard<std::mutex> lock(g_InputMutex);
     if (c > 0 && c < 0x10000)
-        io.AddInputCharacter((unsigned short)c);
+        g_InputCharacters.push_back((unsigned short)c);
+}
+
+void ImGui_ImplGlfwGL3_PollInput()
+{
+    std::lock_guard<std::mutex> lock(g_InputMutex);
+    glfwGetWindowSize(g_Window, &g_WindowSize[0], &g_WindowSize[1]);
+    glfwGetFramebufferSize(g_Window, &g_FramebufferSize[0], &g_FramebufferSize[1]);
+    g_Focused = glfwGetWindowAttrib(g_Window, GLFW_FOCUSED) != 0;
+    if (g_MoveCursor)
+    {
+        glfwSetCursorPos(g_Window, (double)g_MoveCursorTo.x, (double)g_MoveCursorTo.y);
+        g_MoveCursor = false;
+    }
+    glfwGetCursorPos(g_Window, &g_CursorPos[0], &g_CursorPos[1]);
+    for (int i = 0; i < 3; i++)
+        g_MouseButtons[i] = glfwGetMouseButton(g_Window, i) != 0;
+
+    // Hide OS mouse cursor if ImGui is drawing it
+    glfwSetInputMode(g_Window, GLFW_CURSOR, g_MouseDrawCursor ? GLFW_CURSOR_HIDDEN : GLFW_CURSOR_NORMAL);
 }
 
 bool ImGui_ImplGlfwGL3_CreateFontsTexture()
@@ -360,12 +394,11 @@ void ImGui_ImplGlfwGL3_NewFrame()
         ImGui_ImplGlfwGL3_CreateDeviceObjects();
 
     ImGuiIO& io = ImGui::GetIO();
+    std::lock_guard<std::mutex> lock(g_InputMutex);
 
     // Setup display size (every frame to accommodate for window resizing)
-    int w, h;
-    int display_w, display_h;
-    glfwGetWindowSize(g_Window, &w, &h);
-    glfwGetFramebufferSize(g_Window, &display_w, &display_h);
+    int w = g_WindowSize[0], h = g_WindowSize[1];
+    int display_w = g_FramebufferSize[0], display_h = g_FramebufferSize[1];
     io.DisplaySize = ImVec2((float)w, (float)h);
     io.DisplayFramebufferScale = ImVec2(w > 0 ? ((float)display_w / w) : 0, h > 0 ? ((float)display_h / h) : 0);
 
@@ -375,18 +408,27 @@ void ImGui_ImplGlfwGL3_NewFrame()
     g_Time = current_time;
 
     // Setup inputs
-    // (we already got mouse wheel, keyboard keys & characters from glfw callbacks polled in glfwPollEvents())
-    if (glfwGetWindowAttrib(g_Window, GLFW_FOCUSED))
+    // (gathered on the main thread from the glfw callbacks and ImGui_ImplGlfwGL3_PollInput())
+    for (int i = 0; i < 512; i++)
+        io.KeysDown[i] = g_KeysDown[i];
+    io.KeyCtrl = io.KeysDown[GLFW_KEY_LEFT_CONTROL] || io.KeysDown[GLFW_KEY_RIGHT_CONTROL];
+    io.KeyShift = io.KeysDown[GLFW_KEY_LEFT_SHIFT] || io.KeysDown[GLFW_KEY_RIGHT_SHIFT];
+    io.KeyAlt = io.KeysDown[GLFW_KEY_LEFT_ALT] || io.KeysDown[GLFW_KEY_RIGHT_ALT];
+    io.KeySuper = io.KeysDown[GLFW_KEY_LEFT_SUPER] || io.KeysDown[GLFW_KEY_RIGHT_SUPER];
+    for (unsigned short c : g_InputCharacters)
+        io.AddInputCharacter(c);
+    g_InputCharacters.clear();
+
+    if (g_Focused)
     {
         if (io.WantMoveMouse)
         {
-            glfwSetCursorPos(g_Window, (double)io.MousePos.x, (double)io.MousePos.y);   // Set mouse position if requested by io.WantMoveMouse flag (used when io.NavMovesTrue is enabled by user and using directional navigation)
+            g_MoveCursor = true;   // Set mouse position if requested by io.WantMoveMouse flag (used when io.NavMovesTrue is enabled by user and using directional navigation)
+            g_MoveCursorTo = io.MousePos;
         }
         else
         {
-            double mouse_x, mouse_y;
-            glfwGetCursorPos(g_Window, &mouse_x, &mouse_y);
-            io.MousePos = ImVec2((float)mouse_x, (float)mouse_y);   // Get mouse position in screen coordinates (set to -1,-1 if no mouse / on another screen, etc.)
+            io.MousePos = ImVec2((float)g_CursorPos[0], (float)g_CursorPos[1]);   // Get mouse position in screen coordinates (set to -1,-1 if no mouse / on another screen, etc.)
         }
     }
     else
@@ -397,15 +439,14 @@ void ImGui_ImplGlfwGL3_NewFrame()
     for (int i = 0; i < 3; i++)
     {
         // If a mouse press event came, always pass it as "mouse held this frame", so we don't miss click-release events that are shorter than 1 frame.
-        io.MouseDown[i] = g_MouseJustPressed[i] || glfwGetMouseButton(g_Window, i) != 0;
+        io.MouseDown[i] = g_MouseJustPressed[i] || g_MouseButtons[i];
         g_MouseJustPressed[i] = false;
     }
 
     io.MouseWheel = g_MouseWheel;
     g_MouseWheel = 0.0f;
 
-    // Hide OS mouse cursor if ImGui is drawing it
-    glfwSetInputMode(g_Window, GLFW_CURSOR, io.MouseDrawCursor ? GLFW_CURSOR_HIDDEN : GLFW_CURSOR_NORMAL);
+    g_MouseDrawCursor = io.MouseDrawCursor;
 
     // Start the frame. This call will update the io.WantCaptureMouse, io.WantCaptureKeyboard flag that you can use to dispatch inputs (or not) to your application.
     ImGui::NewFrame();
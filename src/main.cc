@@ -1,22 +1,57 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <GL/glew.h>
 #include "utils.hh"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "Window.hh"
 #include "types.hh"
+#include "Accumulation.hh"
+#include "Benchmark.hh"
 #include "Camera.hh"
+#include "ConePrepass.hh"
+#include "DistanceEstimator.hh"
+#include "DistanceGrid.hh"
+#include "DynamicResolution.hh"
+#include "FileWatcher.hh"
+#include "FractalUniforms.hh"
+#include "FrameCapture.hh"
+#include "Keyframes.hh"
+#include "MarchStats.hh"
+#include "NoiseVolume.hh"
+#include "Profiler.hh"
+#include "RenderTarget.hh"
+#include "ShaderCache.hh"
+#include "ShadowPass.hh"
+#include "TripleBuffer.hh"
+#include "UniformBlocks.hh"
+#include "UniformBuffer.hh"
 #include <imgui.h>
 #include <GLFW/glfw3.h>
 
 // Declarations
+struct Scene;
 void resizeCallback(GLFWwindow *win, int w, int h);
 void processInput(GLFWwindow *window);
 void display();
+void finishRendering();
 void renderGui();
 void setGuiStyle();
+void setupShader(GLuint program);
+void appendKeyframe();
+void seedNextKeyframe();
+void loadNoiseVolume();
+void uploadDistanceGrid();
+void takeScreenshot();
+void renderShaderErrors();
+void publishScene();
+void takeScene(const Scene &scene);
+void setBenchmarkFrame();
+void finishBenchmarkFrame(double frameStart, bool ready);
 
-float STEP_SIZE = 0.001f;
 unsigned int INITIAL_WIDTH = 800;
 unsigned int INITIAL_HEIGHT = 640;
 
@@ -30,97 +65,14 @@ float FAR_PLANE = 100.0f;
 
 float FOV = 50.0f;
 
-struct FractalUniforms {
-
-  // Renderer
-  float maxRaySteps = 1000.0;
-  float baseMinDistance = 0.00001;
-  float minDistance = baseMinDistance;
-  int minDistanceFactor = 0;
-  int fractalIters = 100;
-  float bailLimit = 5.0;
-
-  // Mandelbulb
-  float power = 8.0;
-  int derivativeBias = 1;
-  bool julia = false;
-  vec3 juliaC = vec3(0.86, 0.23, -0.5);
-
-  // Box
-  int boxFoldFactor = 1;
-  float boxFoldingLimit = 1.0;
-
-  // Sphere
-  int sphereFoldFactor = 1;
-  float sphereMinRadius = 0.01;
-  float sphereFixedRadius = 2.0;
-  bool sphereMinTimeVariance = false;
-
-  // Mandelbox
-  int mandelBoxFactor = 1;
-  float mandelBoxScale = 1.2;
-
-  // Tetra
-  int tetraFactor = 1;
-  float tetraScale = 1.0;
-
-  float fudgeFactor = 1.0;
-  float noiseFactor = 0.5;
-  vec3 bgColor = vec3(0.8, 0.85, 1.0);
-  vec3 glowColor = vec3(0.75, 0.9, 1.0);
-  float glowFactor = 1.0;
-  bool showBgGradient = true;
-
-  vec4 orbitStrength = vec4(-1.0, -1.8, -1.4, 1.3);
-  vec3 otColor0 = vec3(0.3, 0.5, 0.2);
-  vec3 otColor1 = vec3(0.6, 0.2, 0.5);
-  vec3 otColor2 = vec3(0.25, 0.7, 0.9);
-  vec3 otColor3 = vec3(0.2, 0.45, 0.25);
-  vec3 otColorBase = vec3(0.3, 0.6, 0.3);
-  float otBaseStrength = 0.5;
-  float otDist0to1 = 0.3;
-  float otDist1to2 = 1.0;
-  float otDist2to3 = 0.4;
-  float otDist3to0 = 0.2;
-  float otCycleIntensity = 5.0;
-  float otPaletteOffset = 0.0;
-
-  int shadowRayMinStepsTaken = 5;
-  vec3 lightPos = vec3(3.0, 3.0, 10.0);
-  float shadowBrightness = 0.2f;
-  bool lightSource = true;
-  float phongShadingMixFactor = 1.0;
-  float ambientIntensity = 1.0;
-  float diffuseIntensity = 1.0;
-  float specularIntensity = 1.0;
-  float shininess = 32.0;
-  bool gammaCorrection = false;
-};
-
-// App state
-struct AppState {
-  bool mandelbulbOn = true;
-  bool boxFoldingOn = false;
-  bool sphereFoldingOn = false;
-  bool mandelBoxOn = false;
-  bool recursiveTetraOn = false;
-
-  bool lowOtCycleIntensity = false;
-
-  bool logCoordinates = false;
-  bool weakSettings = false;
-  int nbFrames = 0;
-  int displayedFrames = 0;
-  float displayedMS = 0;
-  double lastTime = (float) glfwGetTime();
+GLuint shader = 0;
+GLint timeLocation = -1;
+GLint jitterLocation = -1;
+ShaderCache shaders("../shaders/mandel_raymarch.vert", "../shaders/mandel_raymarch.frag", setupShader);
+unsigned int shaderGeneration = 0;
 
-  bool showGui = true;
-  float timeSinceLastGuiToggle = 0.0f;
-};
-
-bool shouldUpdateCoordinates = true; // True initially to first set spherical to cartesian
-
-GLuint shader;
+// Saving a shader reloads it, L does the same by hand
+FileWatcher shaderWatcher;
 GLuint vbo, vao;
 GLFWwindow *window;
 
@@ -131,33 +83,138 @@ const GLfloat quadArray[4][2] = {
     {1.0f, 1.0f}
 };
 mat4x2 quad = glm::make_mat4x2(&quadArray[0][0]);
-mat4 inverseVP;
+dmat4 inverseVP;
 
 GLfloat currentTime = 0.0;
 auto screenSize = vec2(INITIAL_WIDTH, INITIAL_HEIGHT);
 GLfloat screenRatio = screenSize.x / screenSize.y;
 
-auto windowAdapter = Window(INITIAL_WIDTH, INITIAL_HEIGHT);
+Window windowAdapter(INITIAL_WIDTH, INITIAL_HEIGHT);
 auto cam = Camera(INITIAL_WIDTH, INITIAL_HEIGHT, NEAR_PLANE, FAR_PLANE);
 FractalUniforms u;
 AppState state;
 
+/**
+ * What input on the main thread hands the render thread each tick. Key presses
+ * that act on the render thread's side are counted, it acts on new counts.
+ */
+struct Scene {
+  Camera cam = Camera(INITIAL_WIDTH, INITIAL_HEIGHT, NEAR_PLANE, FAR_PLANE);
+  unsigned int width = INITIAL_WIDTH;
+  unsigned int height = INITIAL_HEIGHT;
+  bool showGui = true;
+  double inputTime = 0.0; // glfwGetTime() of the tick, where input to present latency starts
+  unsigned int screenshotRequests = 0;
+  unsigned int reloadRequests = 0;
+};
+
+// Main thread. The camera takes its controls from the GUI through cameraControls.
+Scene inputScene;
+bool shouldUpdateCoordinates = true; // True initially to first set spherical to cartesian
+double timeSinceLastGuiToggle = 0.0;
+double timeSinceLastScreenshot = 0.0;
+bool reloadKeyHeld = false;
+
+// Newest scene from the main thread, and the camera controls and surface distance back from the render thread
+TripleBuffer<Scene> scenes;
+TripleBuffer<Camera> cameraControls(inputScene.cam);
+
+// Render thread, requests already acted on
+unsigned int screenshotRequests = 0;
+unsigned int reloadRequests = 0;
+
+// Raymarching goes to an offscreen target scaled to the frame time budget
+DynamicResolution dynamicResolution;
+RenderTarget renderTarget;
+unsigned int renderWidth = INITIAL_WIDTH, renderHeight = INITIAL_HEIGHT;
+
+// Averages jittered samples into the render target while nothing changes
+Accumulation accumulation;
+
+// Safe ray starts per pixel block, marched before the full resolution pass
+ConePrepass conePrepass;
+GLint coneTimeLocation = -1;
+
+// Shadows at a fraction of the resolution, marched from the raymarch pass's hits
+ShadowPass shadowPass;
+GLint shadowTimeLocation = -1;
+
+// Camera of the frame whose hit distances are in the render target's history
+dmat4 historyInverseVP;
+vec2 historySize;
+bool historyValid = false;
+
+// Keyframes for mandelbulb-animate, two seconds apart at 30 fps
+const char *KEYFRAME_FILE = "keyframes.keys";
+unsigned int nextKeyframe = 0;
+bool nextKeyframeSeeded = false;
+
+// Uploaded only when the packed contents change
+UniformBuffer cameraBuffer("Camera", 0, sizeof(CameraBlock));
+UniformBuffer fractalBuffer("FractalUniforms", 1, sizeof(FractalBlock));
+
+// Frame totals of the raymarch pass, counted while u.marchStats is on
+MarchStats marchStats(0);
+
+// Baked once and reused from this file on later starts
+const char *NOISE_VOLUME_FILE = "noise_volume.bin";
+GLuint noiseTexture = 0;
+
+// DE lower bounds for empty-space skipping, rebuilt in the background when the formula changes
+DistanceGrid distanceGrid;
+GLuint distanceGridTexture = 0;
+
+// Capture
+FrameCapture frameCapture;
+char imageTarget[256] = "capture_%05u.png";
+char videoTarget[256] = "capture.y4m";
+int captureFps = 30;
+unsigned int screenshots = 0;
+
+// --benchmark, replayed until done and then the program quits
+BenchmarkSuite benchmark;
+std::string benchmarkOutput;
+
 int main(int argc, char *argv[]) {
 
   // Handle args
-  int OK = utils::handleArgs(argc, argv, state.logCoordinates, state.weakSettings);
+  std::string recordTarget;
+  utils::BenchmarkArgs benchmarkArgs;
+  utils::PacingArgs pacingArgs;
+  int OK = utils::handleArgs(argc, argv, state.logCoordinates, state.weakSettings, recordTarget, benchmarkArgs,
+                             pacingArgs);
   if (OK < 0) return -1;
 
-  if (state.weakSettings) {
-    u.maxRaySteps = 200.0;
-    u.fractalIters = 20;
-    u.minDistanceFactor = 3;
-    u.power = 6.0;
+  FramePacing &pacing = windowAdapter.getPacing();
+  if (!pacingArgs.swapMode.empty() && !FramePacing::parseSwapMode(pacingArgs.swapMode, pacing.swapMode)) {
+    std::cerr << "Unknown swap mode " << pacingArgs.swapMode << "\n";
+    return EXIT_FAILURE;
+  }
+  pacing.maxFPS = pacingArgs.maxFPS;
+  pacing.framesInFlight = pacingArgs.framesInFlight;
+  pacing.logLatency = pacingArgs.logLatency;
+
+  // Before anything is printed, recording to stdout moves the rest over to stderr
+  if (!recordTarget.empty() && !frameCapture.start(CAPTURE_Y4M, recordTarget, captureFps))
+    return EXIT_FAILURE;
+
+  if (state.weakSettings)
+    u.applyWeakSettings();
+
+  // Nothing that adapts to frame times or stops rendering once converged, the GUI is not timed
+  if (!benchmarkArgs.output.empty()) {
+    if (!benchmark.init(benchmarkArgs.presets, benchmarkArgs.paths, u, state))
+      return EXIT_FAILURE;
+    benchmarkOutput = benchmarkArgs.output;
+    dynamicResolution.enabled = false;
+    accumulation.enabled = false;
+    inputScene.showGui = false;
   }
 
   utils::printInstructions();
 
   auto glfwOk = windowAdapter.init(resizeCallback, processInput, display);
+  windowAdapter.setShutdownFunc(finishRendering);
   auto err = glewInit();
 
   if (!glfwOk)
@@ -170,7 +227,17 @@ int main(int argc, char *argv[]) {
 
   glDisable(GL_DEPTH_TEST);
 
-  shader = utils::loadShaders("../shaders/mandel_raymarch.vert", "../shaders/mandel_raymarch.frag");
+  cameraBuffer.init();
+  fractalBuffer.init();
+  marchStats.init();
+  shaders.setCompileContext(windowAdapter.getCompileContext());
+  shaders.load();
+  if (!shaders.canSpecialize())
+    state.specializedShaders = false;
+  shaderWatcher.watch(shaders.getVertFileName());
+  shaderWatcher.watch(shaders.getFragFileName());
+  loadNoiseVolume();
+
   glGenVertexArrays(1, &vao);
   glBindVertexArray(vao);
 
@@ -184,12 +251,31 @@ int main(int argc, char *argv[]) {
   // Enable attribute index 0 as being used
   glEnableVertexAttribArray(0);
 
+  publishScene();
   windowAdapter.display();
   return 0;
 }
 
+/**
+ * Render thread, after the last frame
+ */
+void finishRendering() {
+  // Flushes frames still being read back and finishes the file, whichever way the loop ended
+  if (frameCapture.active())
+    frameCapture.stop();
+  shaders.shutdown();
+}
+
 void display() {
-  currentTime = (float) glfwGetTime();
+  double frameStart = glfwGetTime();
+  currentTime = (float) frameStart;
+
+  // The newest input, the scene stays the same for the whole frame
+  if (scenes.update())
+    takeScene(scenes.read());
+  const Scene &scene = scenes.read();
+  FramePacing &pacing = windowAdapter.getPacing();
+  pacing.setInputTime(scene.inputTime);
 
   if (state.logCoordinates) {
     cam.printCoordinates();
@@ -198,107 +284,480 @@ void display() {
 
   // Perfomance calculations
   state.nbFrames++;
-  if (currentTime - state.lastTime >= 1.0) {
+  if (frameStart - state.lastTime >= 1.0) {
     state.displayedMS = (float) 1000.0 / float(state.nbFrames);
     state.displayedFrames = state.nbFrames;
     state.nbFrames = 0;
     state.lastTime += 1.0;
-  }
 
-  if (shouldUpdateCoordinates) {
-
-    // Calculate centered view matrix every frame for locked spherical coord controls
-    if (!cam.freeControlsActive) {
-      cam.sphericalToCartesian();
-      cam.eye = vec3(cam.y, cam.x, cam.z);
-      cam.updateCenteredViewMatrix();
+    if (u.marchStats && marchStats.hasResults()) {
+      const MarchCounters &c = marchStats.getLatest();
+      printf("March stats: %u rays, %.1f avg steps, %u max steps, %.1f%% escaped, %llu DE calls (%llu normal, %llu shadow)\n",
+             c.rays, c.averageSteps(), c.maxMarchSteps, 100.0 * c.escapedFraction(),
+             (unsigned long long) c.totalDECalls(), (unsigned long long) c.totalNormalDECalls(),
+             (unsigned long long) c.totalShadowDECalls());
+      fflush(stdout);
     }
 
-    inverseVP = glm::inverse(cam.projectionMatrix * cam.viewMatrix);
+    if (!benchmark.done()) {
+      printf("Benchmark: %s\n", benchmark.status().c_str());
+      fflush(stdout);
+    }
 
-    shouldUpdateCoordinates = false;
+    if (pacing.logLatency) {
+      printf("Latency: %.1f ms avg, %.1f ms max at %d fps (swap %s, %d in flight, cap %d)\n", pacing.getLatencyMS(),
+             pacing.getMaxLatencyMS(), state.displayedFrames, FramePacing::swapModeName(pacing.swapMode),
+             pacing.framesInFlight, pacing.maxFPS);
+      fflush(stdout);
+    }
   }
 
-  if (state.showGui) {
+  bool benchmarking = !benchmark.done();
+  if (benchmarking)
+    setBenchmarkFrame();
+
+  // Resolution for this frame from the previous frame times. Held while
+  // accumulating, a new scale would throw away the samples so far.
+  float frameMS = state.lastFrameTime > 0.0 ? (float) (1000.0 * (frameStart - state.lastFrameTime)) : 0.0f;
+  state.lastFrameTime = frameStart;
+  float renderScale = accumulation.sampleCount() > 1 ? dynamicResolution.getScale() : dynamicResolution.update(frameMS);
+  renderWidth = std::max(1u, (unsigned int) std::lround(screenSize.x * renderScale));
+  renderHeight = std::max(1u, (unsigned int) std::lround(screenSize.y * renderScale));
+
+  inverseVP = glm::inverse(cam.projectionMatrix * cam.viewMatrix);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, (GLsizei) screenSize.x, (GLsizei) screenSize.y);
+
+  if (scene.showGui) {
     setGuiStyle();
     renderGui();
   }
+  if (!shaders.getErrors().empty())
+    renderShaderErrors();
+
+  bool deferShadows = u.lightSource && u.shadowScale > 1;
+  bool offscreen = dynamicResolution.enabled || accumulation.enabled || u.reprojection || deferShadows;
+  if (offscreen && renderTarget.reserve((unsigned int) screenSize.x, (unsigned int) screenSize.y))
+    historyValid = false;
+
+  // Deep zoom rebases the camera on the eye, the floats only hold offsets from it
+  dmat4 viewProjection = cam.projectionMatrix * cam.viewMatrix;
+  dvec3 reference = state.deepZoom ? cam.getPosition() : dvec3(0.0);
+  dmat4 fromReference = glm::translate(dmat4(1.0), reference);
+  CameraBlock cameraBlock = packCameraBlock(mat4(glm::inverse(viewProjection * fromReference)),
+                                            mat4(viewProjection * fromReference),
+                                            state.deepZoom ? vec3(0.0f) : vec3(cam.eye),
+                                            NEAR_PLANE, FAR_PLANE, vec2(renderWidth, renderHeight));
+  if (offscreen && u.reprojection && historyValid && !state.deepZoom)
+    packReprojection(cameraBlock, u, mat4(historyInverseVP), historySize);
+  if (u.conePrepass)
+    packConePrepass(cameraBlock, u.coneBlockSize);
+  if (deferShadows)
+    packShadowPass(cameraBlock, u.shadowScale);
+  FractalBlock fractalBlock = packFractalBlock(u, state);
+
+  // Positions in deep zoom are relative to the eye and the beat changes the DE every
+  // frame, neither fits a grid in world space. A stale grid is not used while the new one builds.
+  bool gridReady = true;
+  if (u.distanceGrid && !state.deepZoom && !u.sphereMinTimeVariance) {
+    DistanceEstimator de(u, state, 0.0f);
+    distanceGrid.request(de);
+    if (distanceGrid.poll())
+      uploadDistanceGrid();
+    gridReady = distanceGrid.matches(de);
+    if (gridReady)
+      packDistanceGrid(fractalBlock, distanceGrid.getExtent());
+  }
+
+  // The double-float iterations only exist for the integer power Mandelbulb on its own
+  cam.surfaceDistance = 0.0;
+  if (state.deepZoom) {
+    bool mandelbulbOnly = state.mandelbulbOn && !state.boxFoldingOn && !state.sphereFoldingOn
+        && !state.mandelBoxOn && !state.recursiveTetraOn && u.integerPower() > 0;
+    packDeepZoom(cameraBlock, reference, mandelbulbOnly && state.specializedShaders ? u.deepIterations : 0);
+
+    // Hits and zoom steps shrink with the distance to the surface instead of bottoming out
+    DistanceEstimator de(u, state, currentTime);
+    float pixelAngle = (float) (2.0 / (cam.projectionMatrix[1][1] * renderHeight));
+    fractalBlock.minDistance = de.deepMinDistance(reference, pixelAngle);
+    cam.surfaceDistance = de.estimate(reference);
+  }
 
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  // Uber-shader until the permutation for this formula set has compiled
+  if (shaderWatcher.poll())
+    shaders.reload();
+  shaders.poll();
+  marchStats.poll();
+  GLuint program = state.specializedShaders ? shaders.programFor(u, state) : shaders.uberProgram();
+  bool sceneChanged = program != shader || shaders.getGeneration() != shaderGeneration;
+  if (sceneChanged) {
+    shaderGeneration = shaders.getGeneration();
+    shader = program;
+    timeLocation = glGetUniformLocation(shader, "u_time");
+    jitterLocation = glGetUniformLocation(shader, "u_jitter");
+    coneTimeLocation = glGetUniformLocation(shaders.conePrepassProgram(), "u_time");
+    shadowTimeLocation = glGetUniformLocation(shaders.shadowPassProgram(), "u_time");
+  }
 
   glUseProgram(shader);
-  glUniformMatrix4fv(glGetUniformLocation(shader, "u_inverseVP"), 1, GL_FALSE, glm::value_ptr(inverseVP));
-  glUniform1fv(glGetUniformLocation(shader, "u_nearPlane"), 1, &NEAR_PLANE);
-  glUniform1fv(glGetUniformLocation(shader, "u_farPlane"), 1, &FAR_PLANE);
-  glUniform1fv(glGetUniformLocation(shader, "u_time"), 1, &currentTime);
-  glUniform1fv(glGetUniformLocation(shader, "u_screenRatio"), 1, &screenRatio);
-  glUniform2fv(glGetUniformLocation(shader, "u_screenSize"), 1, glm::value_ptr(screenSize));
-  glUniform1fv(glGetUniformLocation(shader, "u_stepSize"), 1, &STEP_SIZE);
-
-  // Renderer
-  glUniform1fv(glGetUniformLocation(shader, "u_maxRaySteps"), 1, &u.maxRaySteps);
-  glUniform1fv(glGetUniformLocation(shader, "u_minDistance"), 1, &u.minDistance);
-  glUniform1i(glGetUniformLocation(shader, "u_fractalIters"), u.fractalIters);
-  glUniform1fv(glGetUniformLocation(shader, "u_bailLimit"), 1, &u.bailLimit);
-
-  // Fractals
-  glUniform1i(glGetUniformLocation(shader, "u_mandelbulbOn"), state.mandelbulbOn);
-  glUniform1i(glGetUniformLocation(shader, "u_derivativeBias"), u.derivativeBias);
-  glUniform1fv(glGetUniformLocation(shader, "u_power"), 1, &u.power);
-  glUniform1i(glGetUniformLocation(shader, "u_julia"), u.julia);
-  glUniform3fv(glGetUniformLocation(shader, "u_juliaC"), 1, glm::value_ptr(u.juliaC));
-
-  glUniform1i(glGetUniformLocation(shader, "u_boxFoldFactor"), state.boxFoldingOn ? u.boxFoldFactor : 0);
-  glUniform1fv(glGetUniformLocation(shader, "u_boxFoldingLimit"), 1, &u.boxFoldingLimit);
-
-  glUniform1i(glGetUniformLocation(shader, "u_sphereFoldFactor"), state.sphereFoldingOn ? u.sphereFoldFactor : 0);
-  glUniform1fv(glGetUniformLocation(shader, "u_sphereMinRadius"), 1, &u.sphereMinRadius);
-  glUniform1fv(glGetUniformLocation(shader, "u_sphereFixedRadius"), 1, &u.sphereFixedRadius);
-  glUniform1i(glGetUniformLocation(shader, "u_sphereMinTimeVariance"), u.sphereMinTimeVariance);
-
-  glUniform1i(glGetUniformLocation(shader, "u_mandelBoxOn"), state.mandelBoxOn);
-  glUniform1fv(glGetUniformLocation(shader, "u_mandelBoxScale"), 1, &u.mandelBoxScale);
-
-  glUniform1i(glGetUniformLocation(shader, "u_tetraFactor"), state.recursiveTetraOn ? u.tetraFactor : 0);
-  glUniform1fv(glGetUniformLocation(shader, "u_tetraScale"), 1, &u.tetraScale);
-
-  // Graphics
-  glUniform4fv(glGetUniformLocation(shader, "u_orbitStrength"), 1, glm::value_ptr(u.orbitStrength));
-  glUniform3fv(glGetUniformLocation(shader, "u_color0"), 1, glm::value_ptr(u.otColor0));
-  glUniform3fv(glGetUniformLocation(shader, "u_color1"), 1, glm::value_ptr(u.otColor1));
-  glUniform3fv(glGetUniformLocation(shader, "u_color2"), 1, glm::value_ptr(u.otColor2));
-  glUniform3fv(glGetUniformLocation(shader, "u_color3"), 1, glm::value_ptr(u.otColor3));
-  glUniform3fv(glGetUniformLocation(shader, "u_colorBase"), 1, glm::value_ptr(u.otColorBase));
-  glUniform1fv(glGetUniformLocation(shader, "u_baseColorStrength"), 1, &u.otBaseStrength);
-  glUniform1fv(glGetUniformLocation(shader, "u_otDist0to1"), 1, &u.otDist0to1);
-  glUniform1fv(glGetUniformLocation(shader, "u_otDist1to2"), 1, &u.otDist1to2);
-  glUniform1fv(glGetUniformLocation(shader, "u_otDist2to3"), 1, &u.otDist2to3);
-  glUniform1fv(glGetUniformLocation(shader, "u_otDist3to0"), 1, &u.otDist3to0);
-  glUniform1fv(glGetUniformLocation(shader, "u_otCycleIntensity"), 1, &u.otCycleIntensity);
-  glUniform1fv(glGetUniformLocation(shader, "u_otPaletteOffset"), 1, &u.otPaletteOffset);
-
-  glUniform1i(glGetUniformLocation(shader, "u_shadowRayMinStepsTaken"), u.shadowRayMinStepsTaken);
-  glUniform1i(glGetUniformLocation(shader, "u_lightSource"), u.lightSource);
-  glUniform1fv(glGetUniformLocation(shader, "u_phongShadingMixFactor"), 1, &u.phongShadingMixFactor);
-  glUniform3fv(glGetUniformLocation(shader, "u_lightPos"), 1, glm::value_ptr(u.lightPos));
-  glUniform1fv(glGetUniformLocation(shader, "u_shadowBrightness"), 1, &u.shadowBrightness);
-  glUniform3fv(glGetUniformLocation(shader, "u_bgColor"), 1, glm::value_ptr(u.bgColor));
-  glUniform3fv(glGetUniformLocation(shader, "u_glowColor"), 1, glm::value_ptr(u.glowColor));
-  glUniform1fv(glGetUniformLocation(shader, "u_glowFactor"), 1, &u.glowFactor);
-  glUniform3fv(glGetUniformLocation(shader, "u_eyePos"), 1, glm::value_ptr(cam.eye));
-  glUniform1i(glGetUniformLocation(shader, "u_showBgGradient"), u.showBgGradient);
-  glUniform1fv(glGetUniformLocation(shader, "u_noiseFactor"), 1, &u.noiseFactor);
-  glUniform1fv(glGetUniformLocation(shader, "u_fudgeFactor"), 1, &u.fudgeFactor);
-  glUniform1fv(glGetUniformLocation(shader, "u_ambientIntensity"), 1, &u.ambientIntensity);
-  glUniform1fv(glGetUniformLocation(shader, "u_diffuseIntensity"), 1, &u.diffuseIntensity);
-  glUniform1fv(glGetUniformLocation(shader, "u_specularIntensity"), 1, &u.specularIntensity);
-  glUniform1fv(glGetUniformLocation(shader, "u_shininess"), 1, &u.shininess);
-  glUniform1i(glGetUniformLocation(shader, "u_gammaCorrection"), u.gammaCorrection);
+  sceneChanged |= cameraBuffer.update(&cameraBlock, sizeof(cameraBlock));
+  sceneChanged |= fractalBuffer.update(&fractalBlock, sizeof(fractalBlock));
+  glUniform1f(timeLocation, currentTime);
+
+  // u_time only shows when the sphere radius beats
+  if (sceneChanged || u.sphereMinTimeVariance || !accumulation.enabled)
+    accumulation.reset();
+
+  if (offscreen) {
+    if (deferShadows)
+      renderTarget.bindLit(renderWidth, renderHeight);
+    else
+      renderTarget.bind(renderWidth, renderHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, renderTarget.getPreviousHistory());
+  }
+
+  // A converged image is only presented again
+  Profiler &profiler = windowAdapter.getProfiler();
+  if (!accumulation.converged()) {
+    profiler.beginGpu(PROFILE_GPU_RAYMARCH);
+
+    // Cone starts are left unjittered, the cone is wide enough to cover the jitter
+    if (u.conePrepass) {
+      conePrepass.reserve(renderWidth, renderHeight, (unsigned int) u.coneBlockSize);
+      conePrepass.bind(renderWidth, renderHeight, (unsigned int) u.coneBlockSize);
+      glUseProgram(shaders.conePrepassProgram());
+      glUniform1f(coneTimeLocation, currentTime);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+      glUseProgram(shader);
+      if (deferShadows)
+        renderTarget.bindLit(renderWidth, renderHeight);
+      else if (offscreen)
+        renderTarget.bind(renderWidth, renderHeight);
+      else {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, (GLsizei) screenSize.x, (GLsizei) screenSize.y);
+      }
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, conePrepass.getTexture());
+    }
+
+    vec2 jitter = accumulation.enabled ? accumulation.jitter() : vec2(0.0f);
+    glUniform2f(jitterLocation, 2.0f * jitter.x / (float) renderWidth, 2.0f * jitter.y / (float) renderHeight);
+
+    // Only the color is averaged, the hit history is overwritten. With the
+    // shadow pass its composite is what lands in the color, so it takes the blend.
+    bool blendSample = accumulation.sampleCount() > 0;
+    if (blendSample) {
+      glBlendColor(0.0f, 0.0f, 0.0f, accumulation.blendWeight());
+      glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+      if (!deferShadows)
+        glEnablei(GL_BLEND, 0);
+    } else {
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    if (u.marchStats)
+      marchStats.begin();
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisablei(GL_BLEND, 0);
+    profiler.endGpu();
+
+    // Shadow rays for blocks of pixels from the hits just written, then upsampled onto the lit color
+    if (deferShadows) {
+      profiler.beginGpu(PROFILE_GPU_SHADOWS);
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_2D, renderTarget.getHistory());
+      glActiveTexture(GL_TEXTURE3);
+      glBindTexture(GL_TEXTURE_2D, renderTarget.getLitTexture());
+
+      shadowPass.reserve(renderWidth, renderHeight, (unsigned int) u.shadowScale);
+      shadowPass.bind(renderWidth, renderHeight, (unsigned int) u.shadowScale);
+      glUseProgram(shaders.shadowPassProgram());
+      glUniform1f(shadowTimeLocation, currentTime);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+      renderTarget.bindColor(renderWidth, renderHeight);
+      glActiveTexture(GL_TEXTURE4);
+      glBindTexture(GL_TEXTURE_2D, shadowPass.getTexture());
+      glUseProgram(shaders.shadowCompositeProgram());
+      if (blendSample)
+        glEnablei(GL_BLEND, 0);
+      glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+      glDisablei(GL_BLEND, 0);
+
+      glUseProgram(shader);
+      profiler.endGpu();
+    }
+
+    if (u.marchStats)
+      marchStats.end();
+
+    if (accumulation.enabled)
+      accumulation.addSample();
+
+    if (offscreen) {
+      renderTarget.swapHistory();
+      historyInverseVP = inverseVP;
+      historySize = vec2(renderWidth, renderHeight);
+      historyValid = true;
+    }
+  }
+
+  // GUI is drawn after this at full resolution
+  if (offscreen)
+    renderTarget.blitToScreen((unsigned int) screenSize.x, (unsigned int) screenSize.y);
+
+  if (benchmarking)
+    finishBenchmarkFrame(frameStart, gridReady && shaders.pendingCount() == 0);
+
+  // Captured before the GUI
+  if (frameCapture.active()) {
+    ProfileScope captureScope(profiler, PROFILE_CAPTURE);
+    frameCapture.capture((unsigned int) screenSize.x, (unsigned int) screenSize.y);
+  }
+
+  // Hands back what the GUI set and the surface distance deep zoom steps by
+  cameraControls.write(cam);
+}
+
+/**
+ * Main thread, after the input of a tick
+ */
+void publishScene() {
+
+  // Calculate centered view matrix for locked spherical coord controls
+  if (shouldUpdateCoordinates && !inputScene.cam.freeControlsActive)
+    inputScene.cam.updateSphericalView();
+  shouldUpdateCoordinates = false;
+
+  inputScene.inputTime = glfwGetTime();
+  scenes.write(inputScene);
+}
+
+/**
+ * Render thread, the view from the scene with the controls the GUI has
+ */
+void takeScene(const Scene &scene) {
+  Camera controls = cam;
+  cam = scene.cam;
+  cam.copyControls(controls);
+
+  if (scene.width != screenSize.x || scene.height != screenSize.y) {
+    screenSize = vec2(scene.width, scene.height);
+    screenRatio = screenSize.x / screenSize.y;
+  }
+
+  if (scene.screenshotRequests != screenshotRequests) {
+    screenshotRequests = scene.screenshotRequests;
+    if (!frameCapture.active())
+      takeScreenshot();
+  }
+  if (scene.reloadRequests != reloadRequests) {
+    reloadRequests = scene.reloadRequests;
+    shaders.reload();
+  }
+}
+
+/**
+ * Block bindings, needed by every newly linked program
+ */
+void setupShader(GLuint program) {
+  cameraBuffer.attach(program);
+  fractalBuffer.attach(program);
+  marchStats.attach(program);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_history"), 0);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_coneDistance"), 1);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_hits"), 2);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_litColor"), 3);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_shadow"), 4);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_noiseVolume"), 5);
+  glProgramUniform1i(program, glGetUniformLocation(program, "u_distanceGrid"), 6);
+}
+
+/**
+ * Reads the noise volume from NOISE_VOLUME_FILE, baking and writing it if that
+ * fails, and leaves it bound to texture unit 5
+ */
+void loadNoiseVolume() {
+  double start = glfwGetTime();
+  NoiseVolume volume;
+  if (volume.load(NOISE_VOLUME_FILE)) {
+    printf("Loaded noise volume from %s in %.1f ms\n", NOISE_VOLUME_FILE, 1000.0 * (glfwGetTime() - start));
+  } else {
+    volume.bake();
+    printf("Baked noise volume in %.1f ms\n", 1000.0 * (glfwGetTime() - start));
+    if (volume.save(NOISE_VOLUME_FILE))
+      printf("Cached it in %s\n", NOISE_VOLUME_FILE);
+  }
+
+  glGenTextures(1, &noiseTexture);
+  glActiveTexture(GL_TEXTURE5);
+  glBindTexture(GL_TEXTURE_3D, noiseTexture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, NoiseVolume::SIZE, NoiseVolume::SIZE, NoiseVolume::SIZE, 0,
+               GL_RED, GL_UNSIGNED_BYTE, volume.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+/**
+ * Replaces the distance grid texture with the grid just built and leaves it bound to texture unit 6
+ */
+void uploadDistanceGrid() {
+  printf("Built distance grid in %.1f ms\n", distanceGrid.getBuildMS());
+  if (!distanceGridTexture)
+    glGenTextures(1, &distanceGridTexture);
+
+  glActiveTexture(GL_TEXTURE6);
+  glBindTexture(GL_TEXTURE_3D, distanceGridTexture);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, DistanceGrid::SIZE, DistanceGrid::SIZE, DistanceGrid::SIZE, 0,
+               GL_RED, GL_FLOAT, distanceGrid.data());
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+/**
+ * Compile errors of the last shader build, drawn even with the GUI hidden.
+ * The programs from before the failed reload keep rendering meanwhile.
+ */
+void renderShaderErrors() {
+  ImGui::SetNextWindowPos(ImVec2(screenSize.x / 2.0f, 0), 0, ImVec2(0.5, 0.0));
+  ImGui::Begin("Shader errors", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+  ImGui::TextColored(ImVec4(0.9, 0.2, 0.2, 1.0), "%s", shaders.getErrors().c_str());
+  if (shaders.isReloading())
+    ImGui::Text(shaders.compilesInBackground() ? "Reloading..." : "Reloading, stalls once linked without a compile thread");
+  if (ImGui::Button("Dismiss"))
+    shaders.clearErrors();
+  ImGui::End();
+}
+
+/**
+ * Camera, formula and u_time of the benchmark frame. Only the formula toggles
+ * come from the preset's AppState, the rest of it is the explorer's own.
+ */
+void setBenchmarkFrame() {
+  Keyframe key = benchmark.frame();
+  u = key.u;
+  u.marchStats = benchmark.countingDECalls();
+  state.mandelbulbOn = key.state.mandelbulbOn;
+  state.boxFoldingOn = key.state.boxFoldingOn;
+  state.sphereFoldingOn = key.state.sphereFoldingOn;
+  state.mandelBoxOn = key.state.mandelBoxOn;
+  state.recursiveTetraOn = key.state.recursiveTetraOn;
+  state.deepZoom = key.state.deepZoom;
+  currentTime = key.time;
+
+  cam.freeControlsActive = true;
+  cam.eye = key.eye;
+  cam.center = key.center;
+  cam.up = key.up;
+  cam.updateCenteredViewMatrix();
+  inverseVP = glm::inverse(cam.projectionMatrix * cam.viewMatrix);
+}
+
+/**
+ * Waits for the frame so its time covers the GPU work, not just the submission
+ */
+void finishBenchmarkFrame(double frameStart, bool ready) {
+  glFinish();
+  double ms = 1000.0 * (glfwGetTime() - frameStart);
+
+  double deCalls = 0.0;
+  if (benchmark.countingDECalls() && marchStats.poll())
+    deCalls = (double) marchStats.getLatest().totalDECalls();
+  benchmark.finishFrame(ms, deCalls, ready);
+  if (!benchmark.done())
+    return;
+
+  std::string renderer = std::string((const char *) glGetString(GL_RENDERER)) + ", OpenGL "
+      + (const char *) glGetString(GL_VERSION);
+  benchmark.printSummary();
+  if (benchmark.write(benchmarkOutput, renderer, (unsigned int) screenSize.x, (unsigned int) screenSize.y))
+    std::cout << "Wrote " << benchmarkOutput << std::endl;
+  glfwSetWindowShouldClose(window, true);
+}
+
+/**
+ * The next frame as screenshot_N.png, read back through the same ring as recordings
+ */
+void takeScreenshot() {
+  char fileName[64];
+  snprintf(fileName, sizeof(fileName), "screenshot_%u.png", screenshots++);
+  frameCapture.start(CAPTURE_IMAGES, fileName, captureFps, 1);
+}
+
+/**
+ * Appends the current view and settings to KEYFRAME_FILE. The camera comes from
+ * the view matrix, which free mode changes without touching eye and center.
+ */
+void appendKeyframe() {
+  if (!nextKeyframeSeeded)
+    seedNextKeyframe();
+
+  FILE *file = fopen(KEYFRAME_FILE, "a");
+  if (!file) {
+    fprintf(stderr, "Failed to open %s for writing.\n", KEYFRAME_FILE);
+    return;
+  }
+
+  dmat4 cameraToWorld = glm::inverse(cam.viewMatrix);
+  Keyframe key;
+  key.frame = nextKeyframe;
+  key.eye = dvec3(cameraToWorld[3]);
+  key.center = key.eye - dvec3(cameraToWorld[2]) * std::max(glm::length(key.eye), 1.0);
+  key.up = dvec3(cameraToWorld[1]);
+  key.time = currentTime;
+  key.u = u;
+  key.state = state;
+  fputs(KeyframeTrack::format(key).c_str(), file);
+  fclose(file);
+
+  std::cout << "Appended keyframe " << key.frame << " to " << KEYFRAME_FILE << "\n";
+  nextKeyframe = key.frame + 60;
+}
+
+/**
+ * Continues after the last keyframe already in KEYFRAME_FILE, keyframe numbers have to increase
+ * through the whole file for mandelbulb-animate to load it
+ */
+void seedNextKeyframe() {
+  nextKeyframeSeeded = true;
+  std::ifstream file(KEYFRAME_FILE);
+  std::string text;
+  bool found = false;
+  unsigned int last = 0;
+  while (std::getline(file, text)) {
+    size_t comment = text.find('#');
+    if (comment != std::string::npos)
+      text.erase(comment);
+
+    std::istringstream line(text);
+    std::string name;
+    unsigned int frame;
+    if (line >> name && name == "keyframe" && line >> frame) {
+      last = std::max(last, frame);
+      found = true;
+    }
+  }
+  if (found)
+    nextKeyframe = std::max(nextKeyframe, last + 60);
 }
 
 void renderGui() {
+  Profiler &profiler = windowAdapter.getProfiler();
+  ProfileScope scope(profiler, PROFILE_GUI);
 
   // Graphics settings
   //ImGui::SetNextWindowSize(ImVec2(350, 280));
@@ -308,18 +767,71 @@ void renderGui() {
   ImGui::SliderInt("Mandel iters", &u.fractalIters, 1, 80);
   ImGui::SliderInt("Min dist factor", &u.minDistanceFactor, -5, 3);
 
-  // Adjust the min distance by a decimal
-  if (u.minDistanceFactor < 0) {
-    u.minDistance = u.baseMinDistance / ((float)(pow(10.0, abs(u.minDistanceFactor))));
-  } else if (u.minDistanceFactor > 0) {
-    u.minDistance = u.baseMinDistance * ((float)(pow(10.0, u.minDistanceFactor)));
-  } else {
-    u.minDistance = u.baseMinDistance;
-  }
+  u.updateMinDistance();
 
   ImGui::Value("Min dist", u.minDistance, "%.9f");
   ImGui::SliderFloat("Bailout", &u.bailLimit, 1.0f, 10.0f);
   ImGui::SliderFloat("\"Fudge\"", &u.fudgeFactor, 0.0f, 1.0f);
+  if (shaders.canSpecialize())
+    ImGui::Checkbox("Specialized shaders", &state.specializedShaders);
+  else
+    ImGui::Text("Specialized shaders off, no background compiles\n(no trig-free power kernels or double-float iterations)");
+  if (state.specializedShaders)
+    ImGui::Text("%u cached, %u compiling%s", shaders.readyCount(), shaders.pendingCount(),
+                shader == shaders.uberProgram() ? " (uber)" : "");
+
+  ImGui::Checkbox("Reproject hit distances", &u.reprojection);
+  if (u.reprojection)
+    ImGui::SliderFloat("Start fraction", &u.reprojectionFraction, 0.0f, 0.99f, "%.2f");
+
+  ImGui::Checkbox("Empty-space skipping", &u.distanceGrid);
+  if (u.distanceGrid) {
+    if (state.deepZoom || u.sphereMinTimeVariance)
+      ImGui::Text("Off in deep zoom and with the beat");
+    else if (distanceGrid.isBuilding())
+      ImGui::Text("Building grid...");
+    else
+      ImGui::Text("Grid built in %.0f ms", distanceGrid.getBuildMS());
+  }
+
+  ImGui::Combo("Normals", &u.normalMode, "Central differences\0Tetrahedral\0Analytic\0\0");
+  ImGui::Combo("Debug view", &u.debugView, "Shaded\0March steps\0DE calls\0\0");
+  ImGui::Checkbox("March statistics", &u.marchStats);
+  if (u.marchStats && marchStats.hasResults()) {
+    const MarchCounters &c = marchStats.getLatest();
+    ImGui::Text("Steps avg %.1f, max %u", c.averageSteps(), c.maxMarchSteps);
+    ImGui::Text("Escaped %.1f%%", 100.0 * c.escapedFraction());
+    ImGui::Text("DE calls %llu (%llu normal, %llu shadow)", (unsigned long long) c.totalDECalls(),
+                (unsigned long long) c.totalNormalDECalls(), (unsigned long long) c.totalShadowDECalls());
+  }
+
+  ImGui::Checkbox("Cone pre-pass", &u.conePrepass);
+  if (u.conePrepass) {
+    ImGui::RadioButton("8x8 blocks", &u.coneBlockSize, 8);
+    ImGui::SameLine();
+    ImGui::RadioButton("16x16 blocks", &u.coneBlockSize, 16);
+  }
+
+  ImGui::Checkbox("Dynamic resolution", &dynamicResolution.enabled);
+  if (dynamicResolution.enabled) {
+    ImGui::SliderFloat("Target ms/frame", &dynamicResolution.targetMS, 5.0f, 100.0f, "%.1f");
+    ImGui::SliderFloat("Min scale", &dynamicResolution.minScale, 0.1f, 1.0f, "%.2f");
+    ImGui::SliderFloat("Max scale", &dynamicResolution.maxScale, 0.1f, 1.0f, "%.2f");
+    ImGui::Text("Scale %.2f, %ux%u", dynamicResolution.getScale(), renderWidth, renderHeight);
+  }
+
+  ImGui::Checkbox("Progressive refinement", &accumulation.enabled);
+  if (accumulation.enabled) {
+    ImGui::SliderInt("Max samples", &accumulation.maxSamples, 1, 4096);
+    ImGui::Text("Samples %u%s", accumulation.sampleCount(), accumulation.converged() ? " (converged)" : "");
+  }
+
+  // Fewer frames in flight trade throughput for latency
+  FramePacing &pacing = windowAdapter.getPacing();
+  ImGui::Combo("Swap interval", &pacing.swapMode, "Driver\0Off\0Vsync\0Half rate\0Adaptive vsync\0\0");
+  ImGui::SliderInt("Max fps (0 off)", &pacing.maxFPS, 0, 240);
+  ImGui::Combo("Frames in flight", &pacing.framesInFlight, "Driver\0" "1\0" "2\0\0");
+  ImGui::Checkbox("Log latency", &pacing.logLatency);
 
   ImGui::Separator();
   ImGui::Text("Fractal values");
@@ -380,6 +892,37 @@ void renderGui() {
   ImGui::Checkbox("Auto trip", &cam.constantZoom);
   ImGui::SliderFloat("Turn step", &cam.coordTurnStep, 0.001, 0.01, "%.4f");
   ImGui::SliderFloat("Zoom step", &cam.coordZoomStep, 0.0000001, 0.01, "%.7f");
+  ImGui::Checkbox("Deep zoom", &state.deepZoom);
+  if (state.deepZoom) {
+    ImGui::SliderFloat("Deep zoom rate", &cam.deepZoomRate, 0.001f, 0.1f, "%.3f");
+    if (state.specializedShaders)
+      ImGui::SliderInt("Double-float iters", &u.deepIterations, 0, 8);
+    else
+      ImGui::Text("Double-float iterations need specialized shaders");
+    ImGui::Text("Surface distance %.3e", cam.surfaceDistance);
+  }
+  if (ImGui::Button("Append keyframe"))
+    appendKeyframe();
+  ImGui::Separator();
+  ImGui::Text("Capture");
+  ImGui::InputText("Images", imageTarget, sizeof(imageTarget));
+  ImGui::InputText("Y4M video", videoTarget, sizeof(videoTarget));
+  ImGui::SliderInt("Video fps", &captureFps, 1, 120);
+  if (frameCapture.active()) {
+    if (ImGui::Button("Stop capture"))
+      frameCapture.stop();
+    ImGui::Text("%u captured, %u dropped", frameCapture.framesCaptured(), frameCapture.droppedFrames());
+  } else {
+    if (ImGui::Button("Screenshot"))
+      takeScreenshot();
+    ImGui::SameLine();
+    if (ImGui::Button("Record images"))
+      frameCapture.start(CAPTURE_IMAGES, imageTarget);
+    ImGui::SameLine();
+    if (ImGui::Button("Record video"))
+      frameCapture.start(CAPTURE_Y4M, videoTarget, captureFps);
+  }
+  ImGui::Text("%u frames written%s", frameCapture.writtenFrames(), frameCapture.failed() ? ", write failed" : "");
   ImGui::End();
 
   // Color settings
@@ -414,6 +957,7 @@ void renderGui() {
   ImGui::ColorEdit3("Glow color", (float*)&u.glowColor);
   ImGui::SliderFloat("Glow strength", &u.glowFactor, 0.0f, 1.0f);
   ImGui::SliderFloat("Noise", &u.noiseFactor, 0.0f, 1.0f);
+  ImGui::Checkbox("Baked noise", &u.noiseTexture);
 
   if (u.lightSource) {
     ImGui::Separator();
@@ -424,7 +968,14 @@ void renderGui() {
     ImGui::Separator();
     ImGui::TextColored(ImVec4(0.0, 0.0, 0.0, 0.5), "More steps ignored may reduce noise");
     ImGui::SliderFloat("Shadow brighness", &u.shadowBrightness, 0.0f, 0.5f);
+    ImGui::SliderFloat("Shadow sharpness", &u.shadowSharpness, 2.0f, 64.0f);
     ImGui::SliderInt("Steps ignored", &u.shadowRayMinStepsTaken, 0, 20);
+    ImGui::Text("Shadow resolution");
+    ImGui::RadioButton("Full", &u.shadowScale, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("Half", &u.shadowScale, 2);
+    ImGui::SameLine();
+    ImGui::RadioButton("Quarter", &u.shadowScale, 4);
     ImGui::Separator();
     ImGui::Text("Blinn-phong shading");
     ImGui::SliderFloat("Mix-in factor", &u.phongShadingMixFactor, 0.0f, 1.0f);
@@ -447,28 +998,54 @@ void renderGui() {
   //cam.printCoordinates();
 
   // Stats
-  ImGui::SetNextWindowPos(ImVec2(0, windowAdapter.getHeight()), 0, ImVec2(0.0, 1.0));
-  ImGui::SetNextWindowSize(ImVec2(140, 80));
+  ImGui::SetNextWindowPos(ImVec2(0, screenSize.y), 0, ImVec2(0.0, 1.0));
+  ImGui::SetNextWindowSize(ImVec2(140, 130));
   ImGui::Begin("State");
   ImGui::Value("FPS", state.displayedFrames);
   ImGui::Value("ms/frame", state.displayedMS);
+  ImGui::Value("Latency ms", pacing.getLatencyMS());
+  ImGui::Value("Max latency", pacing.getMaxLatencyMS());
+  ImGui::Checkbox("Profiler", &profiler.enabled);
   ImGui::End();
+
+  if (profiler.enabled) {
+    ImGui::Begin("Profiler");
+    for (int i = 0; i < PROFILE_SECTION_COUNT; i++) {
+      auto section = (ProfileSection) i;
+      char overlay[32];
+      snprintf(overlay, sizeof(overlay), "avg %.3f ms", profiler.getAverageMS(section));
+      ImGui::PlotHistogram(Profiler::sectionName(section), profiler.getHistory(section), Profiler::HISTORY_SIZE,
+                           (profiler.getHistoryOffset() + 1) % Profiler::HISTORY_SIZE, overlay, 0.0f,
+                           std::max(2.0f * profiler.getAverageMS(section), 1.0f), ImVec2(0, 40));
+    }
+
+    if (ImGui::Button("Dump Chrome trace") && profiler.writeChromeTrace("mandelbulb-trace.json"))
+      std::cout << "Wrote " << profiler.traceEventCount() << " events to mandelbulb-trace.json\n";
+    ImGui::End();
+  }
 }
 
+// Main thread, the render thread picks the size up with the next scene
 void resizeCallback(GLFWwindow *win, int w, int h) {
   //std::cout << "\nresized to " << w << ", " << h << std::endl;
-  glViewport(0, 0, w, h);
-  screenSize.x = (GLfloat) w;
-  screenSize.y = (GLfloat) h;
-  screenRatio = screenSize.x / screenSize.y;
+  if (w == 0 || h == 0)
+    return; // Minimized
+  inputScene.width = (unsigned int) w;
+  inputScene.height = (unsigned int) h;
   windowAdapter.setResolution((unsigned int) w, (unsigned int) h);
-  cam.projectionMatrix = glm::perspective(glm::radians(FOV), screenRatio, NEAR_PLANE, FAR_PLANE);
-  inverseVP = glm::inverse(cam.projectionMatrix * cam.viewMatrix);
+  inputScene.cam.projectionMatrix = glm::perspective(glm::radians((double) FOV), (double) w / (double) h,
+                                                     (double) NEAR_PLANE, (double) FAR_PLANE);
 }
 
 // Process input keys concurrently of each other
 // This is harder to do with a normal key callback function
+// Runs Window::INPUT_HZ times a second on the main thread, every step below is per tick
 void processInput(GLFWwindow *window) {
+  double now = glfwGetTime();
+  Camera &cam = inputScene.cam; // Not the render thread's
+
+  if (cameraControls.update())
+    cam.copyControls(cameraControls.read());
 
   // Close
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -478,16 +1055,25 @@ void processInput(GLFWwindow *window) {
 
   if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
 
-    // Disable toggle within small time window to avoid flickering in high fps
-    if (std::abs(currentTime - state.timeSinceLastGuiToggle) > 0.15) {
-      state.showGui = !state.showGui;
-      state.timeSinceLastGuiToggle = currentTime;
+    // Disable toggle within small time window to avoid flickering
+    if (now - timeSinceLastGuiToggle > 0.15) {
+      inputScene.showGui = !inputScene.showGui;
+      timeSinceLastGuiToggle = now;
     }
   }
 
-  // Reload shader
-  if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS)
-    shader = utils::loadShaders("../shaders/mandel_raymarch.vert", "../shaders/mandel_raymarch.frag");
+  if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+    if (now - timeSinceLastScreenshot > 0.3) {
+      inputScene.screenshotRequests++;
+      timeSinceLastScreenshot = now;
+    }
+  }
+
+  // Reload shader, once per press since it compiles in the background
+  bool reloadKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+  if (reloadKey && !reloadKeyHeld)
+    inputScene.reloadRequests++;
+  reloadKeyHeld = reloadKey;
 
   // Movement
   if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
@@ -525,6 +1111,8 @@ void processInput(GLFWwindow *window) {
     shouldUpdateCoordinates = true;
     cam.resetCoords();
   }
+
+  publishScene();
 }
 
 void setGuiStyle() {
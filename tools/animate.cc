@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include "CpuRaymarcher.hh"
+#include "FractalUniforms.hh"
+#include "Keyframes.hh"
+#include "ThreadPool.hh"
+
+// Same projection as the interactive explorer
+float NEAR_PLANE = 0.1f;
+float FAR_PLANE = 100.0f;
+float FOV = 50.0f;
+
+struct AnimateOptions {
+  std::string keyframes;
+  std::string output = "frame_%05u.png";
+  unsigned int width = 1280;
+  unsigned int height = 720;
+  unsigned int threads = 0;
+  unsigned int tileSize = 32;
+  unsigned int framesInFlight = 2;
+  unsigned int first = 0;
+  unsigned int last = ~0u;
+  bool weakSettings = false;
+  bool overwrite = false;
+  SimdLevel simdLevel = bestSimdLevel();
+};
+
+void showUsage() {
+  std::cerr << "Usage: ./mandelbulb-animate -k flight.keys -o frames/frame_%05u.png\n"
+            << "Options:\n"
+            << "\t-h,--help\t\tShow this message\n"
+            << "\t-k,--keyframes <file>\tKeyframe file, see Keyframes.hh for the format\n"
+            << "\t-o,--output <pattern>\tprintf pattern for the frame number, .png or .ppm (default frame_%05u.png)\n"
+            << "\t-s,--size <w> <h>\tResolution in pixels (default 1280 720)\n"
+            << "\t-t,--threads <n>\tWorker threads, 0 for all cores (default 0)\n"
+            << "\t--tile <px>\t\tTile edge length (default 32)\n"
+            << "\t--in-flight <n>\t\tFrames rendered at once (default 2)\n"
+            << "\t--frames <first> <last>\tRender only this inclusive range\n"
+            << "\t--overwrite\t\tRender frames that already exist instead of skipping them\n"
+            << "\t-w,--weak \t\tSame lower settings as the explorer, under the keyframes\n"
+            << "\t--simd <level>\t\tPacket DE kernel: scalar, sse4.1, avx2 or avx512 (default best supported)\n"
+            << std::endl;
+}
+
+int handleArgs(int c, char *argv[], AnimateOptions &options) {
+  for (int i = 1; i < c; ++i) {
+    std::string arg = argv[i];
+    int left = c - i - 1;
+
+    if (arg == "-h" || arg == "--help") {
+      showUsage();
+      return -1;
+    } else if ((arg == "-k" || arg == "--keyframes") && left >= 1) {
+      options.keyframes = argv[++i];
+    } else if ((arg == "-o" || arg == "--output") && left >= 1) {
+      options.output = argv[++i];
+    } else if ((arg == "-s" || arg == "--size") && left >= 2) {
+      options.width = (unsigned int) std::atoi(argv[++i]);
+      options.height = (unsigned int) std::atoi(argv[++i]);
+    } else if ((arg == "-t" || arg == "--threads") && left >= 1) {
+      options.threads = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--tile" && left >= 1) {
+      options.tileSize = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--in-flight" && left >= 1) {
+      options.framesInFlight = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--frames" && left >= 2) {
+      options.first = (unsigned int) std::atoi(argv[++i]);
+      options.last = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--overwrite") {
+      options.overwrite = true;
+    } else if (arg == "-w" || arg == "--weak") {
+      options.weakSettings = true;
+    } else if (arg == "--simd" && left >= 1) {
+      std::string name = argv[++i];
+      if (!parseSimdLevel(name.c_str(), options.simdLevel)) {
+        std::cerr << "Unknown SIMD level " << name << "\n";
+        return -1;
+      }
+      if (!simdLevelSupported(options.simdLevel)) {
+        std::cerr << "SIMD level " << name << " is not supported by this CPU\n";
+        return -1;
+      }
+    } else {
+      std::cerr << "Unknown or incomplete argument " << arg << "\n";
+      showUsage();
+      return -1;
+    }
+  }
+
+  if (options.keyframes.empty()) {
+    std::cerr << "No keyframe file given\n";
+    showUsage();
+    return -1;
+  }
+  if (options.width == 0 || options.height == 0 || options.tileSize == 0) {
+    std::cerr << "Size and tile size must be positive\n";
+    return -1;
+  }
+  if (!validFramePattern(options.output)) {
+    std::cerr << "Output pattern needs exactly one %u, %0Nu or %d for the frame number\n";
+    return -1;
+  }
+  return 0;
+}
+
+std::string frameFileName(const std::string &pattern, unsigned int frame) {
+  char name[4096];
+  snprintf(name, sizeof(name), pattern.c_str(), frame);
+  return name;
+}
+
+/**
+ * Written next to the frame and renamed over it once complete, so an existing
+ * frame file is always a whole frame and resuming can skip it
+ */
+std::string partialFileName(const std::string &fileName) {
+  size_t dot = fileName.find_last_of('.');
+  size_t slash = fileName.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return fileName + ".part";
+  return fileName.substr(0, dot) + ".part" + fileName.substr(dot);
+}
+
+bool fileExists(const std::string &fileName) {
+  struct stat info;
+  return stat(fileName.c_str(), &info) == 0;
+}
+
+/**
+ * One frame in flight, its tiles share the pool with the other frames' tiles
+ */
+struct FrameJob {
+  unsigned int frame;
+  std::string fileName;
+  std::unique_ptr<CpuRaymarcher> raymarcher;
+  Image image;
+  std::atomic<unsigned int> tilesLeft;
+};
+
+int main(int argc, char *argv[]) {
+  AnimateOptions options;
+  int OK = handleArgs(argc, argv, options);
+  if (OK < 0) return -1;
+
+  FractalUniforms u;
+  AppState state;
+  if (options.weakSettings)
+    u.applyWeakSettings();
+
+  KeyframeTrack track;
+  if (!track.load(options.keyframes, u, state))
+    return EXIT_FAILURE;
+
+  unsigned int first = options.first;
+  unsigned int last = std::min(options.last, track.frameCount() - 1);
+  if (first > last) {
+    std::cerr << "No frames in range, the keyframes end at frame " << track.frameCount() - 1 << "\n";
+    return EXIT_FAILURE;
+  }
+
+  // Frames that are already on disk are done, which is what makes a rerun resume
+  std::vector<unsigned int> frames;
+  for (unsigned int frame = first; frame <= last; frame++)
+    if (options.overwrite || !fileExists(frameFileName(options.output, frame)))
+      frames.push_back(frame);
+
+  unsigned int skipped = last - first + 1 - (unsigned int) frames.size();
+  if (skipped > 0)
+    printf("Skipping %u frames that are already rendered\n", skipped);
+  if (frames.empty())
+    return 0;
+
+  ThreadPool pool(options.threads);
+
+  // Tiles of the next frame keep every worker busy while a frame's last tiles
+  // finish, more frames in flight only cost memory
+  unsigned int framesInFlight = std::max(options.framesInFlight, 1u);
+
+  std::mutex mutex;
+  std::condition_variable frameDone;
+  unsigned int inFlight = 0;
+  unsigned int completed = 0;
+  bool failed = false;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned int frame : frames) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      frameDone.wait(lock, [&] { return inFlight < framesInFlight; });
+      if (failed) break;
+      inFlight++;
+    }
+
+    Keyframe key = track.at(frame);
+    auto job = std::make_shared<FrameJob>();
+    job->frame = frame;
+    job->fileName = frameFileName(options.output, frame);
+    job->raymarcher.reset(new CpuRaymarcher(key.u, key.state, keyframeView(key, options.width, options.height,
+                                                                         FOV, NEAR_PLANE, FAR_PLANE)));
+    job->raymarcher->setSimdLevel(options.simdLevel);
+    job->image = Image(options.width, options.height);
+
+    std::vector<Tile> tiles;
+    for (unsigned int y = 0; y < options.height; y += options.tileSize)
+      for (unsigned int x = 0; x < options.width; x += options.tileSize)
+        tiles.push_back({x, y, std::min(x + options.tileSize, options.width),
+                         std::min(y + options.tileSize, options.height)});
+    job->tilesLeft = (unsigned int) tiles.size();
+
+    // The last tile of a frame writes it out
+    for (const Tile &tile : tiles) {
+      pool.submit([&, job, tile] {
+        job->raymarcher->renderTile(job->image, tile);
+        if (--job->tilesLeft > 0)
+          return;
+
+        std::string partial = partialFileName(job->fileName);
+        bool written = job->image.write(partial) && std::rename(partial.c_str(), job->fileName.c_str()) == 0;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight--;
+        if (!written) {
+          std::cerr << "Failed to write " << job->fileName << "\n";
+          failed = true;
+        } else {
+          completed++;
+          std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+          double fps = completed / elapsed.count();
+          printf("Frame %u done, %u/%zu (%.2f fps, %.0f s left)\n", job->frame, completed, frames.size(), fps,
+                 (frames.size() - completed) / fps);
+          fflush(stdout);
+        }
+        frameDone.notify_one();
+      });
+    }
+  }
+
+  pool.wait();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  printf("Rendered %u frames at %ux%u in %.1f s on %u threads (%.2f fps)\n", completed, options.width,
+         options.height, elapsed.count(), pool.size(), completed / elapsed.count());
+  return failed ? EXIT_FAILURE : 0;
+}
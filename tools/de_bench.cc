@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "Benchmark.hh"
+#include "DistanceEstimator.hh"
+#include "FractalUniforms.hh"
+
+// Single threaded, so every figure is DE evaluations per second per core
+
+struct BenchOptions {
+  size_t points = 1 << 16;
+  int rounds = 20;
+  float time = 0.0f;
+  bool weakSettings = false;
+  bool julia = false;
+  bool boxFold = false;
+  bool sphereFold = false;
+  bool mandelbox = false;
+  bool tetra = false;
+  bool noMandelbulb = false;
+  bool powers = false;
+  bool presets = false;
+  double minTime = 0.5; // Seconds per microbenchmark
+  std::string output;
+};
+
+void showUsage() {
+  std::cerr << "Usage: ./mandelbulb-de-bench\n"
+            << "Options:\n"
+            << "\t-h,--help\t\tShow this message\n"
+            << "\t-n,--points <n>\t\tPositions per round (default 65536)\n"
+            << "\t-r,--rounds <n>\t\tTimed rounds per kernel (default 20)\n"
+            << "\t--time <s>\t\tValue of u_time\n"
+            << "\t-w,--weak \t\tSame lower settings as the explorer\n"
+            << "\t--julia, --box-fold, --sphere-fold, --mandelbox, --tetra, --no-mandelbulb\n"
+            << "\t\t\t\tFormula toggles, as in the explorer GUI\n"
+            << "\t--powers\t\tCompare the general and integer Mandelbulb kernels for powers 2 to 10\n"
+            << "\t--presets\t\tMicrobenchmark every kernel on each benchmark preset of the explorer\n"
+            << "\t--min-time <s>\t\tSeconds each preset microbenchmark runs for at least (default 0.5)\n"
+            << "\t-o,--output <file>\tWrite the preset results as Google Benchmark JSON, or CSV for .csv\n"
+            << std::endl;
+}
+
+int handleArgs(int c, char *argv[], BenchOptions &options) {
+  for (int i = 1; i < c; ++i) {
+    std::string arg = argv[i];
+    int left = c - i - 1;
+
+    if (arg == "-h" || arg == "--help") {
+      showUsage();
+      return -1;
+    } else if ((arg == "-n" || arg == "--points") && left >= 1) {
+      options.points = (size_t) std::atol(argv[++i]);
+    } else if ((arg == "-r" || arg == "--rounds") && left >= 1) {
+      options.rounds = std::atoi(argv[++i]);
+    } else if (arg == "--time" && left >= 1) {
+      options.time = (float) std::atof(argv[++i]);
+    } else if (arg == "-w" || arg == "--weak") {
+      options.weakSettings = true;
+    } else if (arg == "--julia") {
+      options.julia = true;
+    } else if (arg == "--box-fold") {
+      options.boxFold = true;
+    } else if (arg == "--sphere-fold") {
+      options.sphereFold = true;
+    } else if (arg == "--mandelbox") {
+      options.mandelbox = true;
+    } else if (arg == "--tetra") {
+      options.tetra = true;
+    } else if (arg == "--no-mandelbulb") {
+      options.noMandelbulb = true;
+    } else if (arg == "--powers") {
+      options.powers = true;
+    } else if (arg == "--presets") {
+      options.presets = true;
+    } else if (arg == "--min-time" && left >= 1) {
+      options.minTime = std::atof(argv[++i]);
+    } else if ((arg == "-o" || arg == "--output") && left >= 1) {
+      options.output = argv[++i];
+    } else {
+      std::cerr << "Unknown or incomplete argument " << arg << "\n";
+      showUsage();
+      return -1;
+    }
+  }
+
+  if (options.points == 0 || options.rounds <= 0) {
+    std::cerr << "Points and rounds must be positive\n";
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Runs fn rounds times and returns evaluations per second
+ */
+template<typename F>
+double measure(const BenchOptions &options, F fn) {
+  fn(); // warm up caches and the branch predictor
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < options.rounds; i++)
+    fn();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return (double) options.points * options.rounds / elapsed.count();
+}
+
+/**
+ * Largest error of distance against reference, relative to the distance but
+ * absolute near the surface where distances go to zero
+ */
+float maxRelativeError(const std::vector<float> &distance, const std::vector<float> &reference) {
+  float maxError = 0.0f;
+  for (size_t i = 0; i < reference.size(); i++) {
+    float error = std::abs(distance[i] - reference[i]) / std::max(1.0f, std::abs(reference[i]));
+    if (std::isfinite(reference[i]))
+      maxError = std::max(maxError, error);
+  }
+  return maxError;
+}
+
+/**
+ * General against integer Mandelbulb kernels at each power, scalar and the best packet level
+ */
+void comparePowers(const BenchOptions &options, FractalUniforms u, const AppState &state,
+                   const std::vector<float> &x, const std::vector<float> &y, const std::vector<float> &z) {
+  SimdLevel level = bestSimdLevel();
+  std::vector<float> general(options.points), integer(options.points);
+  volatile float sink = 0.0f;
+
+  printf("%-6s %14s %14s %9s %12s | %-8s %14s %14s %9s %12s\n", "power", "general/s", "integer/s", "speedup",
+         "max error", "packet", "general/s", "integer/s", "speedup", "max error");
+
+  for (int power = 2; power <= 10; power++) {
+    u.power = (float) power;
+    DistanceEstimator integerDE(u, state, options.time);
+    DistanceEstimator generalDE = integerDE;
+    generalDE.setIntegerPowerKernels(false);
+
+    auto scalar = [&](const DistanceEstimator &de, std::vector<float> &out) {
+      return measure(options, [&] {
+        for (size_t i = 0; i < options.points; i++)
+          out[i] = de.estimate(vec3(x[i], y[i], z[i]));
+        sink = sink + out[0];
+      });
+    };
+    auto packet = [&](const DistanceEstimator &de, std::vector<float> &out) {
+      return measure(options, [&] {
+        de.estimatePacket(level, options.points, x.data(), y.data(), z.data(), out.data());
+        sink = sink + out[0];
+      });
+    };
+
+    double generalRate = scalar(generalDE, general);
+    double integerRate = scalar(integerDE, integer);
+    float scalarError = maxRelativeError(integer, general);
+
+    // Packet errors are against the scalar general kernel, like the SIMD table
+    double generalPacketRate = packet(generalDE, integer);
+    double integerPacketRate = packet(integerDE, integer);
+    float packetError = maxRelativeError(integer, general);
+
+    printf("%-6d %14.0f %14.0f %8.2fx %12.2e | %-8s %14.0f %14.0f %8.2fx %12.2e\n", power,
+           generalRate, integerRate, integerRate / generalRate, scalarError, simdLevelName(level),
+           generalPacketRate, integerPacketRate, integerPacketRate / generalPacketRate, packetError);
+  }
+}
+
+/**
+ * One named microbenchmark, times per DE evaluation
+ */
+struct MicroResult {
+  std::string name;
+  size_t iterations; // Evaluations
+  double realNS;
+  double cpuNS;
+};
+
+/**
+ * Google Benchmark's way of timing: keep doubling the number of batches until
+ * the run takes at least minTime, then report the time per item of that run
+ */
+template<typename F>
+MicroResult runMicrobenchmark(const BenchOptions &options, const std::string &name, F batch) {
+  batch(); // warm up
+
+  size_t batches = 1;
+  while (true) {
+    std::clock_t cpuStart = std::clock();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < batches; i++)
+      batch();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double cpuElapsed = (double) (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+    if (elapsed.count() >= options.minTime || batches >= ((size_t) 1 << 30)) {
+      size_t items = batches * options.points;
+      return {name, items, 1e9 * elapsed.count() / items, 1e9 * cpuElapsed / items};
+    }
+    batches *= 2;
+  }
+}
+
+bool writeMicroResults(const std::string &fileName, const std::vector<MicroResult> &results) {
+  FILE *file = fopen(fileName.c_str(), "w");
+  if (file == nullptr) {
+    fprintf(stderr, "Failed to open %s for writing.\n", fileName.c_str());
+    return false;
+  }
+
+  bool csv = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".csv") == 0;
+  if (csv)
+    fprintf(file, "name,iterations,real_time,cpu_time,time_unit,items_per_second\n");
+  else
+    fprintf(file, "{\n  \"context\": {\"executable\": \"mandelbulb-de-bench\", \"simd\": \"%s\"},\n"
+                  "  \"benchmarks\": [", simdLevelName(bestSimdLevel()));
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const MicroResult &r = results[i];
+    if (csv) {
+      fprintf(file, "%s,%zu,%.3f,%.3f,ns,%.0f\n", r.name.c_str(), r.iterations, r.realNS, r.cpuNS, 1e9 / r.realNS);
+      continue;
+    }
+    fprintf(file, "%s\n    {\"name\": \"%s\", \"run_type\": \"iteration\", \"iterations\": %zu, "
+                  "\"real_time\": %.3f, \"cpu_time\": %.3f, \"time_unit\": \"ns\", \"items_per_second\": %.0f}",
+            i ? "," : "", r.name.c_str(), r.iterations, r.realNS, r.cpuNS, 1e9 / r.realNS);
+  }
+  if (!csv)
+    fprintf(file, "\n  ]\n}\n");
+
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+/**
+ * BM_DE/<preset>/<kernel> for the reference DE and each supported packet kernel
+ */
+bool benchmarkPresets(const BenchOptions &options, const FractalUniforms &baseU, const AppState &baseState,
+                      const std::vector<float> &x, const std::vector<float> &y, const std::vector<float> &z) {
+  std::vector<float> distance(options.points);
+  std::vector<MicroResult> results;
+  volatile float sink = 0.0f;
+
+  printf("%-36s %12s %12s %12s %16s\n", "Benchmark", "Time", "CPU", "Iterations", "UserCounters...");
+  printf("%s\n", std::string(92, '-').c_str());
+  auto report = [&](const MicroResult &r) {
+    printf("%-36s %9.2f ns %9.2f ns %12zu items_per_second=%.2fM/s\n", r.name.c_str(), r.realNS, r.cpuNS,
+           r.iterations, 1e3 / r.realNS);
+    fflush(stdout);
+    results.push_back(r);
+  };
+
+  const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512};
+  for (const std::string &preset : BenchmarkSuite::presetNames()) {
+    FractalUniforms u = baseU;
+    AppState state = baseState;
+    BenchmarkSuite::applyPreset(preset, u, state);
+    DistanceEstimator de(u, state, options.time);
+
+    report(runMicrobenchmark(options, "BM_DE/" + preset + "/reference", [&] {
+      for (size_t i = 0; i < options.points; i++)
+        distance[i] = de.estimate(vec3(x[i], y[i], z[i]));
+      sink = sink + distance[0];
+    }));
+
+    for (SimdLevel level : levels) {
+      if (!simdLevelSupported(level))
+        continue;
+      report(runMicrobenchmark(options, "BM_DE/" + preset + "/" + simdLevelName(level), [&] {
+        de.estimatePacket(level, options.points, x.data(), y.data(), z.data(), distance.data());
+        sink = sink + distance[0];
+      }));
+    }
+  }
+
+  if (options.output.empty())
+    return true;
+  if (!writeMicroResults(options.output, results))
+    return false;
+  std::cout << "Wrote " << options.output << std::endl;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  int OK = handleArgs(argc, argv, options);
+  if (OK < 0) return -1;
+
+  FractalUniforms u;
+  AppState state;
+  if (options.weakSettings)
+    u.applyWeakSettings();
+  u.julia = options.julia;
+  state.boxFoldingOn = options.boxFold;
+  state.sphereFoldingOn = options.sphereFold;
+  state.mandelBoxOn = options.mandelbox;
+  state.recursiveTetraOn = options.tetra;
+  state.mandelbulbOn = !options.noMandelbulb;
+
+  DistanceEstimator de(u, state, options.time);
+
+  // Fixed seed, positions in the box the camera usually sees
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> coord(-1.5f, 1.5f);
+  std::vector<float> x(options.points), y(options.points), z(options.points);
+  for (size_t i = 0; i < options.points; i++) {
+    x[i] = coord(rng);
+    y[i] = coord(rng);
+    z[i] = coord(rng);
+  }
+
+  if (options.powers) {
+    comparePowers(options, u, state, x, y, z);
+    return 0;
+  }
+
+  if (options.presets)
+    return benchmarkPresets(options, u, state, x, y, z) ? 0 : EXIT_FAILURE;
+
+  std::vector<float> reference(options.points), distance(options.points);
+  volatile float sink = 0.0f;
+
+  double referenceRate = measure(options, [&] {
+    for (size_t i = 0; i < options.points; i++)
+      reference[i] = de.estimate(vec3(x[i], y[i], z[i]));
+    sink = sink + reference[0];
+  });
+
+  printf("%-10s %14s %9s %12s\n", "kernel", "DE evals/s", "speedup", "max error");
+  printf("%-10s %14.0f %8.2fx %12s\n", "reference", referenceRate, 1.0, "-");
+
+  const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512};
+  for (SimdLevel level : levels) {
+    if (!simdLevelSupported(level)) {
+      printf("%-10s %14s\n", simdLevelName(level), "unsupported");
+      continue;
+    }
+
+    double rate = measure(options, [&] {
+      de.estimatePacket(level, options.points, x.data(), y.data(), z.data(), distance.data());
+      sink = sink + distance[0];
+    });
+
+    float maxError = maxRelativeError(distance, reference);
+
+    printf("%-10s %14.0f %8.2fx %12.2e\n", simdLevelName(level), rate, rate / referenceRate, maxError);
+  }
+
+  return 0;
+}
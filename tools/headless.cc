@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "glm/gtc/matrix_transform.hpp"
+#include "Camera.hh"
+#include "CpuRaymarcher.hh"
+#include "FractalUniforms.hh"
+#include "ThreadPool.hh"
+
+// Same projection as the interactive explorer
+float NEAR_PLANE = 0.1f;
+float FAR_PLANE = 100.0f;
+float FOV = 50.0f;
+
+struct HeadlessOptions {
+  std::string output = "mandelbulb.png";
+  unsigned int width = 800;
+  unsigned int height = 640;
+  unsigned int threads = 0;
+  unsigned int tileSize = 32;
+  float time = 0.0f;
+  bool weakSettings = false;
+  bool customCamera = false;
+  double r = 3.0, theta = 0.0, phi = 0.0;
+  SimdLevel simdLevel = bestSimdLevel();
+  bool reference = false;
+  bool deepZoom = false;
+};
+
+void showUsage() {
+  std::cerr << "Usage: ./mandelbulb-headless -o out.png\n"
+            << "Options:\n"
+            << "\t-h,--help\t\tShow this message\n"
+            << "\t-o,--output <file>\tOutput image, .png or .ppm (default mandelbulb.png)\n"
+            << "\t-s,--size <w> <h>\tResolution in pixels (default 800 640)\n"
+            << "\t-t,--threads <n>\tWorker threads, 0 for all cores (default 0)\n"
+            << "\t--tile <px>\t\tTile edge length (default 32)\n"
+            << "\t--camera <r> <theta> <phi>\tSpherical camera coordinates\n"
+            << "\t--time <s>\t\tValue of u_time\n"
+            << "\t-w,--weak \t\tSame lower settings as the explorer\n"
+            << "\t--deep\t\t\tDeep zoom, march in double precision near the surface\n"
+            << "\t--simd <level>\t\tPacket DE kernel: scalar, sse4.1, avx2 or avx512 (default best supported)\n"
+            << "\t--reference\t\tMarch one pixel at a time with the plain scalar DE\n"
+            << std::endl;
+}
+
+int handleArgs(int c, char *argv[], HeadlessOptions &options) {
+  for (int i = 1; i < c; ++i) {
+    std::string arg = argv[i];
+    int left = c - i - 1;
+
+    if (arg == "-h" || arg == "--help") {
+      showUsage();
+      return -1;
+    } else if ((arg == "-o" || arg == "--output") && left >= 1) {
+      options.output = argv[++i];
+    } else if ((arg == "-s" || arg == "--size") && left >= 2) {
+      options.width = (unsigned int) std::atoi(argv[++i]);
+      options.height = (unsigned int) std::atoi(argv[++i]);
+    } else if ((arg == "-t" || arg == "--threads") && left >= 1) {
+      options.threads = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--tile" && left >= 1) {
+      options.tileSize = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--camera" && left >= 3) {
+      options.customCamera = true;
+      options.r = std::atof(argv[++i]);
+      options.theta = std::atof(argv[++i]);
+      options.phi = std::atof(argv[++i]);
+    } else if (arg == "--time" && left >= 1) {
+      options.time = (float) std::atof(argv[++i]);
+    } else if (arg == "-w" || arg == "--weak") {
+      options.weakSettings = true;
+    } else if (arg == "--deep") {
+      options.deepZoom = true;
+    } else if (arg == "--simd" && left >= 1) {
+      std::string name = argv[++i];
+      if (!parseSimdLevel(name.c_str(), options.simdLevel)) {
+        std::cerr << "Unknown SIMD level " << name << "\n";
+        return -1;
+      }
+      if (!simdLevelSupported(options.simdLevel)) {
+        std::cerr << "SIMD level " << name << " is not supported by this CPU\n";
+        return -1;
+      }
+    } else if (arg == "--reference") {
+      options.reference = true;
+    } else {
+      std::cerr << "Unknown or incomplete argument " << arg << "\n";
+      showUsage();
+      return -1;
+    }
+  }
+
+  if (options.width == 0 || options.height == 0 || options.tileSize == 0) {
+    std::cerr << "Size and tile size must be positive\n";
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  HeadlessOptions options;
+  int OK = handleArgs(argc, argv, options);
+  if (OK < 0) return -1;
+
+  FractalUniforms u;
+  AppState state;
+  if (options.weakSettings)
+    u.applyWeakSettings();
+  u.updateMinDistance();
+  state.deepZoom = options.deepZoom;
+
+  auto cam = Camera(options.width, options.height, NEAR_PLANE, FAR_PLANE);
+  if (options.customCamera)
+    cam.setSphericalCoords(options.r, options.theta, options.phi);
+  cam.updateSphericalView();
+
+  double screenRatio = (double) options.width / (double) options.height;
+  cam.projectionMatrix = glm::perspective(glm::radians((double) FOV), screenRatio, (double) NEAR_PLANE, (double) FAR_PLANE);
+
+  RenderView view;
+  view.inverseVP = glm::inverse(cam.projectionMatrix * cam.viewMatrix);
+  view.eyePos = cam.eye;
+  view.nearPlane = NEAR_PLANE;
+  view.farPlane = FAR_PLANE;
+  view.time = options.time;
+  view.width = options.width;
+  view.height = options.height;
+
+  ThreadPool pool(options.threads);
+  CpuRaymarcher raymarcher(u, state, view);
+  raymarcher.setSimdLevel(options.simdLevel);
+  raymarcher.setPacketMarch(!options.reference);
+  Image image(options.width, options.height);
+
+  auto start = std::chrono::steady_clock::now();
+  raymarcher.render(image, pool, options.tileSize);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  double pixels = (double) options.width * options.height;
+  printf("Rendered %ux%u in %.3f s on %u threads with %s DE (%.3f Mpixel/s)\n",
+         options.width, options.height, elapsed.count(), pool.size(),
+         options.reference ? "reference" : simdLevelName(options.simdLevel), pixels / elapsed.count() / 1e6);
+
+  if (!image.write(options.output))
+    return EXIT_FAILURE;
+
+  std::cout << "Wrote " << options.output << std::endl;
+  return 0;
+}
@@ -0,0 +1,161 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "DistanceEstimator.hh"
+#include "FractalUniforms.hh"
+#include "Keyframes.hh"
+#include "MeshExtractor.hh"
+#include "MeshFile.hh"
+#include "ThreadPool.hh"
+
+struct MeshOptions {
+  std::string output = "mandelbulb.ply";
+  MeshVolume volume;
+  unsigned int threads = 0;
+  float time = 0.0f;
+  bool weakSettings = false;
+  std::string keyframes;
+  unsigned int frame = 0;
+  bool julia = false;
+  bool boxFold = false;
+  bool sphereFold = false;
+  bool mandelbox = false;
+  bool tetra = false;
+  bool noMandelbulb = false;
+};
+
+void showUsage() {
+  std::cerr << "Usage: ./mandelbulb-mesh -r 1024 -o bulb.ply\n"
+            << "Options:\n"
+            << "\t-h,--help\t\tShow this message\n"
+            << "\t-o,--output <file>\tOutput mesh, binary .ply or .obj (default mandelbulb.ply)\n"
+            << "\t-r,--resolution <n>\tCells along each side of the cube (default 512)\n"
+            << "\t--chunk <n>\t\tCells along each side of a chunk (default 64)\n"
+            << "\t--extent <e>\t\tHalf the side of the cube (default 1.5)\n"
+            << "\t--center <x> <y> <z>\tCenter of the cube (default 0 0 0)\n"
+            << "\t--iso <d>\t\tSurface at this distance estimate (default half a cell)\n"
+            << "\t-t,--threads <n>\tWorker threads, 0 for all cores (default 0)\n"
+            << "\t--time <s>\t\tValue of u_time\n"
+            << "\t-k,--keyframes <file> <frame>\tTake the fractal settings from a keyframe file at a frame\n"
+            << "\t-w,--weak \t\tSame lower settings as the explorer\n"
+            << "\t--julia, --box-fold, --sphere-fold, --mandelbox, --tetra, --no-mandelbulb\n"
+            << "\t\t\t\tFormula toggles, as in the explorer GUI\n"
+            << std::endl;
+}
+
+int handleArgs(int c, char *argv[], MeshOptions &options) {
+  for (int i = 1; i < c; ++i) {
+    std::string arg = argv[i];
+    int left = c - i - 1;
+
+    if (arg == "-h" || arg == "--help") {
+      showUsage();
+      return -1;
+    } else if ((arg == "-o" || arg == "--output") && left >= 1) {
+      options.output = argv[++i];
+    } else if ((arg == "-r" || arg == "--resolution") && left >= 1) {
+      options.volume.resolution = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--chunk" && left >= 1) {
+      options.volume.chunkSize = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--extent" && left >= 1) {
+      options.volume.extent = (float) std::atof(argv[++i]);
+    } else if (arg == "--center" && left >= 3) {
+      options.volume.center.x = (float) std::atof(argv[++i]);
+      options.volume.center.y = (float) std::atof(argv[++i]);
+      options.volume.center.z = (float) std::atof(argv[++i]);
+    } else if (arg == "--iso" && left >= 1) {
+      options.volume.iso = (float) std::atof(argv[++i]);
+    } else if ((arg == "-t" || arg == "--threads") && left >= 1) {
+      options.threads = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--time" && left >= 1) {
+      options.time = (float) std::atof(argv[++i]);
+    } else if ((arg == "-k" || arg == "--keyframes") && left >= 2) {
+      options.keyframes = argv[++i];
+      options.frame = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "-w" || arg == "--weak") {
+      options.weakSettings = true;
+    } else if (arg == "--julia") {
+      options.julia = true;
+    } else if (arg == "--box-fold") {
+      options.boxFold = true;
+    } else if (arg == "--sphere-fold") {
+      options.sphereFold = true;
+    } else if (arg == "--mandelbox") {
+      options.mandelbox = true;
+    } else if (arg == "--tetra") {
+      options.tetra = true;
+    } else if (arg == "--no-mandelbulb") {
+      options.noMandelbulb = true;
+    } else {
+      std::cerr << "Unknown or incomplete argument " << arg << "\n";
+      showUsage();
+      return -1;
+    }
+  }
+
+  // Grid point coordinates of a quad's cells are packed into 64 bits
+  if (options.volume.resolution == 0 || options.volume.resolution > (1u << 20) || options.volume.chunkSize < 2
+      || options.volume.extent <= 0.0f) {
+    std::cerr << "Resolution must be 1 to 2^20, chunk size at least 2 and extent positive\n";
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  MeshOptions options;
+  int OK = handleArgs(argc, argv, options);
+  if (OK < 0) return -1;
+
+  FractalUniforms u;
+  AppState state;
+  float time = options.time;
+  if (!options.keyframes.empty()) {
+    KeyframeTrack track;
+    if (!track.load(options.keyframes, u, state))
+      return EXIT_FAILURE;
+    Keyframe key = track.at(options.frame);
+    u = key.u;
+    state = key.state;
+    time = key.time;
+  } else {
+    if (options.weakSettings)
+      u.applyWeakSettings();
+    u.julia = options.julia;
+    state.boxFoldingOn = options.boxFold;
+    state.sphereFoldingOn = options.sphereFold;
+    state.mandelBoxOn = options.mandelbox;
+    state.recursiveTetraOn = options.tetra;
+    state.mandelbulbOn = !options.noMandelbulb;
+  }
+
+  DistanceEstimator de(u, state, time);
+  ThreadPool pool(options.threads);
+  MeshExtractor extractor(de, options.volume);
+
+  MeshFile file;
+  if (!file.open(options.output))
+    return EXIT_FAILURE;
+
+  const unsigned int n = options.volume.resolution;
+  printf("Extracting %u^3 cells in %u^3 cell chunks on %u threads\n", n, options.volume.chunkSize, pool.size());
+
+  MeshProgress last;
+  bool ok = extractor.extract(pool, file, [&](const MeshProgress &p) {
+    double rate = p.samples / p.seconds;
+    printf("Slab %u/%u: %.2fM vertices, %.2fM triangles, %.1fM DE evals/s (%.0f s left)\n", p.slabsDone,
+           p.slabCount, p.vertices / 1e6, p.triangles / 1e6, rate / 1e6,
+           p.seconds / p.slabsDone * (p.slabCount - p.slabsDone));
+    fflush(stdout);
+    last = p;
+  });
+
+  if (!ok || !file.close())
+    return EXIT_FAILURE;
+
+  printf("Extracted %llu vertices and %llu triangles in %.1f s (%.2f Mcells/s, %u empty chunks skipped)\n",
+         (unsigned long long) last.vertices, (unsigned long long) last.triangles, last.seconds,
+         (double) n * n * n / last.seconds / 1e6, last.chunksSkipped);
+  std::cout << "Wrote " << options.output << std::endl;
+  return 0;
+}
@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "CpuRaymarcher.hh"
+#include "FarmProtocol.hh"
+#include "FractalUniforms.hh"
+#include "Keyframes.hh"
+
+// Same projection as the interactive explorer
+float NEAR_PLANE = 0.1f;
+float FAR_PLANE = 100.0f;
+float FOV = 50.0f;
+
+// Tiles a worker holds at once, the second one hides the round trip
+const unsigned int TILES_PER_WORKER = 2;
+
+struct FarmOptions {
+  std::string output = "mandelbulb.png";
+  unsigned int width = 1920;
+  unsigned int height = 1080;
+  unsigned int workers = 0;
+  unsigned int tileSize = 64;
+  std::string keyframes;
+  unsigned int frame = 0;
+  bool customCamera = false;
+  double r = 3.0, theta = 0.0, phi = 0.0;
+  float time = 0.0f;
+  bool weakSettings = false;
+  double slowSeconds = 0.0;
+  std::string workerCommand;
+  bool injectFaults = false;
+
+  // Worker side
+  bool worker = false;
+  std::string fault;
+};
+
+void showUsage() {
+  std::cerr << "Usage: ./mandelbulb-farm -j 8 -s 7680 4320 -o big.png\n"
+            << "Options:\n"
+            << "\t-h,--help\t\tShow this message\n"
+            << "\t-o,--output <file>\tOutput image, .png or .ppm (default mandelbulb.png)\n"
+            << "\t-s,--size <w> <h>\tResolution in pixels (default 1920 1080)\n"
+            << "\t-j,--workers <n>\tWorker processes, 0 for one per core (default 0)\n"
+            << "\t--tile <px>\t\tTile edge length (default 64)\n"
+            << "\t--camera <r> <theta> <phi>\tSpherical camera coordinates\n"
+            << "\t--time <s>\t\tValue of u_time\n"
+            << "\t-k,--keyframes <file> <frame>\tTake camera and settings from a keyframe file at a frame\n"
+            << "\t-w,--weak \t\tSame lower settings as the explorer\n"
+            << "\t--slow <s>\t\tHand a tile to a second worker after this long (default 4x the median tile)\n"
+            << "\t--worker-command <cmd>\tStart workers with this shell command plus --worker, e.g. through ssh\n"
+            << "\t--inject-faults\t\tCrash worker 0 after one tile and slow down worker 1, for testing\n"
+            << "\t--worker\t\tRun as a worker on stdin and stdout\n"
+            << std::endl;
+}
+
+int handleArgs(int c, char *argv[], FarmOptions &options) {
+  for (int i = 1; i < c; ++i) {
+    std::string arg = argv[i];
+    int left = c - i - 1;
+
+    if (arg == "-h" || arg == "--help") {
+      showUsage();
+      return -1;
+    } else if ((arg == "-o" || arg == "--output") && left >= 1) {
+      options.output = argv[++i];
+    } else if ((arg == "-s" || arg == "--size") && left >= 2) {
+      options.width = (unsigned int) std::atoi(argv[++i]);
+      options.height = (unsigned int) std::atoi(argv[++i]);
+    } else if ((arg == "-j" || arg == "--workers") && left >= 1) {
+      options.workers = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--tile" && left >= 1) {
+      options.tileSize = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "--camera" && left >= 3) {
+      options.customCamera = true;
+      options.r = std::atof(argv[++i]);
+      options.theta = std::atof(argv[++i]);
+      options.phi = std::atof(argv[++i]);
+    } else if (arg == "--time" && left >= 1) {
+      options.time = (float) std::atof(argv[++i]);
+    } else if ((arg == "-k" || arg == "--keyframes") && left >= 2) {
+      options.keyframes = argv[++i];
+      options.frame = (unsigned int) std::atoi(argv[++i]);
+    } else if (arg == "-w" || arg == "--weak") {
+      options.weakSettings = true;
+    } else if (arg == "--slow" && left >= 1) {
+      options.slowSeconds = std::atof(argv[++i]);
+    } else if (arg == "--worker-command" && left >= 1) {
+      options.workerCommand = argv[++i];
+    } else if (arg == "--inject-faults") {
+      options.injectFaults = true;
+    } else if (arg == "--worker") {
+      options.worker = true;
+    } else if (arg == "--fault" && left >= 1) {
+      options.fault = argv[++i];
+    } else {
+      std::cerr << "Unknown or incomplete argument " << arg << "\n";
+      showUsage();
+      return -1;
+    }
+  }
+
+  if (options.width == 0 || options.height == 0 || options.tileSize == 0) {
+    std::cerr << "Size and tile size must be positive\n";
+    return -1;
+  }
+  return 0;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Worker: renders the tiles it is sent until told to quit. Talks on stdin and
+ * stdout, so stdout must carry nothing but protocol messages.
+ */
+int runWorker(const FarmOptions &options) {
+  FarmMessage message;
+  unsigned int width, height;
+  std::string keyframeText;
+  if (!receiveFarmMessage(STDIN_FILENO, message) || !parseFarmJob(message, width, height, keyframeText)) {
+    std::cerr << "Worker " << getpid() << ": expected a job\n";
+    return EXIT_FAILURE;
+  }
+
+  KeyframeTrack track;
+  std::istringstream keyframeStream(keyframeText);
+  if (!track.parse(keyframeStream, "job", FractalUniforms(), AppState())) {
+    sendFarmMessage(STDOUT_FILENO, farmTextMessage(FARM_ERROR, "bad job keyframe"));
+    return EXIT_FAILURE;
+  }
+
+  Keyframe key = track.at(0);
+  CpuRaymarcher raymarcher(key.u, key.state, keyframeView(key, width, height, FOV, NEAR_PLANE, FAR_PLANE));
+  unsigned int tilesDone = 0;
+
+  while (receiveFarmMessage(STDIN_FILENO, message) && message.type != FARM_QUIT) {
+    uint32_t id;
+    Tile tile;
+    if (!parseFarmTile(message, id, tile) || tile.x1 > width || tile.y1 > height) {
+      sendFarmMessage(STDOUT_FILENO, farmTextMessage(FARM_ERROR, "bad tile"));
+      return EXIT_FAILURE;
+    }
+
+    if (options.fault == "crash" && tilesDone == 1)
+      abort();
+
+    auto start = std::chrono::steady_clock::now();
+    Image pixels(tile.x1 - tile.x0, tile.y1 - tile.y0);
+    raymarcher.renderTile(pixels, tile, tile.x0, tile.y0);
+    if (options.fault == "slow")
+      std::this_thread::sleep_for(std::chrono::duration<double>(20.0 * secondsSince(start) + 0.5));
+
+    if (!sendFarmMessage(STDOUT_FILENO, farmResultMessage(id, tile, pixels)))
+      return EXIT_FAILURE;
+    tilesDone++;
+  }
+
+  return 0;
+}
+
+struct WorkerProcess {
+  pid_t pid = -1;
+  int fd = -1;
+  FarmMessageReader reader;
+  std::vector<uint32_t> tiles; // Assigned and not yet returned by this worker
+  std::chrono::steady_clock::time_point tileStart; // Of the oldest tile in tiles
+  unsigned int tilesDone = 0;
+  bool alive = false;
+};
+
+struct TileState {
+  Tile tile;
+  bool done = false;
+  unsigned int assignments = 0; // Workers currently holding it
+  std::chrono::steady_clock::time_point assigned;
+};
+
+/**
+ * Starts a worker on one end of a socket pair, as this binary with --worker or
+ * through the user's command (which can reach other machines, e.g. over ssh)
+ */
+bool spawnWorker(WorkerProcess &worker, const FarmOptions &options, const std::string &fault) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    perror("socketpair");
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    dup2(fds[1], STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[0]);
+    close(fds[1]);
+
+    if (!options.workerCommand.empty()) {
+      std::string command = options.workerCommand + " --worker";
+      if (!fault.empty())
+        command += " --fault " + fault;
+      execl("/bin/sh", "sh", "-c", command.c_str(), (char *) nullptr);
+    } else if (fault.empty()) {
+      execl("/proc/self/exe", "mandelbulb-farm", "--worker", (char *) nullptr);
+    } else {
+      execl("/proc/self/exe", "mandelbulb-farm", "--worker", "--fault", fault.c_str(), (char *) nullptr);
+    }
+    perror("exec");
+    _exit(127);
+  }
+
+  close(fds[1]);
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+  worker.pid = pid;
+  worker.fd = fds[0];
+  worker.reader = FarmMessageReader();
+  worker.tiles.clear();
+  worker.alive = true;
+  return true;
+}
+
+/**
+ * Blocking send on a non-blocking socket, messages to workers are small
+ */
+bool sendToWorker(WorkerProcess &worker, const FarmMessage &message) {
+  fcntl(worker.fd, F_SETFL, fcntl(worker.fd, F_GETFL) & ~O_NONBLOCK);
+  bool ok = sendFarmMessage(worker.fd, message);
+  fcntl(worker.fd, F_SETFL, fcntl(worker.fd, F_GETFL) | O_NONBLOCK);
+  return ok;
+}
+
+/**
+ * Job keyframe from the command line, in the text form workers parse
+ */
+bool jobKeyframe(const FarmOptions &options, std::string &text) {
+  FractalUniforms u;
+  AppState state;
+  if (options.weakSettings)
+    u.applyWeakSettings();
+
+  KeyframeTrack track;
+  if (!options.keyframes.empty()) {
+    if (!track.load(options.keyframes, u, state))
+      return false;
+  } else {
+    std::ostringstream job;
+    job.precision(17); // Deep zoom cameras need every digit
+    job << "keyframe 0\ntime " << options.time << "\n";
+    if (options.customCamera)
+      job << "camera " << options.r << " " << options.theta << " " << options.phi << "\n";
+    else
+      job << "camera 3 0 0\n";
+
+    std::istringstream in(job.str());
+    if (!track.parse(in, "command line", u, state))
+      return false;
+  }
+
+  Keyframe key = track.at(options.frame);
+  key.frame = 0;
+  text = KeyframeTrack::format(key);
+  return true;
+}
+
+int runCoordinator(const FarmOptions &options) {
+  std::string keyframe;
+  if (!jobKeyframe(options, keyframe))
+    return EXIT_FAILURE;
+
+  std::vector<TileState> tiles;
+  for (unsigned int y = 0; y < options.height; y += options.tileSize) {
+    for (unsigned int x = 0; x < options.width; x += options.tileSize) {
+      TileState t;
+      t.tile = {x, y, std::min(x + options.tileSize, options.width), std::min(y + options.tileSize, options.height)};
+      tiles.push_back(t);
+    }
+  }
+
+  unsigned int workerCount = options.workers > 0 ? options.workers : std::max(1u, std::thread::hardware_concurrency());
+  std::vector<WorkerProcess> workers(workerCount);
+  std::vector<unsigned int> spawns(workerCount, 0);
+  FarmMessage job = farmJobMessage(options.width, options.height, keyframe);
+
+  auto start = std::chrono::steady_clock::now();
+  auto startWorker = [&](unsigned int index) {
+
+    // Faults only go to the first process in a slot, its replacement behaves
+    std::string fault;
+    if (options.injectFaults && spawns[index]++ == 0)
+      fault = index == 0 ? "crash" : index == 1 ? "slow" : "";
+    return spawnWorker(workers[index], options, fault) && sendToWorker(workers[index], job);
+  };
+
+  for (unsigned int i = 0; i < workerCount; i++)
+    if (!startWorker(i))
+      return EXIT_FAILURE;
+
+  Image image(options.width, options.height);
+  std::vector<double> tileSeconds;
+  size_t tilesLeft = tiles.size();
+  size_t nextPending = 0;
+  unsigned int crashes = 0, reassigned = 0, duplicated = 0;
+  unsigned int respawnsLeft = 2 * workerCount;
+
+  // Tiles held by a worker that went away are handed out again
+  auto workerLost = [&](WorkerProcess &worker, const char *why) {
+    kill(worker.pid, SIGKILL);
+    close(worker.fd);
+    waitpid(worker.pid, nullptr, 0);
+    worker.alive = false;
+    crashes++;
+    fprintf(stderr, "Worker %d %s, %zu tiles back in the queue\n", worker.pid, why, worker.tiles.size());
+
+    for (uint32_t id : worker.tiles) {
+      tiles[id].assignments--;
+      if (!tiles[id].done && tiles[id].assignments == 0) {
+        nextPending = std::min(nextPending, (size_t) id);
+        reassigned++;
+      }
+    }
+    worker.tiles.clear();
+  };
+
+  auto assign = [&](WorkerProcess &worker, uint32_t id) {
+    if (!sendToWorker(worker, farmTileMessage(id, tiles[id].tile))) {
+      workerLost(worker, "stopped taking tiles");
+      return;
+    }
+    if (worker.tiles.empty())
+      worker.tileStart = std::chrono::steady_clock::now();
+    worker.tiles.push_back(id);
+    tiles[id].assignments++;
+    tiles[id].assigned = std::chrono::steady_clock::now();
+  };
+
+  while (tilesLeft > 0) {
+
+    // Slow means well past the typical tile, until there is one a generous guess
+    double slowSeconds = options.slowSeconds;
+    if (slowSeconds <= 0.0) {
+      slowSeconds = 30.0;
+      if (!tileSeconds.empty()) {
+        std::vector<double> sorted = tileSeconds;
+        std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        slowSeconds = std::max(1.0, 4.0 * sorted[sorted.size() / 2]);
+      }
+    }
+
+    for (unsigned int i = 0; i < workerCount; i++) {
+      WorkerProcess &worker = workers[i];
+      if (!worker.alive) {
+        if (respawnsLeft > 0) {
+          respawnsLeft--;
+          if (!startWorker(i))
+            return EXIT_FAILURE;
+        }
+        continue;
+      }
+
+      // Stuck far beyond slow, a copy of its tiles is already elsewhere
+      if (!worker.tiles.empty() && secondsSince(worker.tileStart) > 10.0 * slowSeconds) {
+        workerLost(worker, "timed out");
+        continue;
+      }
+
+      while (worker.alive && worker.tiles.size() < TILES_PER_WORKER) {
+        while (nextPending < tiles.size() && (tiles[nextPending].done || tiles[nextPending].assignments > 0))
+          nextPending++;
+
+        if (nextPending < tiles.size()) {
+          assign(worker, (uint32_t) nextPending);
+          continue;
+        }
+
+        // Nothing new left, an idle worker races the slowest tile held elsewhere
+        if (!worker.tiles.empty())
+          break;
+        uint32_t slowest = 0;
+        bool found = false;
+        for (uint32_t id = 0; id < tiles.size(); id++) {
+          const TileState &t = tiles[id];
+          if (!t.done && t.assignments == 1 && secondsSince(t.assigned) > slowSeconds
+              && (!found || t.assigned < tiles[slowest].assigned)) {
+            slowest = id;
+            found = true;
+          }
+        }
+        if (!found)
+          break;
+        assign(worker, slowest);
+        duplicated++;
+      }
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<unsigned int> fdWorkers;
+    for (unsigned int i = 0; i < workerCount; i++) {
+      if (workers[i].alive) {
+        fds.push_back({workers[i].fd, POLLIN, 0});
+        fdWorkers.push_back(i);
+      }
+    }
+    if (fds.empty()) {
+      std::cerr << "All workers failed, giving up with " << tilesLeft << " tiles left\n";
+      return EXIT_FAILURE;
+    }
+
+    if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+      perror("poll");
+      return EXIT_FAILURE;
+    }
+
+    for (size_t f = 0; f < fds.size(); f++) {
+      if (!fds[f].revents)
+        continue;
+
+      WorkerProcess &worker = workers[fdWorkers[f]];
+      bool open = worker.reader.readAvailable(worker.fd);
+
+      FarmMessage message;
+      while (worker.alive && worker.reader.next(message)) {
+        uint32_t id;
+        Tile tile;
+        const unsigned char *pixels;
+        if (message.type == FARM_ERROR) {
+          std::string text(message.payload.begin(), message.payload.end());
+          fprintf(stderr, "Worker %d: %s\n", worker.pid, text.c_str());
+          continue;
+        }
+        if (!parseFarmResult(message, id, tile, pixels) || id >= tiles.size()
+            || std::find(worker.tiles.begin(), worker.tiles.end(), id) == worker.tiles.end()) {
+          workerLost(worker, "sent garbage");
+          break;
+        }
+
+        // Copied into the image as sent, so it has to be exactly the tile that was handed out
+        const Tile &assigned = tiles[id].tile;
+        if (tile.x0 != assigned.x0 || tile.y0 != assigned.y0 || tile.x1 != assigned.x1 || tile.y1 != assigned.y1) {
+          workerLost(worker, "sent garbage");
+          break;
+        }
+
+        worker.tiles.erase(std::find(worker.tiles.begin(), worker.tiles.end(), id));
+        worker.tileStart = std::chrono::steady_clock::now();
+        worker.tilesDone++;
+        TileState &t = tiles[id];
+        t.assignments--;
+        if (t.done)
+          continue; // Lost the race against a duplicate
+
+        tileSeconds.push_back(secondsSince(t.assigned));
+        unsigned int rowBytes = 3 * (tile.x1 - tile.x0);
+        for (unsigned int y = tile.y0; y < tile.y1; y++)
+          memcpy(&image.pixels[3 * ((size_t) y * image.width + tile.x0)], pixels + (y - tile.y0) * rowBytes, rowBytes);
+        t.done = true;
+        tilesLeft--;
+      }
+
+      if (worker.alive && (!open || worker.reader.isCorrupt()))
+        workerLost(worker, open ? "sent garbage" : "exited");
+    }
+  }
+
+  for (WorkerProcess &worker : workers) {
+    if (!worker.alive)
+      continue;
+
+    // Any tile it still holds is a duplicate that lost, stop it rather than wait
+    if (!worker.tiles.empty())
+      kill(worker.pid, SIGKILL);
+    else
+      sendToWorker(worker, farmTextMessage(FARM_QUIT, ""));
+    close(worker.fd);
+    waitpid(worker.pid, nullptr, 0);
+  }
+
+  double elapsed = secondsSince(start);
+  printf("Rendered %ux%u as %zu tiles on %u workers in %.3f s (%.3f Mpixel/s)\n", options.width, options.height,
+         tiles.size(), workerCount, elapsed, (double) options.width * options.height / elapsed / 1e6);
+  printf("%u workers lost, %u tiles reassigned, %u slow tiles duplicated\n", crashes, reassigned, duplicated);
+
+  if (!image.write(options.output))
+    return EXIT_FAILURE;
+
+  std::cout << "Wrote " << options.output << std::endl;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  FarmOptions options;
+  int OK = handleArgs(argc, argv, options);
+  if (OK < 0) return -1;
+
+  // A dead peer shows up as a failed write instead of killing the process
+  signal(SIGPIPE, SIG_IGN);
+
+  return options.worker ? runWorker(options) : runCoordinator(options);
+}